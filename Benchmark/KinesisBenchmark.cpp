@@ -0,0 +1,615 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Benchmark of the device adapter's Kinesis layer, normally run against
+// devices created with the Kinesis Simulator. It uses the same connection,
+// motor drive, and setup code as the stage devices (but not the
+// Micro-Manager device classes themselves, which require a running Core).
+//
+// Usage: KinesisBenchmark [options] [serialNo[:channel] ...]
+//   --hardware         Use real devices (default: Kinesis Simulator devices)
+//   --repeat N         Repetitions of each measurement (default 10)
+//   --distance D       Move distance in device units (default 10000)
+//   --polling MS       Polling interval (default 50)
+//   --call-stats       Print per-function Kinesis call statistics at the end
+//   --mock SERIALS     Use in-process mock devices (comma-separated serial
+//                      numbers) instead of Kinesis; timing model options:
+//   --mock-open MS     Connection open latency (default 200)
+//   --mock-command US  Per-command latency (default 1000)
+//   --mock-velocity V  Max velocity, device units/s (default 20000)
+//   --mock-accel A     Acceleration, device units/s^2 (default 200000)
+//   --mock-jitter MS   Max random addition to each polling interval (default 0)
+//   --mock-mixed N     Use N mock devices, cycling through the motor families
+//   --scaling          Instead of the per-device benchmark, run randomized
+//                      concurrent moves on increasing numbers of devices:
+//   --counts LIST      Device counts (comma-separated; default 1,4,16,32)
+//   --duration S       Duration of each run in seconds (default 10)
+// Without serial numbers, all detected motor drives are used.
+
+#include "Connections.h"
+#include "DLLCallStats.h"
+#include "DeviceEnumeration.h"
+#include "DeviceTypes.h"
+#include "KinesisDevice.h"
+#include "MockKinesis.h"
+#include "MotorDriveSetup.h"
+
+#include "MMDevice.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double MsSince(Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(
+            Clock::now() - start).count();
+    }
+
+    struct Options {
+        bool simulated = true;
+        int repeat = 10;
+        int distance = 10000;
+        int pollingIntervalMs = 50;
+        bool callStats = false;
+        std::vector<std::string> mockSerialNos;
+        int mockMixedCount = 0;
+        MockTimingModel mockModel;
+        bool scaling = false;
+        std::vector<int> deviceCounts{ 1, 4, 16, 32 };
+        double durationS = 10.0;
+        std::vector<std::string> devices; // serialNo or serialNo:channel
+    };
+
+    bool ParseOptions(int argc, char* argv[], Options& options) {
+        for (int i = 1; i < argc; ++i) {
+            std::string arg = argv[i];
+            bool hasValue = i + 1 < argc;
+            if (arg == "--hardware")
+                options.simulated = false;
+            else if (arg == "--call-stats")
+                options.callStats = true;
+            else if (arg == "--repeat" && hasValue)
+                options.repeat = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--distance" && hasValue)
+                options.distance = std::atoi(argv[++i]);
+            else if (arg == "--polling" && hasValue)
+                options.pollingIntervalMs = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--mock" && hasValue) {
+                std::istringstream list{ argv[++i] };
+                std::string serialNo;
+                while (std::getline(list, serialNo, ','))
+                    options.mockSerialNos.push_back(serialNo);
+            }
+            else if (arg == "--mock-open" && hasValue)
+                options.mockModel.openLatencyMs = std::atoi(argv[++i]);
+            else if (arg == "--mock-command" && hasValue)
+                options.mockModel.commandLatencyUs = std::atoi(argv[++i]);
+            else if (arg == "--mock-velocity" && hasValue)
+                options.mockModel.maxVelocity = std::atof(argv[++i]);
+            else if (arg == "--mock-accel" && hasValue)
+                options.mockModel.acceleration = std::atof(argv[++i]);
+            else if (arg == "--mock-jitter" && hasValue)
+                options.mockModel.pollingJitterMs = std::atoi(argv[++i]);
+            else if (arg == "--mock-mixed" && hasValue)
+                options.mockMixedCount = std::max(1, std::atoi(argv[++i]));
+            else if (arg == "--scaling")
+                options.scaling = true;
+            else if (arg == "--counts" && hasValue) {
+                options.deviceCounts.clear();
+                std::istringstream list{ argv[++i] };
+                std::string count;
+                while (std::getline(list, count, ','))
+                    options.deviceCounts.push_back(
+                        std::max(1, std::atoi(count.c_str())));
+            }
+            else if (arg == "--duration" && hasValue)
+                options.durationS = std::max(0.1, std::atof(argv[++i]));
+            else if (!arg.empty() && arg[0] != '-')
+                options.devices.push_back(arg);
+            else
+                return false;
+        }
+        return true;
+    }
+
+    // Collects samples of one quantity and prints min/median/mean/max
+    class Samples {
+        std::string const name_;
+        std::string const unit_;
+        std::vector<double> values_;
+
+    public:
+        Samples(std::string const& name, std::string const& unit) :
+            name_{ name },
+            unit_{ unit }
+        {}
+
+        void Add(double value) { values_.push_back(value); }
+
+        void Merge(Samples const& other) {
+            values_.insert(values_.end(), other.values_.begin(),
+                other.values_.end());
+        }
+
+        void Print() const {
+            if (values_.empty()) {
+                std::printf("%-40s (no samples)\n", name_.c_str());
+                return;
+            }
+            std::vector<double> sorted = values_;
+            std::sort(sorted.begin(), sorted.end());
+            double sum = 0.0;
+            for (double v : sorted)
+                sum += v;
+            std::printf("%-40s n=%-4zu min=%-10.3f med=%-10.3f mean=%-10.3f "
+                "max=%-10.3f %s\n", name_.c_str(), sorted.size(), sorted.front(),
+                sorted[sorted.size() / 2], sum / sorted.size(), sorted.back(),
+                unit_.c_str());
+        }
+
+        // For latency distributions, where the tail matters
+        void PrintPercentiles() const {
+            if (values_.empty()) {
+                std::printf("%-40s (no samples)\n", name_.c_str());
+                return;
+            }
+            std::vector<double> sorted = values_;
+            std::sort(sorted.begin(), sorted.end());
+            auto percentile = [&](double fraction) {
+                size_t rank = static_cast<size_t>(
+                    std::ceil(fraction * sorted.size()));
+                return sorted[std::max<size_t>(rank, 1) - 1];
+            };
+            std::printf("%-40s n=%-6zu p50=%-10.3f p95=%-10.3f p99=%-10.3f "
+                "max=%-10.3f %s\n", name_.c_str(), sorted.size(),
+                percentile(0.50), percentile(0.95), percentile(0.99),
+                sorted.back(), unit_.c_str());
+        }
+    };
+
+    // Serial numbers of mock devices of all supported motor types in turn
+    std::vector<std::string> MixedMockSerialNos(int count) {
+        std::vector<uint32_t> typeIDs;
+        for (auto const& type : DeviceTypesDetail::DEVICE_TYPES) {
+            if (type.stageKind == StageKindMotor)
+                typeIDs.push_back(type.typeID);
+        }
+        std::vector<std::string> serialNos;
+        for (int i = 0; i < count; ++i) {
+            char serialNo[16];
+            std::snprintf(serialNo, sizeof(serialNo), "%02u%06d",
+                static_cast<unsigned>(typeIDs[i % typeIDs.size()]), i + 1);
+            serialNos.push_back(serialNo);
+        }
+        return serialNos;
+    }
+
+    struct Target {
+        std::string serialNo;
+        short channel;
+    };
+
+    std::vector<Target> FindTargets(Options const& options,
+        std::vector<std::string> const& enumerated) {
+        std::vector<Target> targets;
+        if (!options.devices.empty()) {
+            for (auto const& spec : options.devices) {
+                auto colon = spec.find(':');
+                std::string serialNo = spec.substr(0, colon);
+                short channel = colon == std::string::npos ? 1 :
+                    static_cast<short>(std::atoi(spec.c_str() + colon + 1));
+                if (!IsPotentiallyMultiChannel(serialNo))
+                    channel = -1;
+                targets.push_back({ serialNo, channel });
+            }
+            return targets;
+        }
+
+        for (auto const& serialNo : enumerated) {
+            auto connection = MakeConnection(serialNo);
+            if (!connection || !connection->IsValid())
+                continue;
+            short channel = IsPotentiallyMultiChannel(serialNo) ? 1 : -1;
+            if (MakeKinesisMotorDrive(connection, channel))
+                targets.push_back({ serialNo, channel });
+        }
+        return targets;
+    }
+
+    // The same steps as SingleAxisStage::Initialize(), minus the properties
+    int InitializeDrive(MotorDrive& drive, int pollingIntervalMs,
+        bool& didEnable) {
+        int ret = AwaitInitialState(drive);
+        if (ret != DEVICE_OK)
+            return ret;
+        if (!drive.StartPolling(pollingIntervalMs))
+            return DEVICE_ERR;
+        drive.StartMotionEvents([] {});
+        return EnableChannelIfDisabled(drive, didEnable);
+    }
+
+    void ShutdownDrive(MotorDrive& drive, bool didEnable) {
+        if (didEnable)
+            drive.SetChannelEnabled(false);
+        drive.StopMotionEvents();
+        drive.StopPolling();
+    }
+
+    // Move and wait for the stage to report not busy; returns the time in ms,
+    // or a negative value on error
+    double TimeMove(MotorDrive& drive, int target, int pollingIntervalMs) {
+        double const statusLagMs = pollingIntervalMs + 10.0;
+        auto const start = Clock::now();
+        if (drive.MoveToPosition(target))
+            return -1.0;
+        while (IsMotorDriveMoving(drive, MsSince(start), statusLagMs)) {
+            if (MsSince(start) > 60000.0)
+                return -1.0;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return MsSince(start);
+    }
+
+    void BenchmarkDevice(Target const& target, Options const& options) {
+        std::string label = target.serialNo;
+        if (target.channel > 0)
+            label += ":" + std::to_string(target.channel);
+        std::printf("\n== %s ==\n", label.c_str());
+
+        Samples open{ "Connection open", "ms" };
+        Samples close{ "Connection close", "ms" };
+        Samples init{ "Initialize", "ms" };
+        for (int i = 0; i < options.repeat; ++i) {
+            auto start = Clock::now();
+            auto connection = MakeConnection(target.serialNo);
+            open.Add(MsSince(start));
+            if (!connection || !connection->IsValid()) {
+                std::printf("Cannot open %s (error %d)\n",
+                    target.serialNo.c_str(),
+                    connection ? connection->ConnectionError() : -1);
+                return;
+            }
+
+            auto drive = MakeKinesisMotorDrive(connection, target.channel);
+            bool didEnable = false;
+            start = Clock::now();
+            int ret = InitializeDrive(*drive, options.pollingIntervalMs,
+                didEnable);
+            init.Add(MsSince(start));
+            ShutdownDrive(*drive, didEnable);
+            if (ret != DEVICE_OK) {
+                std::printf("Initialization failed (error %d)\n", ret);
+                return;
+            }
+
+            drive.reset();
+            start = Clock::now();
+            connection.reset();
+            close.Add(MsSince(start));
+        }
+        open.Print();
+        close.Print();
+        init.Print();
+
+        auto connection = MakeConnection(target.serialNo);
+        auto drive = MakeKinesisMotorDrive(connection, target.channel);
+        bool didEnable = false;
+        if (InitializeDrive(*drive, options.pollingIntervalMs, didEnable) !=
+            DEVICE_OK)
+            return;
+
+        double maxVelocity = 0.0;
+        double acceleration = 0.0;
+        GetMoveProfile(*drive, maxVelocity, acceleration);
+        double const estimateMs = EstimateMoveTimeMs(options.distance,
+            maxVelocity, acceleration);
+
+        // Move back and forth, measuring the time until no longer busy
+        Samples move{ "Move to not busy", "ms" };
+        Samples overhead{ "Move to not busy minus estimate", "ms" };
+        int const origin = drive->GetPositionCounter();
+        for (int i = 0; i < options.repeat; ++i) {
+            int target = (i % 2 == 0) ? origin + options.distance : origin;
+            double ms = TimeMove(*drive, target, options.pollingIntervalMs);
+            if (ms < 0.0) {
+                std::printf("Move failed or timed out\n");
+                break;
+            }
+            move.Add(ms);
+            if (estimateMs > 0.0)
+                overhead.Add(ms - estimateMs);
+        }
+        move.Print();
+        if (estimateMs > 0.0)
+            overhead.Print();
+
+        // Cached status and position, as read by Busy() and GetPosition()
+        Samples queries{ "Status + position queries", "k/s" };
+        for (int i = 0; i < options.repeat; ++i) {
+            unsigned long count = 0;
+            DWORD sink = 0;
+            auto const start = Clock::now();
+            while (MsSince(start) < 200.0) {
+                sink ^= drive->GetStatusBits();
+                sink ^= static_cast<DWORD>(drive->GetPositionCounter());
+                ++count;
+            }
+            (void)sink;
+            queries.Add(count / MsSince(start));
+        }
+        queries.Print();
+
+        ShutdownDrive(*drive, didEnable);
+    }
+
+    struct ScalingAxis {
+        std::shared_ptr<KinesisDeviceConnection> connection;
+        std::unique_ptr<MotorDrive> drive;
+        bool didEnable = false;
+        int origin = 0;
+    };
+
+    struct ScalingResult {
+        Samples move{ "Move to not busy", "ms" };
+        Samples busy{ "Busy query", "us" };
+        unsigned long moves = 0;
+        unsigned long failures = 0;
+    };
+
+    // Moves to random targets within the distance of the origin until the
+    // deadline, timing each move and each busy check (as done by Busy())
+    void RunRandomMoves(ScalingAxis& axis, unsigned seed,
+        Clock::time_point deadline, int pollingIntervalMs,
+        int distance, ScalingResult& result) {
+        double const statusLagMs = pollingIntervalMs + 10.0;
+        std::mt19937 rng{ seed };
+        std::uniform_int_distribution<int> offset{ 1, std::max(1, distance) };
+        while (Clock::now() < deadline) {
+            int const target = axis.origin + offset(rng);
+            auto const start = Clock::now();
+            if (axis.drive->MoveToPosition(target)) {
+                ++result.failures;
+                std::this_thread::sleep_for(
+                    std::chrono::milliseconds(pollingIntervalMs));
+                continue;
+            }
+            bool timedOut = false;
+            for (;;) {
+                auto const queryStart = Clock::now();
+                bool const moving = IsMotorDriveMoving(*axis.drive,
+                    MsSince(start), statusLagMs);
+                result.busy.Add(1000.0 * MsSince(queryStart));
+                if (!moving)
+                    break;
+                if (MsSince(start) > 60000.0) {
+                    timedOut = true;
+                    break;
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (timedOut) {
+                ++result.failures;
+                continue;
+            }
+            result.move.Add(MsSince(start));
+            ++result.moves;
+        }
+    }
+
+    void RunScalingStep(std::vector<Target> const& targets, size_t count,
+        Options const& options) {
+        std::printf("\n== %zu devices ==\n", count);
+
+        std::vector<ScalingAxis> axes(count);
+        // On failure, leave the devices opened so far as we found them
+        auto shutdownOpened = [&] {
+            for (auto& axis : axes) {
+                if (axis.drive)
+                    ShutdownDrive(*axis.drive, axis.didEnable);
+            }
+        };
+        auto start = Clock::now();
+        for (size_t i = 0; i < count; ++i) {
+            ScalingAxis& axis = axes[i];
+            axis.connection = MakeConnection(targets[i].serialNo);
+            if (!axis.connection || !axis.connection->IsValid()) {
+                std::printf("Cannot open %s\n", targets[i].serialNo.c_str());
+                shutdownOpened();
+                return;
+            }
+            axis.drive = MakeKinesisMotorDrive(axis.connection,
+                targets[i].channel);
+            if (!axis.drive) {
+                std::printf("Not a motor channel: %s\n",
+                    targets[i].serialNo.c_str());
+                shutdownOpened();
+                return;
+            }
+            int ret = InitializeDrive(*axis.drive, options.pollingIntervalMs,
+                axis.didEnable);
+            if (ret != DEVICE_OK) {
+                std::printf("Initialization of %s failed (error %d)\n",
+                    targets[i].serialNo.c_str(), ret);
+                shutdownOpened();
+                return;
+            }
+            axis.origin = axis.drive->GetPositionCounter();
+        }
+        std::printf("%-40s %.3f ms\n", "Open + initialize (all)",
+            MsSince(start));
+
+        std::vector<ScalingResult> results(count);
+        std::vector<std::thread> threads;
+        auto const durationMs = std::chrono::milliseconds(
+            static_cast<long long>(options.durationS * 1000.0));
+        start = Clock::now();
+        auto const deadline = start + durationMs;
+        for (size_t i = 0; i < count; ++i) {
+            threads.emplace_back([&, i] {
+                RunRandomMoves(axes[i], static_cast<unsigned>(i + 1),
+                    deadline, options.pollingIntervalMs, options.distance,
+                    results[i]);
+            });
+        }
+
+        // Enumeration competes with the polling of all open devices
+        Samples enumeration{ "Enumeration (during moves)", "ms" };
+        while (Clock::now() < deadline) {
+            auto const enumStart = Clock::now();
+            EnumerateSerialNumbers();
+            enumeration.Add(MsSince(enumStart));
+            std::this_thread::sleep_for(std::chrono::milliseconds(250));
+        }
+        for (auto& thread : threads)
+            thread.join();
+        double const elapsedS = MsSince(start) / 1000.0;
+
+        ScalingResult total;
+        for (auto const& result : results) {
+            total.move.Merge(result.move);
+            total.busy.Merge(result.busy);
+            total.moves += result.moves;
+            total.failures += result.failures;
+        }
+        std::printf("%-40s %.2f moves/s (%.2f per device), %lu failed\n",
+            "Throughput", total.moves / elapsedS,
+            total.moves / elapsedS / count, total.failures);
+        total.move.PrintPercentiles();
+        total.busy.PrintPercentiles();
+        enumeration.PrintPercentiles();
+
+        for (auto& axis : axes)
+            ShutdownDrive(*axis.drive, axis.didEnable);
+        axes.clear();
+
+        // The first connection after closing all of them prunes the
+        // registry of the expired entries
+        start = Clock::now();
+        auto connection = MakeConnection(targets[0].serialNo);
+        std::printf("%-40s %.3f ms\n", "Reopen after closing all",
+            MsSince(start));
+    }
+
+    void RunScaling(std::vector<Target> const& targets,
+        Options const& options) {
+        for (int count : options.deviceCounts) {
+            if (static_cast<size_t>(count) > targets.size()) {
+                std::printf("\nSkipping %d devices (only %zu available)\n",
+                    count, targets.size());
+                continue;
+            }
+            RunScalingStep(targets, static_cast<size_t>(count), options);
+        }
+    }
+}
+
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Usage: %s [--hardware] [--repeat N] "
+            "[--distance D] [--polling MS] [--call-stats] "
+            "[--mock SERIALS [--mock-open MS] [--mock-command US] "
+            "[--mock-velocity V] [--mock-accel A] [--mock-jitter MS]] "
+            "[--mock-mixed N] [--scaling [--counts LIST] [--duration S]] "
+            "[serialNo[:channel] ...]\n", argv[0]);
+        return 2;
+    }
+
+    if (options.mockMixedCount > 0) {
+        auto const mixed = MixedMockSerialNos(options.mockMixedCount);
+        options.mockSerialNos.insert(options.mockSerialNos.end(),
+            mixed.begin(), mixed.end());
+    }
+    bool const mock = !options.mockSerialNos.empty();
+    if (mock) {
+        EnableMockKinesis(options.mockSerialNos, options.mockModel);
+        options.simulated = false;
+    }
+
+    if (!IsKinesisDriverAvailable()) {
+        std::fprintf(stderr, "Cannot load the Thorlabs Kinesis DLLs\n");
+        return 1;
+    }
+
+    DLLCallStats::SetEnabled(options.callStats);
+
+    if (options.simulated)
+        EnableSimulatedDevices();
+
+    // The first enumeration is typically much slower than later ones
+    Samples enumeration{ "Enumeration (repeat)", "ms" };
+    auto start = Clock::now();
+    std::vector<std::string> serialNos = EnumerateSerialNumbers();
+    std::printf("Enumeration (first): %.3f ms, %zu devices\n",
+        MsSince(start), serialNos.size());
+    for (int i = 0; i < options.repeat; ++i) {
+        start = Clock::now();
+        EnumerateSerialNumbers();
+        enumeration.Add(MsSince(start));
+    }
+    enumeration.Print();
+
+    auto const targets = FindTargets(options, serialNos);
+    if (targets.empty())
+        std::printf("No motor drives found\n");
+    if (options.scaling) {
+        RunScaling(targets, options);
+    }
+    else {
+        for (auto const& target : targets)
+            BenchmarkDevice(target, options);
+    }
+
+    if (options.callStats)
+        std::printf("\n%s\n", DLLCallStats::FormatReport().c_str());
+
+    if (options.simulated)
+        DisableSimulatedDevices();
+    if (mock)
+        DisableMockKinesis();
+    return 0;
+}
@@ -32,201 +32,14 @@
 
 #include "BenchtopBrushless.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.Benchtop.BrushlessMotor.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.Benchtop.BrushlessMotor.dll" };
-
-
-bool
-BenchtopBrushlessAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-BenchtopBrushlessAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopBrushlessAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-BenchtopBrushlessAccess::Kinesis_GetNumChannels() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetNumChannels, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopBrushless::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_RequestSettings, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_RequestStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-bool
-BenchtopBrushless::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_StartPolling, func);
-    return func(CSerialNo(), Channel(), intervalMs);
-}
-
-
-void
-BenchtopBrushless::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_StopPolling, func);
-    func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetHardwareInfo, func);
-
-    short shortNumChannels;
-
-    short ret = func(CSerialNo(), Channel(), modelNo, sizeOfModelNo,
-        type, &shortNumChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-
-    *numChannels = shortNumChannels;
-
-    return ret;
-}
-
-
-DWORD
-BenchtopBrushless::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_EnableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_DisableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopBrushless::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetMotorTravelMode, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_SetMotorTravelMode, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-BenchtopBrushless::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_ResetRotationModes, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_SetRotationModes, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-
-short
-BenchtopBrushless::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_RequestPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopBrushless::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-long
-BenchtopBrushless::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetPositionCounter, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, BMC_MoveToPosition, func);
-    return func(CSerialNo(), Channel(), index);
-}
-
-
-bool
-BenchtopBrushless::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_CanHome, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_Home, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopBrushless::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), Channel(), deviceUnits, realValue, unitType);
-}
-
-
-short
-BenchtopBrushless::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), Channel(), realValue, deviceUnits, unitType);
-}
-
-
-long
-BenchtopBrushless::Kinesis_GetEncoderCounter() {
-    STATIC_DLL_FUNC(kinesisDll, BMC_GetEncoderCounter, func);
-    return func(CSerialNo(), Channel());
-}
+#define KINESIS_FAMILY BenchtopBrushless
+#define KINESIS_FUNC(name) BMC_##name
+#define KINESIS_DLL_TYPE_ID TypeIDBenchtopBrushless
+#define KINESIS_MULTI_CHANNEL 1
+#define KINESIS_SHORT_NUM_CHANNELS 1
+#define KINESIS_HAS_ROTATION_MODES 1
+#define KINESIS_HAS_ENCODER 1
+#include "MotorDriveFamily.inl"
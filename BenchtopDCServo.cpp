@@ -32,194 +32,13 @@
 
 #include "BenchtopDCServo.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.Benchtop.DCServo.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.Benchtop.DCServo.dll" };
-
-
-bool
-BenchtopDCServoAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-BenchtopDCServoAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopDCServoAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-BenchtopDCServoAccess::Kinesis_GetNumChannels() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetNumChannels, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopDCServo::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_RequestSettings, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_RequestStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-bool
-BenchtopDCServo::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, BDC_StartPolling, func);
-    return func(CSerialNo(), Channel(), intervalMs);
-}
-
-
-void
-BenchtopDCServo::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_StopPolling, func);
-    func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetHardwareInfo, func);
-    return func(CSerialNo(), Channel(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-BenchtopDCServo::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_EnableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_DisableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopDCServo::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetMotorTravelMode, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, BDC_SetMotorTravelMode, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-BenchtopDCServo::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_ResetRotationModes, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, BDC_SetRotationModes, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-
-short
-BenchtopDCServo::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_RequestPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopDCServo::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-long
-BenchtopDCServo::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetPositionCounter, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, BDC_MoveToPosition, func);
-    return func(CSerialNo(), Channel(), index);
-}
-
-
-bool
-BenchtopDCServo::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_CanHome, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_Home, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopDCServo::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), Channel(), deviceUnits, realValue, unitType);
-}
-
-
-short
-BenchtopDCServo::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), Channel(), realValue, deviceUnits, unitType);
-}
-
-
-long
-BenchtopDCServo::Kinesis_GetEncoderCounter() {
-    STATIC_DLL_FUNC(kinesisDll, BDC_GetEncoderCounter, func);
-    return func(CSerialNo(), Channel());
-}
+#define KINESIS_FAMILY BenchtopDCServo
+#define KINESIS_FUNC(name) BDC_##name
+#define KINESIS_DLL_TYPE_ID TypeIDBenchtopDCServo1Channel
+#define KINESIS_MULTI_CHANNEL 1
+#define KINESIS_HAS_ROTATION_MODES 1
+#define KINESIS_HAS_ENCODER 1
+#include "MotorDriveFamily.inl"
@@ -41,6 +41,9 @@ public:
         KinesisDeviceAccess{ serialNo }
     {}
 
+    // Load the DLL and resolve its functions ahead of first use
+    static bool PreloadDriver();
+
 protected:
     bool IsKinesisDriverAvailable() override;
     short Kinesis_Open() override;
@@ -55,6 +58,8 @@ public:
         NonStepperMotorDrive{ connection, channel }
     {}
 
+    MotionScale GetMotionScale() override { return MotionScales::DCServo; }
+
 protected: // General
     short Kinesis_RequestSettings() override;
     short Kinesis_RequestStatusBits() override;
@@ -68,6 +73,15 @@ protected: // General
 
     DWORD Kinesis_GetStatusBits() override;
 
+    void Kinesis_EnableLastMsgTimer(bool enable, __int32 lastMsgTimeout) override;
+    bool Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) override;
+
+    void Kinesis_RegisterMessageCallback(void (*callback)()) override;
+    int Kinesis_MessageQueueSize() override;
+    void Kinesis_ClearMessageQueue() override;
+    bool Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+        DWORD* messageData) override;
+
 protected: // Motor
     short Kinesis_EnableChannel() override;
     short Kinesis_DisableChannel() override;
@@ -81,9 +95,16 @@ protected: // Motor
     int Kinesis_GetPosition() override;
     long Kinesis_GetPositionCounter() override;
     short Kinesis_MoveToPosition(int index) override;
+    short Kinesis_MoveRelative(int displacement) override;
+    short Kinesis_MoveAtVelocity(int direction) override;
+    short Kinesis_StopProfiled() override;
 
     bool Kinesis_CanHome() override;
     short Kinesis_Home() override;
+    short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) override;
+    short Kinesis_SetVelParams(int acceleration, int maxVelocity) override;
+    short Kinesis_GetJogVelParams(int* acceleration, int* maxVelocity) override;
+    short Kinesis_SetJogVelParams(int acceleration, int maxVelocity) override;
 
     short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
         double* realValue, int unitType) override;
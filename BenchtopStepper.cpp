@@ -32,187 +32,23 @@
 
 #include "BenchtopStepper.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.Benchtop.StepperMotor.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.Benchtop.StepperMotor.dll" };
-
-
-bool
-BenchtopStepperAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-BenchtopStepperAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopStepperAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-BenchtopStepperAccess::Kinesis_GetNumChannels() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetNumChannels, func);
-    return func(CSerialNo());
-}
-
-
-short
-BenchtopStepper::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_RequestSettings, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_RequestStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-bool
-BenchtopStepper::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, SBC_StartPolling, func);
-    return func(CSerialNo(), Channel(), intervalMs);
-}
-
-
-void
-BenchtopStepper::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_StopPolling, func);
-    func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetHardwareInfo, func);
-    return func(CSerialNo(), Channel(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-BenchtopStepper::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetStatusBits, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_EnableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_DisableChannel, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopStepper::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetMotorTravelMode, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, SBC_SetMotorTravelMode, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-BenchtopStepper::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_ResetRotationModes, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, SBC_SetRotationModes, func);
-    return func(CSerialNo(), Channel(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-
-short
-BenchtopStepper::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_RequestPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-int
-BenchtopStepper::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetPosition, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-long
-BenchtopStepper::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetPositionCounter, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, SBC_MoveToPosition, func);
-    return func(CSerialNo(), Channel(), index);
-}
-
-
-bool
-BenchtopStepper::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_CanHome, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, SBC_Home, func);
-    return func(CSerialNo(), Channel());
-}
-
-
-short
-BenchtopStepper::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), Channel(), deviceUnits, realValue, unitType);
-}
-
+#define KINESIS_FAMILY BenchtopStepper
+#define KINESIS_FUNC(name) SBC_##name
+#define KINESIS_DLL_TYPE_ID TypeIDBenchtopStepper1Channel
+#define KINESIS_MULTI_CHANNEL 1
+#define KINESIS_HAS_ROTATION_MODES 1
+#include "MotorDriveFamily.inl"
 
-short
-BenchtopStepper::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
 
-    STATIC_DLL_FUNC(kinesisDll, SBC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), Channel(), realValue, deviceUnits, unitType);
+MotionScale
+BenchtopStepper::GetMotionScale() {
+    // Older controllers take velocity and acceleration in microsteps
+    std::string modelNo = GetModelNo();
+    if (modelNo.compare(0, 4, "BSC1") == 0 ||
+        modelNo.compare(0, 4, "BSC0") == 0)
+        return MotionScales::LegacyStepper;
+    return MotionScales::Stepper;
 }
@@ -0,0 +1,149 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "CommandQueue.h"
+
+#include <algorithm>
+
+
+namespace {
+    // The queue whose commands the current thread is running, if any
+    thread_local CommandQueue const* runningQueue = nullptr;
+
+    // Sets runningQueue for the lifetime of the object. A command may run
+    // a batch of another queue (e.g. of a second controller), after which
+    // the outer queue must still be recognized.
+    class RunningQueueScope {
+        CommandQueue const* const previous_;
+
+    public:
+        explicit RunningQueueScope(CommandQueue const* queue) :
+            previous_{ runningQueue }
+        {
+            runningQueue = queue;
+        }
+
+        ~RunningQueueScope() { runningQueue = previous_; }
+
+        RunningQueueScope(RunningQueueScope const&) = delete;
+        RunningQueueScope& operator=(RunningQueueScope const&) = delete;
+    };
+
+    // Commands (Kinesis calls) are not expected to throw, but an exception
+    // must not leave the queue busy forever
+    short RunCommand(CommandQueue::Command const& command) {
+        try {
+            return command();
+        }
+        catch (...) {
+            return short(-1);
+        }
+    }
+}
+
+
+short
+CommandQueue::Execute(Command const& command) {
+    if (runningQueue == this) // Called from one of our own commands
+        return RunCommand(command);
+
+    Pending item{ &command, 0, false };
+    Pending* items[] = { &item };
+    Submit(items, 1);
+    return item.result;
+}
+
+
+std::vector<short>
+CommandQueue::ExecuteBatch(std::vector<Command> const& commands) {
+    std::vector<short> results(commands.size());
+    if (runningQueue == this) {
+        std::transform(commands.begin(), commands.end(), results.begin(),
+            RunCommand);
+        return results;
+    }
+
+    std::vector<Pending> items(commands.size());
+    std::vector<Pending*> pointers(commands.size());
+    for (size_t i = 0; i < commands.size(); ++i) {
+        items[i] = Pending{ &commands[i], 0, false };
+        pointers[i] = &items[i];
+    }
+    Submit(pointers.data(), pointers.size());
+    for (size_t i = 0; i < items.size(); ++i)
+        results[i] = items[i].result;
+    return results;
+}
+
+
+void
+CommandQueue::Submit(Pending* const* items, size_t count) {
+    if (count == 0)
+        return;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    queue_.insert(queue_.end(), items, items + count);
+
+    // Our items are queued contiguously and run in order, so the last one
+    // finishing means all have
+    Pending const& last = *items[count - 1];
+    while (!last.done) {
+        if (!busy_)
+            RunBatch(lock);
+        else
+            condition_.wait(lock);
+    }
+}
+
+
+void
+CommandQueue::RunBatch(std::unique_lock<std::mutex>& lock) {
+    busy_ = true;
+    while (!queue_.empty()) {
+        running_.swap(queue_);
+        lock.unlock();
+
+        {
+            RunningQueueScope scope{ this };
+            for (Pending* item : running_)
+                item->result = RunCommand(*item->command);
+        }
+
+        lock.lock();
+        for (Pending* item : running_)
+            item->done = true;
+        running_.clear();
+        condition_.notify_all();
+    }
+    busy_ = false;
+    condition_.notify_all(); // Let a waiter take over if more arrive
+}
@@ -0,0 +1,87 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+// Serializes the commands sent to one controller (connection), so that the
+// channels of a multi-channel controller do not interleave their calls into
+// Kinesis. There is one queue per connection and no global lock, so
+// different controllers run fully in parallel.
+//
+// There is no worker thread: the first caller to find the queue idle runs
+// every command queued at that point (including those submitted by other
+// threads meanwhile) back to back, then hands over. Commands submitted
+// together with ExecuteBatch() always go out in one burst.
+//
+// Commands may themselves call Execute() on the same queue (they then run
+// immediately), but must not wait for another thread that does.
+class CommandQueue {
+public:
+    using Command = std::function<short()>;
+
+private:
+    struct Pending {
+        Command const* command;
+        short result;
+        bool done;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::vector<Pending*> queue_;
+    std::vector<Pending*> running_; // Batch being run; reused
+    bool busy_ = false;
+
+public:
+    CommandQueue() = default;
+
+    // Noncopyable
+    CommandQueue(CommandQueue const&) = delete;
+    CommandQueue& operator=(CommandQueue const&) = delete;
+
+    // Run command after any already queued, and return its result
+    short Execute(Command const& command);
+
+    // Run commands consecutively, with nothing in between; returns their
+    // results in the same order
+    std::vector<short> ExecuteBatch(std::vector<Command> const& commands);
+
+private:
+    void Submit(Pending* const* items, size_t count);
+    void RunBatch(std::unique_lock<std::mutex>& lock);
+};
@@ -33,12 +33,14 @@
 #include "Connections.h"
 
 #include "DeviceEnumeration.h"
+#include "MockKinesis.h"
 
 #include "BenchtopBrushless.h"
 #include "BenchtopDCServo.h"
 #include "BenchtopStepper.h"
 #include "KCubeBrushless.h"
 #include "KCubeDCServo.h"
+#include "KCubePiezo.h"
 #include "KCubeStepper.h"
 #include "TCubeBrushless.h"
 #include "TCubeDCServo.h"
@@ -47,109 +49,193 @@
 #include "VerticalStage.h"
 
 
-std::shared_ptr<KinesisDeviceConnection> MakeConnection(std::string const& serialNo) {
-    std::unique_ptr<KinesisDeviceAccess> access;
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDBenchtopBrushless:
-        access = std::make_unique<BenchtopBrushlessAccess>(serialNo);
-        break;
-
-    case TypeIDBenchtopDCServo1Channel:
-    case TypeIDBenchtopDCServo3Channel:
-        access = std::make_unique<BenchtopDCServoAccess>(serialNo);
-        break;
-
-    case TypeIDBenchtopStepper1Channel:
-    case TypeIDBenchtopStepper3Channel:
-        access = std::make_unique<BenchtopStepperAccess>(serialNo);
-        break;
-
-    case TypeIDKCubeBrushless:
-        access = std::make_unique<KCubeBrushlessAccess>(serialNo);
-        break;
-
-    case TypeIDKCubeDCServo:
-        access = std::make_unique<KCubeDCServoAccess>(serialNo);
-        break;
-
-    case TypeIDKCubeStepper:
-        access = std::make_unique<KCubeStepperAccess>(serialNo);
-        break;
-
-    case TypeIDTCubeBrushless:
-        access = std::make_unique<TCubeBrushlessAccess>(serialNo);
-        break;
-
-    case TypeIDTCubeDCServo:
-        access = std::make_unique<TCubeDCServoAccess>(serialNo);
-        break;
-
-    case TypeIDTCubeStepper:
-        access = std::make_unique<TCubeStepperAccess>(serialNo);
-        break;
-
-    case TypeIDLabJack050:
-    case TypeIDLabJack490:
-    case TypeIDLongTravelStage:
-    case TypeIDCageRotator:
-        access = std::make_unique<IntegratedStepperAccess>(serialNo);
-        break;
-
-    case TypeIDVerticalStage:
-        access = std::make_unique<VerticalStageAccess>(serialNo);
-        break;
-
-    default:
+ConnectionRegistry&
+ConnectionRegistry::Instance() {
+    static ConnectionRegistry instance;
+    return instance;
+}
+
+
+std::shared_ptr<KinesisDeviceConnection>
+ConnectionRegistry::Find(std::string const& serialNo) {
+    std::shared_lock<std::shared_timed_mutex> lock(mutex_);
+    auto it = entries_.find(serialNo);
+    if (it == entries_.end())
         return {};
+    return it->second.connection.lock();
+}
+
+
+std::shared_ptr<KinesisDeviceConnection>
+ConnectionRegistry::GetOrOpen(std::unique_ptr<KinesisDeviceAccess> access) {
+    std::string const serialNo = access->SerialNo();
+
+    // Fast path: already open
+    auto existing = Find(serialNo);
+    if (existing)
+        return existing;
+
+    {
+        std::unique_lock<std::shared_timed_mutex> lock(mutex_);
+        openFinished_.wait(lock, [&] {
+            auto it = entries_.find(serialNo);
+            return it == entries_.end() || !it->second.opening;
+        });
+
+        PruneLocked();
+
+        Entry& entry = entries_[serialNo];
+        existing = entry.connection.lock();
+        if (existing)
+            return existing; // Opened by another thread meanwhile
+        entry.opening = true;
     }
 
-    return UniqueConnection(std::move(access));
+    std::shared_ptr<KinesisDeviceConnection> newConn;
+    try {
+        newConn = std::make_shared<KinesisDeviceConnection>(std::move(access));
+    }
+    catch (...) {
+        FinishOpening(serialNo, nullptr);
+        throw;
+    }
+    FinishOpening(serialNo, newConn);
+    return newConn;
 }
 
 
-std::unique_ptr<MotorDrive> MakeKinesisMotorDrive(
-    std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+void
+ConnectionRegistry::PruneLocked() {
+    for (auto it = entries_.begin(); it != entries_.end(); ) {
+        if (!it->second.opening && it->second.connection.expired())
+            it = entries_.erase(it);
+        else
+            ++it;
+    }
+}
 
-    switch (TypeIDOfSerialNo(connection->SerialNo())) {
-    case TypeIDBenchtopBrushless:
-        return std::make_unique<BenchtopBrushless>(connection, channel);
 
-    case TypeIDBenchtopDCServo1Channel:
-    case TypeIDBenchtopDCServo3Channel:
-        return std::make_unique<BenchtopDCServo>(connection, channel);
+void
+ConnectionRegistry::FinishOpening(std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> const& connection) {
+    {
+        std::lock_guard<std::shared_timed_mutex> lock(mutex_);
+        Entry& entry = entries_[serialNo];
+        entry.connection = connection;
+        entry.opening = false;
+    }
+    openFinished_.notify_all();
+}
 
-    case TypeIDBenchtopStepper1Channel:
-    case TypeIDBenchtopStepper3Channel:
-        return std::make_unique<BenchtopStepper>(connection, channel);
 
-    case TypeIDKCubeBrushless:
-        return std::make_unique<KCubeBrushless>(connection);
+std::shared_ptr<KinesisDeviceConnection> UniqueConnection(
+    std::unique_ptr<KinesisDeviceAccess> access) {
+    return ConnectionRegistry::Instance().GetOrOpen(std::move(access));
+}
 
-    case TypeIDKCubeDCServo:
-        return std::make_unique<KCubeDCServo>(connection);
 
-    case TypeIDKCubeStepper:
-        return std::make_unique<KCubeStepper>(connection);
+namespace {
+    template <typename Access>
+    std::unique_ptr<KinesisDeviceAccess> MakeAccess(
+        std::string const& serialNo) {
+        return std::make_unique<Access>(serialNo);
+    }
 
-    case TypeIDTCubeBrushless:
-        return std::make_unique<TCubeBrushless>(connection);
+    template <typename Drive>
+    std::unique_ptr<MotorDrive> MakeMotorDrive(
+        std::shared_ptr<KinesisDeviceConnection> connection, short) {
+        return std::make_unique<Drive>(connection);
+    }
 
-    case TypeIDTCubeDCServo:
-        return std::make_unique<TCubeDCServo>(connection);
+    template <typename Drive>
+    std::unique_ptr<MotorDrive> MakeMultiChannelMotorDrive(
+        std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+        return std::make_unique<Drive>(connection, channel);
+    }
 
-    case TypeIDTCubeStepper:
-        return std::make_unique<TCubeStepper>(connection);
+    template <typename Drive>
+    std::unique_ptr<PiezoDrive> MakePiezoDrive(
+        std::shared_ptr<KinesisDeviceConnection> connection) {
+        return std::make_unique<Drive>(connection);
+    }
+}
 
-    case TypeIDLabJack050:
-    case TypeIDLabJack490:
-    case TypeIDLongTravelStage:
-    case TypeIDCageRotator:
-        return std::make_unique<IntegratedStepper>(connection);
 
-    case TypeIDVerticalStage:
-        return std::make_unique<VerticalStage>(connection);
+#define MOTOR_FAMILY(family) \
+    DeviceFamily const family##Family = { &MakeAccess<family##Access>, \
+        &family##Access::PreloadDriver, &MakeMotorDrive<family>, nullptr }
+#define MULTI_CHANNEL_MOTOR_FAMILY(family) \
+    DeviceFamily const family##Family = { &MakeAccess<family##Access>, \
+        &family##Access::PreloadDriver, &MakeMultiChannelMotorDrive<family>, \
+        nullptr }
+#define PIEZO_FAMILY(family) \
+    DeviceFamily const family##Family = { &MakeAccess<family##Access>, \
+        &family##Access::PreloadDriver, nullptr, &MakePiezoDrive<family> }
+
+MULTI_CHANNEL_MOTOR_FAMILY(BenchtopBrushless);
+MULTI_CHANNEL_MOTOR_FAMILY(BenchtopDCServo);
+MULTI_CHANNEL_MOTOR_FAMILY(BenchtopStepper);
+MOTOR_FAMILY(IntegratedStepper);
+MOTOR_FAMILY(KCubeBrushless);
+MOTOR_FAMILY(KCubeDCServo);
+PIEZO_FAMILY(KCubePiezo);
+MOTOR_FAMILY(KCubeStepper);
+MOTOR_FAMILY(TCubeBrushless);
+MOTOR_FAMILY(TCubeDCServo);
+MOTOR_FAMILY(TCubeStepper);
+MOTOR_FAMILY(VerticalStage);
+
+#undef MOTOR_FAMILY
+#undef MULTI_CHANNEL_MOTOR_FAMILY
+#undef PIEZO_FAMILY
 
-    default:
+
+std::shared_ptr<KinesisDeviceConnection> MakeConnection(std::string const& serialNo) {
+    DeviceFamily const* family = FindDeviceFamily(TypeIDOfSerialNo(serialNo));
+    if (!family)
         return {};
-    }
+
+    // Supported types only, so that mocks behave like the real thing
+    std::unique_ptr<KinesisDeviceAccess> access = IsMockDevice(serialNo) ?
+        MakeMockAccess(serialNo) : family->makeAccess(serialNo);
+
+    return UniqueConnection(std::move(access));
+}
+
+
+bool PreloadKinesisDriver(uint32_t typeID) {
+    if (IsMockKinesisEnabled())
+        return true;
+
+    DeviceFamily const* family = FindDeviceFamily(typeID);
+    return family && family->preloadDriver();
+}
+
+
+std::unique_ptr<MotorDrive> MakeKinesisMotorDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+
+    if (IsMockDevice(connection->SerialNo()))
+        return MakeMockMotorDrive(connection, channel);
+
+    DeviceFamily const* family =
+        FindDeviceFamily(TypeIDOfSerialNo(connection->SerialNo()));
+    if (!family || !family->makeMotorDrive)
+        return {};
+    return family->makeMotorDrive(connection, channel);
+}
+
+
+std::unique_ptr<PiezoDrive> MakeKinesisPiezoDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection) {
+
+    // There are no mock piezo drives
+    if (IsMockDevice(connection->SerialNo()))
+        return {};
+
+    DeviceFamily const* family =
+        FindDeviceFamily(TypeIDOfSerialNo(connection->SerialNo()));
+    if (!family || !family->makePiezoDrive)
+        return {};
+    return family->makePiezoDrive(connection);
 }
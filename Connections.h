@@ -34,42 +34,69 @@
 
 #include "KinesisDevice.h"
 
+#include <condition_variable>
+#include <cstdint>
 #include <memory>
+#include <mutex>
+#include <shared_mutex>
 #include <string>
 #include <unordered_map>
 
 
-// Get the connection to the given device if one exists; otherwise make the
-// connection using the given callback.
-// This is not thread safe, but MMCore ensures synchronization for us.
-inline std::shared_ptr<KinesisDeviceConnection> UniqueConnection(
-    std::unique_ptr<KinesisDeviceAccess> access) {
+// Registry of open connections, uniqued by serial number, so that a device is
+// opened only once and all channels of a multi-channel controller share the
+// connection. Entries hold weak references; a device is closed when the last
+// MotorDrive (or other user) releases its connection.
+//
+// This is thread safe. Lookups of open connections take a shared lock, so
+// they do not block one another. Opening a device can take a while, so it is
+// done outside of the lock; concurrent requests for the same serial number
+// wait for the first one to finish opening, rather than opening the device
+// twice.
+class ConnectionRegistry {
+    struct Entry {
+        std::weak_ptr<KinesisDeviceConnection> connection;
+        bool opening = false;
+    };
+
+    // C++17 will have std::shared_mutex
+    std::shared_timed_mutex mutex_;
+    std::condition_variable_any openFinished_;
+    std::unordered_map<std::string, Entry> entries_;
+
+public:
+    static ConnectionRegistry& Instance();
 
-    // Connections uniqued by serial number
-    static std::unordered_map<std::string, std::weak_ptr<KinesisDeviceConnection>> connections;
+    // Get the connection to the given device if one is open (null otherwise)
+    std::shared_ptr<KinesisDeviceConnection> Find(std::string const& serialNo);
 
-    // Prune closed connections
-    decltype(connections) pruned;
-    for (auto&& item : connections) {
-        if (!item.second.expired())
-            pruned.emplace(std::move(item));
-    }
-    connections.swap(pruned);
+    // Get the connection to the device if one exists; otherwise make the
+    // connection using the given access object.
+    std::shared_ptr<KinesisDeviceConnection> GetOrOpen(
+        std::unique_ptr<KinesisDeviceAccess> access);
 
-    auto existing = connections.find(access->SerialNo());
-    if (existing != connections.end()) {
-        auto ret = existing->second.lock();
-        if (ret)
-            return ret;
-    }
+private:
+    void PruneLocked(); // Must hold exclusive lock
+    void FinishOpening(std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> const& connection);
+};
 
-    auto newConn = std::make_shared<KinesisDeviceConnection>(std::move(access));
-    connections[newConn->SerialNo()] = newConn;
-    return newConn;
-}
+
+// Shorthand for ConnectionRegistry::Instance().GetOrOpen()
+std::shared_ptr<KinesisDeviceConnection> UniqueConnection(
+    std::unique_ptr<KinesisDeviceAccess> access);
 
 
 std::shared_ptr<KinesisDeviceConnection> MakeConnection(std::string const& serialNo);
 
+// Load the Kinesis DLL for the device type and resolve its functions, so that
+// opening the first device of the type does not wait for the loader. Returns
+// false if the type is unsupported or the DLL cannot be loaded. Thread safe.
+bool PreloadKinesisDriver(uint32_t typeID);
+
 std::unique_ptr<MotorDrive> MakeKinesisMotorDrive(
     std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+
+// Null if the device is not a (supported) piezo controller
+std::unique_ptr<PiezoDrive> MakeKinesisPiezoDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection);
@@ -37,19 +37,20 @@
 
 HMODULE
 DLLAccess::Load(std::string const& name) {
-    static std::string prefix;
-    if (prefix.empty()) {
+    // Initialized once, even if different DLLs are loaded concurrently
+    static std::string const prefix = [] {
         char programFilesPath[MAX_PATH];
         BOOL ok = SHGetSpecialFolderPathA(nullptr, programFilesPath,
             CSIDL_PROGRAM_FILES, false);
         if (!ok)
-            return nullptr;
+            return std::string{};
 
         // Note: Forward slashes do NOT work with LoadLibrary()!
 
-        prefix = programFilesPath;
-        prefix += "\\Thorlabs\\Kinesis";
-    }
+        return std::string{ programFilesPath } + "\\Thorlabs\\Kinesis";
+    }();
+    if (prefix.empty())
+        return nullptr;
 
     std::string dllPath = prefix + "\\" + name;
 
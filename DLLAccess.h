@@ -32,6 +32,10 @@
 
 #pragma once
 
+#include "DLLCallStats.h"
+
+#include <atomic>
+#include <mutex>
 #include <string>
 #include <type_traits>
 #include <utility>
@@ -53,7 +57,9 @@
 
 // RAII object to load DLL, hard-coded to Kinesis install location.
 class DLLAccess {
-    HMODULE dll_{ nullptr };
+    std::mutex mutex_;
+    std::atomic<HMODULE> dll_{ nullptr };
+    bool loadAttempted_{ false }; // Guarded by mutex_
     std::string const name_;
 
 public:
@@ -67,21 +73,30 @@ public:
     }
 
     ~DLLAccess() {
-        Unload(dll_);
+        Unload(dll_.load());
     }
 
+    std::string const& Name() const { return name_; }
+
+    // Thread safe (devices may be opened concurrently). Once loaded, this
+    // takes no lock. Loading is attempted only once, so that a missing DLL
+    // does not cost a file system search on every call.
     bool IsValid() {
-        if (!dll_) {
-            dll_ = Load(name_);
+        if (dll_.load(std::memory_order_acquire))
+            return true;
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!loadAttempted_) {
+            loadAttempted_ = true;
+            dll_.store(Load(name_), std::memory_order_release);
         }
-        return dll_ != nullptr;
+        return dll_.load(std::memory_order_relaxed) != nullptr;
     }
 
     template<typename F>
     F* GetFunction(char const* func) {
         if (!IsValid())
             return nullptr;
-        return reinterpret_cast<F*>(GetProcAddress(dll_, func));
+        return reinterpret_cast<F*>(GetProcAddress(dll_.load(), func)); // Thread safe
     }
 
 private:
@@ -95,14 +110,18 @@ private:
 template<typename F>
 class DLLFunc {
     F* const func_;
+    DLLCallStats* const stats_;
 
 public:
     DLLFunc(DLLAccess& dll, char const* func) :
-        func_{ dll.GetFunction<F>(func) }
+        func_{ dll.GetFunction<F>(func) },
+        // Qualified by DLL, because different DLLs use the same names
+        stats_{ DLLCallStats::Get(dll.Name() + ":" + func) }
     {}
 
     template<typename... Args>
     decltype(auto) operator()(Args&&... args) {
+        DLLCallTimer timer{ stats_ };
         return func_(std::forward<Args>(args)...);
     }
 };
@@ -0,0 +1,187 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DLLCallStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+
+
+std::atomic<bool> DLLCallStats::enabled_{ false };
+
+
+namespace {
+    class Registry {
+        std::mutex mutex_;
+        std::map<std::string, std::unique_ptr<DLLCallStats>> stats_;
+
+    public:
+        static Registry& Instance() {
+            static Registry instance;
+            return instance;
+        }
+
+        DLLCallStats* Get(std::string const& name) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& stats = stats_[name];
+            if (!stats)
+                stats = std::make_unique<DLLCallStats>(name);
+            return stats.get();
+        }
+
+        std::vector<DLLCallStats*> All() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<DLLCallStats*> ret;
+            for (auto const& item : stats_)
+                ret.push_back(item.second.get());
+            return ret;
+        }
+    };
+
+    size_t BucketOf(std::uint64_t ns) {
+        std::uint64_t us = ns / 1000;
+        size_t bucket = 0;
+        while (us > 0 && bucket < DLLCallStats::NumHistogramBuckets - 1) {
+            us >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    // Upper edge of the bucket containing the given quantile, in us
+    std::uint64_t QuantileUs(DLLCallStats::Summary const& summary,
+        double quantile) {
+        auto const target = static_cast<std::uint64_t>(
+            quantile * static_cast<double>(summary.calls));
+        std::uint64_t count = 0;
+        for (size_t i = 0; i < summary.histogram.size(); ++i) {
+            count += summary.histogram[i];
+            if (count > target)
+                return std::uint64_t{ 1 } << i;
+        }
+        return std::uint64_t{ 1 } << (summary.histogram.size() - 1);
+    }
+}
+
+
+void
+DLLCallStats::Record(std::uint64_t ns) {
+    calls_.fetch_add(1, std::memory_order_relaxed);
+    totalNs_.fetch_add(ns, std::memory_order_relaxed);
+    histogram_[BucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+
+    std::uint64_t max = maxNs_.load(std::memory_order_relaxed);
+    while (ns > max &&
+        !maxNs_.compare_exchange_weak(max, ns, std::memory_order_relaxed))
+        ;
+}
+
+
+DLLCallStats::Summary
+DLLCallStats::GetSummary() const {
+    // Counters are read individually, so may be slightly inconsistent if
+    // calls are in progress
+    Summary summary;
+    summary.name = name_;
+    summary.calls = calls_.load(std::memory_order_relaxed);
+    summary.totalNs = totalNs_.load(std::memory_order_relaxed);
+    summary.maxNs = maxNs_.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < NumHistogramBuckets; ++i)
+        summary.histogram[i] = histogram_[i].load(std::memory_order_relaxed);
+    return summary;
+}
+
+
+void
+DLLCallStats::Reset() {
+    calls_ = 0;
+    totalNs_ = 0;
+    maxNs_ = 0;
+    for (auto& count : histogram_)
+        count = 0;
+}
+
+
+DLLCallStats*
+DLLCallStats::Get(std::string const& name) {
+    return Registry::Instance().Get(name);
+}
+
+
+std::vector<DLLCallStats::Summary>
+DLLCallStats::GetAllSummaries() {
+    std::vector<Summary> summaries;
+    for (DLLCallStats* stats : Registry::Instance().All()) {
+        Summary summary = stats->GetSummary();
+        if (summary.calls > 0)
+            summaries.push_back(summary);
+    }
+    std::sort(summaries.begin(), summaries.end(),
+        [](Summary const& lhs, Summary const& rhs) {
+            return lhs.totalNs > rhs.totalNs;
+        });
+    return summaries;
+}
+
+
+void
+DLLCallStats::ResetAll() {
+    for (DLLCallStats* stats : Registry::Instance().All())
+        stats->Reset();
+}
+
+
+std::string
+DLLCallStats::FormatReport() {
+    auto const summaries = GetAllSummaries();
+    if (summaries.empty())
+        return "No Kinesis calls recorded";
+
+    std::string report = "Kinesis calls (times in us; percentiles are "
+        "upper bucket edges):\n"
+        "calls\ttotal\tmean\tp50\tp99\tmax\tfunction\n";
+    for (auto const& summary : summaries) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%llu\t%llu\t%.1f\t%llu\t%llu\t%llu\t",
+            static_cast<unsigned long long>(summary.calls),
+            static_cast<unsigned long long>(summary.totalNs / 1000),
+            summary.totalNs / 1000.0 / summary.calls,
+            static_cast<unsigned long long>(QuantileUs(summary, 0.5)),
+            static_cast<unsigned long long>(QuantileUs(summary, 0.99)),
+            static_cast<unsigned long long>(summary.maxNs / 1000));
+        report += line + summary.name + "\n";
+    }
+    return report;
+}
@@ -0,0 +1,124 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Optional instrumentation of calls into the Kinesis DLLs. Every function
+// accessed through STATIC_DLL_FUNC has a DLLCallStats object; while
+// collection is disabled (the default), the only cost per call is checking
+// the flag. Recording is lock-free, so calls from polling and user threads
+// do not contend.
+class DLLCallStats {
+public:
+    // Bucket i counts calls taking [2^(i-1), 2^i) us (bucket 0: < 1 us; the
+    // last bucket also counts anything longer)
+    static size_t const NumHistogramBuckets = 24;
+
+    struct Summary {
+        std::string name;
+        std::uint64_t calls;
+        std::uint64_t totalNs;
+        std::uint64_t maxNs;
+        std::array<std::uint64_t, NumHistogramBuckets> histogram;
+    };
+
+private:
+    std::string const name_;
+    std::atomic<std::uint64_t> calls_{ 0 };
+    std::atomic<std::uint64_t> totalNs_{ 0 };
+    std::atomic<std::uint64_t> maxNs_{ 0 };
+    std::array<std::atomic<std::uint64_t>, NumHistogramBuckets> histogram_{};
+
+    static std::atomic<bool> enabled_;
+
+public:
+    explicit DLLCallStats(std::string const& name) :
+        name_{ name }
+    {}
+
+    std::string const& Name() const { return name_; }
+
+    void Record(std::uint64_t ns);
+    Summary GetSummary() const;
+    void Reset();
+
+    static bool IsEnabled() {
+        return enabled_.load(std::memory_order_relaxed);
+    }
+    static void SetEnabled(bool enabled) { enabled_ = enabled; }
+
+    // Returns the (permanent) stats object for the given name, creating it
+    // if necessary. Thread safe.
+    static DLLCallStats* Get(std::string const& name);
+
+    // Summaries of all functions that have been called, in order of total
+    // time spent, most first
+    static std::vector<Summary> GetAllSummaries();
+    static void ResetAll();
+
+    // Human-readable table, one line per function
+    static std::string FormatReport();
+};
+
+
+// Times a single call, if collection is enabled
+class DLLCallTimer {
+    DLLCallStats* const stats_;
+    std::chrono::steady_clock::time_point start_;
+
+public:
+    explicit DLLCallTimer(DLLCallStats* stats) :
+        stats_{ DLLCallStats::IsEnabled() ? stats : nullptr }
+    {
+        if (stats_)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    ~DLLCallTimer() {
+        if (stats_) {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            stats_->Record(static_cast<std::uint64_t>(std::chrono::
+                duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+        }
+    }
+
+    DLLCallTimer(DLLCallTimer const&) = delete;
+    DLLCallTimer& operator=(DLLCallTimer const&) = delete;
+};
@@ -33,6 +33,7 @@
 #include "DeviceEnumeration.h"
 
 #include "DLLAccess.h"
+#include "MockKinesis.h"
 
 // In the main part of this device adapter we want device enumeration, but not
 // control of each device type. In other words we need only the TLI_*
@@ -43,10 +44,15 @@
 // at a time.
 #include <Thorlabs.MotionControl.Benchtop.BrushlessMotor.h>
 
-#include <sstream>
+#include <cstring>
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.Benchtop.BrushlessMotor.dll" };
+static DLLAccess kinesisDll{ FindDeviceType(TypeIDBenchtopBrushless)->dllName };
+
+// TLI_BuildDeviceList() fails with error 16 (FT_NoDLLLoaded) if we don't help
+// it load this FTDI DLL in the Thorlabs/Kinesis directory. It is kept loaded,
+// so that the device DLLs also find it already loaded.
+static DLLAccess ftdiDll{ "ftd2xx.dll" };
 
 
 struct KinesisDeviceInfo::Impl {
@@ -91,6 +97,15 @@ struct KinesisDeviceInfo::Impl {
 KinesisDeviceInfo::KinesisDeviceInfo(std::string const& serialNo) :
     impl_{ std::make_unique<Impl>() }
 {
+    if (IsMockDevice(serialNo)) {
+        // (Buffers are zeroed and large enough)
+        impl_->info_.typeID = TypeIDOfSerialNo(serialNo);
+        std::string{ "Mock device" }.copy(impl_->info_.description,
+            sizeof(impl_->info_.description) - 1);
+        serialNo.copy(impl_->info_.serialNo, sizeof(impl_->info_.serialNo) - 1);
+        return;
+    }
+
     STATIC_DLL_FUNC(kinesisDll, TLI_GetDeviceInfo, getDeviceInfoFunc);
 
     if (!getDeviceInfoFunc(serialNo.c_str(), &impl_->info_)) {
@@ -152,10 +167,17 @@ KinesisDeviceInfo::GetDescription() const {
 
 
 bool IsKinesisDriverAvailable() {
+    if (IsMockKinesisEnabled())
+        return true;
     return kinesisDll.IsValid();
 }
 
 
+bool PreloadFTDIDriver() {
+    return ftdiDll.IsValid(); // Trigger the lazy load
+}
+
+
 void EnableSimulatedDevices() {
     STATIC_DLL_FUNC(kinesisDll, TLI_InitializeSimulations, func);
     func();
@@ -169,14 +191,14 @@ void DisableSimulatedDevices() {
 
 
 std::vector<std::string> EnumerateSerialNumbers() {
+    if (IsMockKinesisEnabled())
+        return MockSerialNumbers();
+
     STATIC_DLL_FUNC(kinesisDll, TLI_BuildDeviceList, buildDeviceListFunc);
     STATIC_DLL_FUNC(kinesisDll, TLI_GetDeviceListSize, getDeviceListSizeFunc);
     STATIC_DLL_FUNC(kinesisDll, TLI_GetDeviceListExt, getDeviceListExtFunc);
 
-    // TLI_BuildDeviceList() fails with error 16 (FT_NoDLLLoaded) if we don't
-    // help it load this FTDI DLL in the Thorlabs/Kinesis directory.
-    DLLAccess ftdiDll{ "ftd2xx.dll" };
-    ftdiDll.IsValid(); // Trigger the lazy load
+    PreloadFTDIDriver();
 
     short err;
     err = buildDeviceListFunc();
@@ -195,11 +217,14 @@ std::vector<std::string> EnumerateSerialNumbers() {
     if (err)
         return {};
 
+    // Each serial number is followed by a comma
     std::vector<std::string> ret;
-    std::istringstream serialNoStream{ serialNoBuffer.get() };
-    std::string serialNo;
-    while (std::getline(serialNoStream, serialNo, ',').good())
-        ret.push_back(serialNo);
+    ret.reserve(deviceCount);
+    char const* p = serialNoBuffer.get();
+    while (char const* comma = std::strchr(p, ',')) {
+        ret.emplace_back(p, comma);
+        p = comma + 1;
+    }
 
     return ret;
 }
@@ -32,6 +32,8 @@
 
 #pragma once
 
+#include "DeviceTypes.h"
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -77,82 +79,19 @@ inline uint32_t TypeIDOfSerialNo(std::string const& serialNo) {
 }
 
 
-enum KinesisDeviceTypeID {
-    // Sorted ascii-lexicographically.
-    // Sources:
-    //   'doc' - Kinesis C API documentation
-    //   'net' - Kinesis .NET API documentation (only indicated if not in 'doc')
-    //   'sim' - Kinesis Simulator (only indicated if not in 'doc' or 'net')
-    TypeIDBenchtopBrushless = 73, // doc
-    TypeIDBenchtopDCServo1Channel = 43, // net
-    TypeIDBenchtopDCServo3Channel = 79, // net
-    TypeIDBenchtopNanotrak = 22, // doc
-    TypeIDBenchtopPiezo1Channel = 41, // doc
-    TypeIDBenchtopPiezo3Channel = 71, // doc
-    TypeIDBenchtopPrecisionPiezo1Channel = 44, // net
-    TypeIDBenchtopPrecisionPiezo2Channel = 95, // net
-    TypeIDBenchtopStepper1Channel = 40, // doc
-    TypeIDBenchtopStepper3Channel = 70, // doc
-    TypeIDCageRotator = 55, // doc
-    TypeIDFilterFlipper = 37, // doc
-    TypeIDFilterWheel = 47, // doc
-    TypeIDKCubeBrushless = 28, // doc
-    TypeIDKCubeDCServo = 27, // doc
-    TypeIDKCubeInertialMotor = 97, // doc
-    TypeIDKCubeLaserDiode = 98, // net
-    TypeIDKCubeLaserSource = 56, // doc
-    TypeIDKCubeNanoTrak = 57, // doc
-    TypeIDKCubePiezo = 29, // doc
-    TypeIDKCubePositionAligner = 69, // net
-    TypeIDKCubeSolenoid = 68, // doc
-    TypeIDKCubeStepper = 26, // doc
-    TypeIDKCubeStrainGauge = 59, // sim
-    TypeIDLabJack050 = 49, // doc; includes 150 (sim)
-    TypeIDLabJack490 = 46, // doc
-    TypeIDLongTravelStage = 45, // doc
-    TypeIDModularNanoTrak = 52, // doc
-    TypeIDModularPiezo = 51, // doc
-    TypeIDModularStepper = 50, // doc
-    TypeIDPolarizer = 38, // doc
-    TypeIDTCubeBrushless = 67, // doc
-    TypeIDTCubeDCServo = 83, // doc
-    TypeIDTCubeInertialMotor = 65, // doc
-    TypeIDTCubeLaserDiode = 64, // doc
-    TypeIDTCubeLaserSource = 86, // doc
-    TypeIDTCubeNanoTrak = 82, // doc
-    TypeIDTCubePiezo = 81, // sim
-    TypeIDTCubeQuad = 89, // doc; aka position aligner
-    TypeIDTCubeSolenoid = 85, // doc
-    TypeIDTCubeStepper = 80, // doc
-    TypeIDTCubeStrainGauge = 84, // doc
-    TypeIDTCubeTEC = 87, // doc
-    TypeIDVerticalStage = 24, // doc
-};
-
-
 // Return true if API is multi-channel (even if device is single-channel)
 inline bool IsPotentiallyMultiChannel(std::string const& serialNo) {
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDBenchtopBrushless:
-    case TypeIDBenchtopDCServo1Channel:
-    case TypeIDBenchtopDCServo3Channel:
-    case TypeIDBenchtopPiezo1Channel:
-    case TypeIDBenchtopPiezo3Channel:
-    case TypeIDBenchtopPrecisionPiezo2Channel: // Note only PPC2_, not PPC_
-    case TypeIDBenchtopStepper1Channel:
-    case TypeIDBenchtopStepper3Channel:
-    case TypeIDModularPiezo:
-    case TypeIDModularStepper:
-        return true;
-    default:
-        return false;
-    }
+    DeviceType const* type = FindDeviceType(TypeIDOfSerialNo(serialNo));
+    return type && type->channelModel == ChannelModelMulti;
 }
 
 
 // If this returns false, all functions that access Kinesis will crash.
 bool IsKinesisDriverAvailable();
 
+// Load the FTDI USB driver DLL (done anyway by EnumerateSerialNumbers())
+bool PreloadFTDIDriver();
+
 // Must be called before EnumerateSerialNumbers() if using simulated devices
 void EnableSimulatedDevices();
 
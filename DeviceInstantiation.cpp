@@ -34,35 +34,36 @@
 
 #include "DeviceEnumeration.h"
 
+#include "PiezoStage.h"
 #include "SingleAxisStage.h"
 #include "UnsupportedDevice.h"
 
+#include <algorithm>
+#include <mutex>
+
+
+namespace {
+    std::mutex configuredDevicesMutex;
+    std::vector<std::string> configuredDevices; // One item per channel
+}
+
 
 MM::Device* MakeDevice(std::string const& name, std::string const& serialNo,
-    short channel, std::shared_ptr<KinesisDeviceConnection> connection) {
+    short channel, std::shared_ptr<KinesisDeviceConnection> connection,
+    std::shared_ptr<DeviceInventory> inventory) {
     if (!IsValidSerialNo(serialNo))
         return nullptr;
 
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDKCubeBrushless:
-    case TypeIDKCubeDCServo:
-    case TypeIDKCubeStepper:
-    case TypeIDTCubeBrushless:
-    case TypeIDTCubeDCServo:
-    case TypeIDTCubeStepper:
-    case TypeIDLabJack050:
-    case TypeIDLabJack490:
-    case TypeIDLongTravelStage:
-    case TypeIDCageRotator:
-    case TypeIDVerticalStage:
-        return new SingleAxisStage{ name, serialNo, -1, connection };
-
-    case TypeIDBenchtopBrushless:
-    case TypeIDBenchtopDCServo1Channel:
-    case TypeIDBenchtopDCServo3Channel:
-    case TypeIDBenchtopStepper1Channel:
-    case TypeIDBenchtopStepper3Channel:
-        return new SingleAxisStage{ name, serialNo, channel, connection };
+    DeviceType const* type = FindDeviceType(TypeIDOfSerialNo(serialNo));
+    switch (type ? type->stageKind : StageKindNone) {
+    case StageKindMotor:
+        if (type->channelModel == ChannelModelSingle)
+            channel = -1;
+        return new SingleAxisStage{ name, serialNo, channel, connection,
+            inventory };
+
+    case StageKindPiezo:
+        return new PiezoStage{ name, serialNo, connection, inventory };
 
     default:
         // Unsupported device: create placeholder only for first channel if it
@@ -83,3 +84,45 @@ MM::Device* MakeUnsupportedDevice(std::string const& serialNo) {
 
     return new UnsupportedDevice{ serialNo };
 }
+
+
+std::string MakeDeviceName(std::string const& modelNo,
+    std::string const& serialNo, short channel) {
+    std::string name = modelNo;
+
+    name += '_';
+    name += serialNo;
+
+    if (channel > 0) {
+        name += '-';
+        name += std::to_string(channel);
+    }
+
+    return name;
+}
+
+
+void RegisterConfiguredDevice(std::string const& serialNo) {
+    std::lock_guard<std::mutex> lock(configuredDevicesMutex);
+    configuredDevices.push_back(serialNo);
+}
+
+
+void UnregisterConfiguredDevice(std::string const& serialNo) {
+    std::lock_guard<std::mutex> lock(configuredDevicesMutex);
+    auto it = std::find(configuredDevices.begin(), configuredDevices.end(),
+        serialNo);
+    if (it != configuredDevices.end())
+        configuredDevices.erase(it);
+}
+
+
+std::vector<std::string> ConfiguredSerialNumbers() {
+    std::lock_guard<std::mutex> lock(configuredDevicesMutex);
+    std::vector<std::string> ret;
+    for (auto const& serialNo : configuredDevices) {
+        if (std::find(ret.begin(), ret.end(), serialNo) == ret.end())
+            ret.push_back(serialNo);
+    }
+    return ret;
+}
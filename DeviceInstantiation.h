@@ -34,13 +34,30 @@
 
 #include "MMDevice.h"
 
+#include "DeviceInventory.h"
 #include "KinesisDevice.h"
 
 #include <string>
+#include <vector>
 
 
 // Creates a device object of the correct type for the serial number.
-// Returns an owning pointer.
+// Returns an owning pointer. The connection and inventory are optional.
 MM::Device* MakeDevice(std::string const& name, std::string const& serialNo,
-    short channel, std::shared_ptr<KinesisDeviceConnection> connection = {});
+    short channel, std::shared_ptr<KinesisDeviceConnection> connection = {},
+    std::shared_ptr<DeviceInventory> inventory = {});
 MM::Device* MakeUnsupportedDevice(std::string const& serialNo);
+
+// Device name: ModelNo_SerialNo, or ModelNo_SerialNo-Channel for channels of
+// multi-channel devices (channel > 0)
+std::string MakeDeviceName(std::string const& modelNo,
+    std::string const& serialNo, short channel);
+
+
+// Registry of the peripherals created by name (i.e. from the configuration),
+// so that the Hub can open their connections ahead of Initialize(). Thread
+// safe.
+void RegisterConfiguredDevice(std::string const& serialNo);
+void UnregisterConfiguredDevice(std::string const& serialNo);
+// Each serial number once, in registration order
+std::vector<std::string> ConfiguredSerialNumbers();
@@ -0,0 +1,251 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DeviceInventory.h"
+
+#include "DeviceEnumeration.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+
+namespace {
+    char const* const INVENTORY_FILE_HEADER = "# Thorlabs Kinesis device inventory v1";
+}
+
+
+KinesisDevice::HardwareInfo const*
+DeviceInventoryEntry::ChannelHardwareInfo(short channel) const {
+    size_t index = channel > 0 ? channel - 1 : 0;
+    if (index >= hardwareInfo.size())
+        return nullptr;
+    return &hardwareInfo[index];
+}
+
+
+void
+DeviceInventory::Clear() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
+
+
+void
+DeviceInventory::Reconcile(std::vector<std::string> const& serialNos) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<DeviceInventoryEntry> reconciled;
+    for (auto const& serialNo : serialNos) {
+        auto existing = std::find_if(entries_.begin(), entries_.end(),
+            [&](DeviceInventoryEntry const& e) { return e.serialNo == serialNo; });
+        if (existing != entries_.end()) {
+            reconciled.push_back(std::move(*existing));
+        }
+        else {
+            DeviceInventoryEntry entry;
+            entry.serialNo = serialNo;
+            entry.typeID = TypeIDOfSerialNo(serialNo);
+            reconciled.push_back(std::move(entry));
+        }
+    }
+    entries_.swap(reconciled);
+}
+
+
+void
+DeviceInventory::Set(DeviceInventoryEntry const& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto existing = std::find_if(entries_.begin(), entries_.end(),
+        [&](DeviceInventoryEntry const& e) { return e.serialNo == entry.serialNo; });
+    if (existing != entries_.end())
+        *existing = entry;
+    else
+        entries_.push_back(entry);
+}
+
+
+void
+DeviceInventory::Remove(std::string const& serialNo) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(std::remove_if(entries_.begin(), entries_.end(),
+        [&](DeviceInventoryEntry const& e) { return e.serialNo == serialNo; }),
+        entries_.end());
+}
+
+
+void
+DeviceInventory::SetChannelHardwareInfo(std::string const& serialNo,
+    short channel, KinesisDevice::HardwareInfo const& info) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto existing = std::find_if(entries_.begin(), entries_.end(),
+        [&](DeviceInventoryEntry const& e) { return e.serialNo == serialNo; });
+    if (existing == entries_.end())
+        return;
+
+    size_t index = channel > 0 ? channel - 1 : 0;
+    if (existing->hardwareInfo.size() <= index)
+        existing->hardwareInfo.resize(index + 1);
+    existing->hardwareInfo[index] = info;
+    existing->connectionError = 0;
+}
+
+
+bool
+DeviceInventory::Find(std::string const& serialNo,
+    DeviceInventoryEntry& entry) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto existing = std::find_if(entries_.begin(), entries_.end(),
+        [&](DeviceInventoryEntry const& e) { return e.serialNo == serialNo; });
+    if (existing == entries_.end())
+        return false;
+    entry = *existing;
+    return true;
+}
+
+
+std::vector<DeviceInventoryEntry>
+DeviceInventory::Entries() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_;
+}
+
+
+void
+DeviceInventory::BeginValidation() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    isValidating_ = true;
+}
+
+
+void
+DeviceInventory::EndValidation() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        isValidating_ = false;
+    }
+    validated_.notify_all();
+}
+
+
+void
+DeviceInventory::WaitForValidation() const {
+    std::unique_lock<std::mutex> lock(mutex_);
+    validated_.wait(lock, [&] { return !isValidating_; });
+}
+
+
+// File format: header line, then tab-separated lines of
+// serialNo, typeID, numChannels, channel, modelNo, type, firmwareVersion,
+// hardwareVersion, modificationState, notes
+// where channel is 1-based, or 0 for a device with no known hardware info.
+// An empty modelNo marks a channel whose hardware info is not known.
+
+bool
+DeviceInventory::LoadFromFile(std::string const& path) {
+    Clear();
+
+    std::ifstream file{ path };
+    std::string line;
+    if (!std::getline(file, line) || line != INVENTORY_FILE_HEADER)
+        return false;
+
+    std::vector<DeviceInventoryEntry> entries;
+    while (std::getline(file, line)) {
+        std::istringstream fields{ line };
+        std::string serialNo, modelNo, notes;
+        uint32_t typeID;
+        short numChannels, channel;
+        KinesisDevice::HardwareInfo info;
+        fields >> serialNo >> typeID >> numChannels >> channel;
+        fields.ignore(1, '\t');
+        std::getline(fields, info.modelNo, '\t');
+        fields >> info.type >> info.firmwareVersion >> info.hardwareVersion >>
+            info.modificationState;
+        if (fields.fail() || !IsValidSerialNo(serialNo))
+            return false;
+        // The notes are last and may be empty (which sets failbit)
+        fields.ignore(1, '\t');
+        std::getline(fields, info.notes);
+
+        if (entries.empty() || entries.back().serialNo != serialNo) {
+            DeviceInventoryEntry entry;
+            entry.serialNo = serialNo;
+            entry.typeID = typeID;
+            entry.numChannels = numChannels;
+            entries.push_back(std::move(entry));
+        }
+        auto& hardwareInfo = entries.back().hardwareInfo;
+        if (channel > 0 && !info.modelNo.empty()) {
+            if (hardwareInfo.size() < size_t(channel))
+                hardwareInfo.resize(channel);
+            hardwareInfo[channel - 1] = info;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.swap(entries);
+    return true;
+}
+
+
+bool
+DeviceInventory::SaveToFile(std::string const& path) const {
+    std::ostringstream contents;
+    contents << INVENTORY_FILE_HEADER << '\n';
+    for (auto const& entry : Entries()) {
+        // Devices that failed to open are saved without info, so that they
+        // are retried next time
+        std::vector<KinesisDevice::HardwareInfo> infos;
+        if (entry.connectionError == 0)
+            infos = entry.hardwareInfo;
+
+        short channel = infos.empty() ? 0 : 1;
+        if (infos.empty())
+            infos.push_back({});
+        for (auto const& info : infos) {
+            std::string notes = info.notes;
+            std::replace_if(notes.begin(), notes.end(),
+                [](char c) { return c == '\t' || c == '\r' || c == '\n'; }, ' ');
+            contents << entry.serialNo << '\t' << entry.typeID << '\t' <<
+                entry.numChannels << '\t' << channel << '\t' <<
+                info.modelNo << '\t' << info.type << '\t' <<
+                info.firmwareVersion << '\t' << info.hardwareVersion << '\t' <<
+                info.modificationState << '\t' << notes << '\n';
+            if (channel > 0)
+                ++channel;
+        }
+    }
+
+    std::ofstream file{ path, std::ios::trunc };
+    file << contents.str();
+    return file.good();
+}
@@ -0,0 +1,114 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Information about an enumerated device, gathered once by the hub so that
+// peripheral devices need not connect to the device to get it (connecting can
+// take about a second per device).
+struct DeviceInventoryEntry {
+    std::string serialNo;
+    uint32_t typeID = 0;
+    short numChannels = 0; // 0 if not a multi-channel device type
+    short connectionError = 0; // 0 if the device was opened
+
+    // Per channel, in order; single element if not multi-channel. Empty if
+    // not (yet) known.
+    std::vector<KinesisDevice::HardwareInfo> hardwareInfo;
+
+    // channel is -1 if not multi-channel. Returns nullptr if not known.
+    KinesisDevice::HardwareInfo const* ChannelHardwareInfo(short channel) const;
+};
+
+
+// Thread safe
+class DeviceInventory {
+    mutable std::mutex mutex_;
+    std::vector<DeviceInventoryEntry> entries_; // In enumeration order
+
+    // While the inventory is loaded from a cache file and not yet checked
+    // against the actual devices, devices must not be opened (the Kinesis
+    // device list must be built first).
+    mutable std::condition_variable validated_;
+    bool isValidating_ = false;
+
+public:
+    void Clear();
+
+    // Make the entries match the given (enumerated) serial numbers, in that
+    // order, keeping known info for devices that are still present
+    void Reconcile(std::vector<std::string> const& serialNos);
+
+    // Replaces any existing entry for the same serial number
+    void Set(DeviceInventoryEntry const& entry);
+
+    // E.g. when the device is unplugged; no-op if not in the inventory
+    void Remove(std::string const& serialNo);
+
+    // Update a single channel's hardware info (e.g. after a peripheral has
+    // connected); ignored if the serial number is not in the inventory
+    void SetChannelHardwareInfo(std::string const& serialNo, short channel,
+        KinesisDevice::HardwareInfo const& info);
+
+    bool Find(std::string const& serialNo, DeviceInventoryEntry& entry) const;
+    std::vector<DeviceInventoryEntry> Entries() const;
+
+    void BeginValidation();
+    void EndValidation();
+    // Block until any validation in progress has finished
+    void WaitForValidation() const;
+
+    // Simple text format, one line per channel. Load replaces all entries
+    // and returns false (leaving the inventory empty) if the file cannot be
+    // read or is not an inventory file.
+    bool LoadFromFile(std::string const& path);
+    bool SaveToFile(std::string const& path) const;
+};
+
+
+// Implemented by the hub, so that peripherals can find the inventory through
+// GetParentHub()
+class DeviceInventoryProvider {
+public:
+    virtual ~DeviceInventoryProvider() = default;
+    virtual std::shared_ptr<DeviceInventory> GetDeviceInventory() = 0;
+};
@@ -0,0 +1,277 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+
+class KinesisDeviceAccess;
+class KinesisDeviceConnection;
+class MotorDrive;
+class PiezoDrive;
+
+
+enum KinesisDeviceTypeID {
+    // Sorted ascii-lexicographically.
+    // Sources:
+    //   'doc' - Kinesis C API documentation
+    //   'net' - Kinesis .NET API documentation (only indicated if not in 'doc')
+    //   'sim' - Kinesis Simulator (only indicated if not in 'doc' or 'net')
+    TypeIDBenchtopBrushless = 73, // doc
+    TypeIDBenchtopDCServo1Channel = 43, // net
+    TypeIDBenchtopDCServo3Channel = 79, // net
+    TypeIDBenchtopNanotrak = 22, // doc
+    TypeIDBenchtopPiezo1Channel = 41, // doc
+    TypeIDBenchtopPiezo3Channel = 71, // doc
+    TypeIDBenchtopPrecisionPiezo1Channel = 44, // net
+    TypeIDBenchtopPrecisionPiezo2Channel = 95, // net
+    TypeIDBenchtopStepper1Channel = 40, // doc
+    TypeIDBenchtopStepper3Channel = 70, // doc
+    TypeIDCageRotator = 55, // doc
+    TypeIDFilterFlipper = 37, // doc
+    TypeIDFilterWheel = 47, // doc
+    TypeIDKCubeBrushless = 28, // doc
+    TypeIDKCubeDCServo = 27, // doc
+    TypeIDKCubeInertialMotor = 97, // doc
+    TypeIDKCubeLaserDiode = 98, // net
+    TypeIDKCubeLaserSource = 56, // doc
+    TypeIDKCubeNanoTrak = 57, // doc
+    TypeIDKCubePiezo = 29, // doc
+    TypeIDKCubePositionAligner = 69, // net
+    TypeIDKCubeSolenoid = 68, // doc
+    TypeIDKCubeStepper = 26, // doc
+    TypeIDKCubeStrainGauge = 59, // sim
+    TypeIDLabJack050 = 49, // doc; includes 150 (sim)
+    TypeIDLabJack490 = 46, // doc
+    TypeIDLongTravelStage = 45, // doc
+    TypeIDModularNanoTrak = 52, // doc
+    TypeIDModularPiezo = 51, // doc
+    TypeIDModularStepper = 50, // doc
+    TypeIDPolarizer = 38, // doc
+    TypeIDTCubeBrushless = 67, // doc
+    TypeIDTCubeDCServo = 83, // doc
+    TypeIDTCubeInertialMotor = 65, // doc
+    TypeIDTCubeLaserDiode = 64, // doc
+    TypeIDTCubeLaserSource = 86, // doc
+    TypeIDTCubeNanoTrak = 82, // doc
+    TypeIDTCubePiezo = 81, // sim
+    TypeIDTCubeQuad = 89, // doc; aka position aligner
+    TypeIDTCubeSolenoid = 85, // doc
+    TypeIDTCubeStepper = 80, // doc
+    TypeIDTCubeStrainGauge = 84, // doc
+    TypeIDTCubeTEC = 87, // doc
+    TypeIDVerticalStage = 24, // doc
+};
+
+
+// Factories for the classes of one Kinesis API (e.g. the KCube DCServo
+// family). Defined in Connection.cpp; unused members are null (a family has
+// either motor drives or piezo drives).
+struct DeviceFamily {
+    std::unique_ptr<KinesisDeviceAccess> (*makeAccess)(
+        std::string const& serialNo);
+    bool (*preloadDriver)();
+    std::unique_ptr<MotorDrive> (*makeMotorDrive)(
+        std::shared_ptr<KinesisDeviceConnection> connection, short channel);
+    std::unique_ptr<PiezoDrive> (*makePiezoDrive)(
+        std::shared_ptr<KinesisDeviceConnection> connection);
+};
+
+extern DeviceFamily const BenchtopBrushlessFamily;
+extern DeviceFamily const BenchtopDCServoFamily;
+extern DeviceFamily const BenchtopStepperFamily;
+extern DeviceFamily const IntegratedStepperFamily;
+extern DeviceFamily const KCubeBrushlessFamily;
+extern DeviceFamily const KCubeDCServoFamily;
+extern DeviceFamily const KCubePiezoFamily;
+extern DeviceFamily const KCubeStepperFamily;
+extern DeviceFamily const TCubeBrushlessFamily;
+extern DeviceFamily const TCubeDCServoFamily;
+extern DeviceFamily const TCubeStepperFamily;
+extern DeviceFamily const VerticalStageFamily;
+
+
+enum DeviceChannelModel {
+    ChannelModelSingle, // API takes no channel
+    ChannelModelMulti, // API takes a channel (even if device has only one)
+};
+
+enum DeviceStageKind {
+    StageKindNone, // Unsupported
+    StageKindMotor, // SingleAxisStage
+    StageKindPiezo, // PiezoStage
+};
+
+
+// Everything the adapter knows about a device type. Types that are not
+// supported are listed only if their channel model matters.
+struct DeviceType {
+    uint32_t typeID;
+    DeviceFamily const* family; // Null if unsupported
+    char const* dllName; // Null if unsupported
+    DeviceChannelModel channelModel;
+    short numChannels; // Nominal; the connected device is asked when it matters
+    DeviceStageKind stageKind;
+    bool isRotational; // Default for StageType
+    double deviceUnitsPerMm; // Default; small if unknown, to prevent accidents
+    double deviceUnitsPerRevolution; // Default
+};
+
+
+namespace DeviceTypesDetail {
+    char const* const DLL_BenchtopBrushless =
+        "Thorlabs.MotionControl.Benchtop.BrushlessMotor.dll";
+    char const* const DLL_BenchtopDCServo =
+        "Thorlabs.MotionControl.Benchtop.DCServo.dll";
+    char const* const DLL_BenchtopStepper =
+        "Thorlabs.MotionControl.Benchtop.StepperMotor.dll";
+    char const* const DLL_IntegratedStepper =
+        "Thorlabs.MotionControl.IntegratedStepperMotors.dll";
+    char const* const DLL_KCubeBrushless =
+        "Thorlabs.MotionControl.KCube.BrushlessMotor.dll";
+    char const* const DLL_KCubeDCServo =
+        "Thorlabs.MotionControl.KCube.DCServo.dll";
+    char const* const DLL_KCubePiezo =
+        "Thorlabs.MotionControl.KCube.Piezo.dll";
+    char const* const DLL_KCubeStepper =
+        "Thorlabs.MotionControl.KCube.StepperMotor.dll";
+    char const* const DLL_TCubeBrushless =
+        "Thorlabs.MotionControl.TCube.BrushlessMotor.dll";
+    char const* const DLL_TCubeDCServo =
+        "Thorlabs.MotionControl.TCube.DCServo.dll";
+    char const* const DLL_TCubeStepper =
+        "Thorlabs.MotionControl.TCube.StepperMotor.dll";
+    char const* const DLL_VerticalStage =
+        "Thorlabs.MotionControl.VerticalStage.dll";
+
+    constexpr DeviceType Motor(uint32_t typeID, DeviceFamily const* family,
+        char const* dllName, double deviceUnitsPerMm = 1000.0) {
+        return { typeID, family, dllName, ChannelModelSingle, 1,
+            StageKindMotor, false, deviceUnitsPerMm, 360.0 };
+    }
+
+    constexpr DeviceType Benchtop(uint32_t typeID, DeviceFamily const* family,
+        char const* dllName, short numChannels) {
+        return { typeID, family, dllName, ChannelModelMulti, numChannels,
+            StageKindMotor, false, 1000.0, 360.0 };
+    }
+
+    constexpr DeviceType Rotator(uint32_t typeID, DeviceFamily const* family,
+        char const* dllName, double deviceUnitsPerRevolution) {
+        return { typeID, family, dllName, ChannelModelSingle, 1,
+            StageKindMotor, true, 1000.0, deviceUnitsPerRevolution };
+    }
+
+    constexpr DeviceType Piezo(uint32_t typeID, DeviceFamily const* family,
+        char const* dllName) {
+        return { typeID, family, dllName, ChannelModelSingle, 1,
+            StageKindPiezo, false, 1000.0, 360.0 };
+    }
+
+    constexpr DeviceType UnsupportedMulti(uint32_t typeID, short numChannels) {
+        return { typeID, nullptr, nullptr, ChannelModelMulti, numChannels,
+            StageKindNone, false, 1000.0, 360.0 };
+    }
+
+    // Known defaults for integrated devices are taken from the Kinesis app
+    constexpr DeviceType DEVICE_TYPES[] = {
+        Benchtop(TypeIDBenchtopBrushless, &BenchtopBrushlessFamily,
+            DLL_BenchtopBrushless, 3),
+        Benchtop(TypeIDBenchtopDCServo1Channel, &BenchtopDCServoFamily,
+            DLL_BenchtopDCServo, 1),
+        Benchtop(TypeIDBenchtopDCServo3Channel, &BenchtopDCServoFamily,
+            DLL_BenchtopDCServo, 3),
+        UnsupportedMulti(TypeIDBenchtopPiezo1Channel, 1),
+        UnsupportedMulti(TypeIDBenchtopPiezo3Channel, 3),
+        UnsupportedMulti(TypeIDBenchtopPrecisionPiezo2Channel, 2), // Only PPC2_, not PPC_
+        Benchtop(TypeIDBenchtopStepper1Channel, &BenchtopStepperFamily,
+            DLL_BenchtopStepper, 1),
+        Benchtop(TypeIDBenchtopStepper3Channel, &BenchtopStepperFamily,
+            DLL_BenchtopStepper, 3),
+        Rotator(TypeIDCageRotator, &IntegratedStepperFamily,
+            DLL_IntegratedStepper, 49152000.0),
+        Motor(TypeIDKCubeBrushless, &KCubeBrushlessFamily,
+            DLL_KCubeBrushless),
+        Motor(TypeIDKCubeDCServo, &KCubeDCServoFamily, DLL_KCubeDCServo),
+        Piezo(TypeIDKCubePiezo, &KCubePiezoFamily, DLL_KCubePiezo),
+        Motor(TypeIDKCubeStepper, &KCubeStepperFamily, DLL_KCubeStepper),
+        Motor(TypeIDLabJack050, &IntegratedStepperFamily,
+            DLL_IntegratedStepper, 1228800.0),
+        Motor(TypeIDLabJack490, &IntegratedStepperFamily,
+            DLL_IntegratedStepper, 134737.0),
+        Motor(TypeIDLongTravelStage, &IntegratedStepperFamily,
+            DLL_IntegratedStepper, 409600.0),
+        UnsupportedMulti(TypeIDModularPiezo, 1),
+        UnsupportedMulti(TypeIDModularStepper, 1),
+        Motor(TypeIDTCubeBrushless, &TCubeBrushlessFamily,
+            DLL_TCubeBrushless),
+        Motor(TypeIDTCubeDCServo, &TCubeDCServoFamily, DLL_TCubeDCServo),
+        Motor(TypeIDTCubeStepper, &TCubeStepperFamily, DLL_TCubeStepper),
+        Motor(TypeIDVerticalStage, &VerticalStageFamily, DLL_VerticalStage,
+            25050.0),
+    };
+
+    // Type IDs are the first two digits of the serial number
+    std::size_t const MAX_TYPE_ID = 99;
+
+    struct TypeIndex {
+        signed char entries[MAX_TYPE_ID + 1]; // Index into DEVICE_TYPES, or -1
+    };
+
+    constexpr TypeIndex MakeTypeIndex() {
+        TypeIndex index{};
+        for (std::size_t id = 0; id <= MAX_TYPE_ID; ++id)
+            index.entries[id] = -1;
+        for (std::size_t i = 0; i < sizeof(DEVICE_TYPES) / sizeof(DeviceType); ++i)
+            index.entries[DEVICE_TYPES[i].typeID] = static_cast<signed char>(i);
+        return index;
+    }
+
+    constexpr TypeIndex TYPE_INDEX = MakeTypeIndex();
+}
+
+
+// Null if the type is not listed
+constexpr DeviceType const* FindDeviceType(uint32_t typeID) {
+    using namespace DeviceTypesDetail;
+    return typeID <= MAX_TYPE_ID && TYPE_INDEX.entries[typeID] >= 0 ?
+        &DEVICE_TYPES[TYPE_INDEX.entries[typeID]] : nullptr;
+}
+
+// Null if the type is not supported
+constexpr DeviceFamily const* FindDeviceFamily(uint32_t typeID) {
+    return FindDeviceType(typeID) ? FindDeviceType(typeID)->family : nullptr;
+}
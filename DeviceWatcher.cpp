@@ -0,0 +1,211 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "DeviceWatcher.h"
+
+#include "DeviceEnumeration.h"
+
+#include <Dbt.h>
+
+#include <algorithm>
+#include <cctype>
+
+
+namespace {
+    char const* const WINDOW_CLASS_NAME = "KinesisDeviceWatcher";
+
+    // GUID_DEVINTERFACE_USB_DEVICE (usbiodef.h), defined here to avoid
+    // pulling in the driver kit headers
+    GUID const USB_DEVICE_INTERFACE_GUID = { 0xA5DCBF10, 0x6530, 0x11D2,
+        { 0x90, 0x1F, 0x00, 0xC0, 0x4F, 0xB9, 0x51, 0xED } };
+
+    // Thorlabs controllers use FTDI chips with a Thorlabs product ID
+    char const* const THORLABS_USB_ID = "VID_0403&PID_FAF0";
+}
+
+
+DeviceWatcher::DeviceWatcher(Handler handler) :
+    handler_{ std::move(handler) }
+{
+    thread_ = std::thread([this] { Run(); });
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    started_.wait(lock, [&] { return startFinished_; });
+}
+
+
+DeviceWatcher::~DeviceWatcher() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (window_)
+            PostMessageA(window_, WM_CLOSE, 0, 0);
+    }
+    if (thread_.joinable())
+        thread_.join();
+}
+
+
+bool
+DeviceWatcher::IsRunning() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return window_ != nullptr;
+}
+
+
+std::string
+DeviceWatcher::SerialNoFromDevicePath(char const* path) {
+    std::string upper{ path };
+    std::transform(upper.begin(), upper.end(), upper.begin(),
+        [](char c) { return static_cast<char>(std::toupper(
+            static_cast<unsigned char>(c))); });
+
+    auto idPos = upper.find(THORLABS_USB_ID);
+    if (idPos == std::string::npos)
+        return {};
+    auto begin = upper.find('#', idPos);
+    if (begin == std::string::npos)
+        return {};
+    ++begin;
+    auto end = upper.find('#', begin);
+    if (end == std::string::npos)
+        return {};
+
+    std::string serialNo = upper.substr(begin, end - begin);
+    if (!IsValidSerialNo(serialNo))
+        return {};
+    return serialNo;
+}
+
+
+void
+DeviceWatcher::Run() {
+    // The window class must belong to this DLL (which contains WindowProc),
+    // not to the application
+    HMODULE module = nullptr;
+    GetModuleHandleExA(GET_MODULE_HANDLE_EX_FLAG_FROM_ADDRESS |
+        GET_MODULE_HANDLE_EX_FLAG_UNCHANGED_REFCOUNT,
+        reinterpret_cast<LPCSTR>(&DeviceWatcher::WindowProc), &module);
+    HINSTANCE instance = static_cast<HINSTANCE>(module);
+
+    WNDCLASSEXA windowClass{};
+    windowClass.cbSize = sizeof(windowClass);
+    windowClass.lpfnWndProc = &DeviceWatcher::WindowProc;
+    windowClass.hInstance = instance;
+    windowClass.lpszClassName = WINDOW_CLASS_NAME;
+    bool const registeredClass = RegisterClassExA(&windowClass) != 0;
+
+    HWND window = CreateWindowExA(0, WINDOW_CLASS_NAME, "", 0, 0, 0, 0, 0,
+        HWND_MESSAGE, nullptr, instance, nullptr);
+    HDEVNOTIFY notification = nullptr;
+    if (window) {
+        SetWindowLongPtrA(window, GWLP_USERDATA,
+            reinterpret_cast<LONG_PTR>(this));
+
+        DEV_BROADCAST_DEVICEINTERFACE_A filter{};
+        filter.dbcc_size = sizeof(filter);
+        filter.dbcc_devicetype = DBT_DEVTYP_DEVICEINTERFACE;
+        filter.dbcc_classguid = USB_DEVICE_INTERFACE_GUID;
+        notification = RegisterDeviceNotificationA(window, &filter,
+            DEVICE_NOTIFY_WINDOW_HANDLE);
+        if (!notification) {
+            DestroyWindow(window);
+            window = nullptr;
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        window_ = window;
+        startFinished_ = true;
+    }
+    started_.notify_all();
+
+    if (window) {
+        MSG message;
+        while (GetMessageA(&message, nullptr, 0, 0) > 0) {
+            TranslateMessage(&message);
+            DispatchMessageA(&message);
+        }
+        UnregisterDeviceNotification(notification);
+    }
+
+    if (registeredClass)
+        UnregisterClassA(WINDOW_CLASS_NAME, instance);
+}
+
+
+LRESULT CALLBACK
+DeviceWatcher::WindowProc(HWND hwnd, UINT message, WPARAM wParam,
+    LPARAM lParam) {
+    switch (message) {
+    case WM_DEVICECHANGE: {
+        auto watcher = reinterpret_cast<DeviceWatcher*>(
+            GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+        if (watcher)
+            watcher->HandleDeviceChange(wParam, lParam);
+        return TRUE;
+    }
+    case WM_CLOSE: {
+        // Posted by the destructor
+        {
+            auto watcher = reinterpret_cast<DeviceWatcher*>(
+                GetWindowLongPtrA(hwnd, GWLP_USERDATA));
+            std::lock_guard<std::mutex> lock(watcher->mutex_);
+            watcher->window_ = nullptr;
+        }
+        DestroyWindow(hwnd);
+        return 0;
+    }
+    case WM_DESTROY:
+        PostQuitMessage(0);
+        return 0;
+    default:
+        return DefWindowProcA(hwnd, message, wParam, lParam);
+    }
+}
+
+
+void
+DeviceWatcher::HandleDeviceChange(WPARAM event, LPARAM data) {
+    if (event != DBT_DEVICEARRIVAL && event != DBT_DEVICEREMOVECOMPLETE)
+        return;
+
+    auto header = reinterpret_cast<DEV_BROADCAST_HDR const*>(data);
+    if (!header || header->dbch_devicetype != DBT_DEVTYP_DEVICEINTERFACE)
+        return;
+    auto deviceInterface =
+        reinterpret_cast<DEV_BROADCAST_DEVICEINTERFACE_A const*>(header);
+
+    std::string serialNo = SerialNoFromDevicePath(deviceInterface->dbcc_name);
+    if (!serialNo.empty())
+        handler_(serialNo, event == DBT_DEVICEARRIVAL);
+}
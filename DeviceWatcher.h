@@ -0,0 +1,81 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <Windows.h>
+
+
+// Watches for USB arrival and removal of Thorlabs controllers, so that the hub
+// can update its inventory for just the affected serial numbers. Notifications
+// are received by a message-only window on a background thread (Windows
+// delivers device change notifications only to windows or services).
+//
+// The handler is called on the watcher thread, and must not block for long.
+class DeviceWatcher {
+public:
+    using Handler = std::function<void(std::string const& serialNo,
+        bool arrived)>;
+
+private:
+    Handler const handler_;
+    std::thread thread_;
+
+    std::mutex mutex_;
+    std::condition_variable started_;
+    bool startFinished_{ false };
+    HWND window_{ nullptr }; // Null if the watcher failed to start
+
+public:
+    explicit DeviceWatcher(Handler handler);
+    // Once this returns, the handler is no longer called
+    ~DeviceWatcher();
+
+    bool IsRunning();
+
+    // Serial number of a Thorlabs (FTDI) device from a USB device interface
+    // path of the form \\?\USB#VID_0403&PID_FAF0#27000001#{...}; returns an
+    // empty string for other devices
+    static std::string SerialNoFromDevicePath(char const* path);
+
+private:
+    void Run();
+    static LRESULT CALLBACK WindowProc(HWND hwnd, UINT message, WPARAM wParam,
+        LPARAM lParam);
+    void HandleDeviceChange(WPARAM event, LPARAM data);
+};
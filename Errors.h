@@ -39,6 +39,59 @@
 int const ERR_OFFSET = 20000;
 
 
+// Errors detected by this device adapter itself (not Kinesis error codes)
+int const ERR_STAGE_SEQUENCE_INVALID = 10001;
+int const ERR_INITIAL_REPLY_TIMEOUT = 10002;
+int const ERR_XY_AXIS_INVALID = 10003;
+int const ERR_TRAJECTORY_NOT_RECORDED = 10004;
+int const ERR_TRAJECTORY_SAVE_FAILED = 10005;
+int const ERR_TRIGGER_PORT_IN_USE = 10006;
+int const ERR_MOVE_GROUP_AXIS_INVALID = 10007;
+int const ERR_MOVE_GROUP_TARGETS_INVALID = 10008;
+int const ERR_PIEZO_NO_STRAIN_GAUGE = 10009;
+int const ERR_SCAN_INVALID = 10010;
+int const ERR_SCAN_CONFLICT = 10011;
+int const ERR_POSITION_REPLY_TIMEOUT = 10012;
+int const ERR_DEVICE_NOT_IN_INVENTORY = 10013;
+int const ERR_CHANNEL_IN_USE = 10014;
+
+
+inline auto& AdapterErrorTexts() {
+    static std::map<int, std::string> const texts = {
+        { ERR_STAGE_SEQUENCE_INVALID, "The stage sequence must contain at "
+            "least 2 positions, with no two consecutive positions (including "
+            "last-to-first) identical" },
+        { ERR_INITIAL_REPLY_TIMEOUT, "The device did not reply to the initial "
+            "position or status request in time" },
+        { ERR_XY_AXIS_INVALID, "The X and Y axes must be set to two different "
+            "channels of supported motor controllers" },
+        { ERR_TRAJECTORY_NOT_RECORDED, "No trajectory has been recorded "
+            "(set TrajectoryRecording to Yes first)" },
+        { ERR_TRAJECTORY_SAVE_FAILED, "The trajectory could not be written "
+            "to TrajectoryFile" },
+        { ERR_TRIGGER_PORT_IN_USE, "Trigger port 1 cannot be changed while "
+            "a stage sequence is running" },
+        { ERR_MOVE_GROUP_AXIS_INVALID, "The move group axes must be set to "
+            "distinct channels of supported motor controllers" },
+        { ERR_MOVE_GROUP_TARGETS_INVALID, "Targets must be a comma-separated "
+            "list with one position (or an empty entry) per axis" },
+        { ERR_PIEZO_NO_STRAIN_GAUGE, "Closed-loop control requires a "
+            "strain gauge reader; set ControlMode to Open loop" },
+        { ERR_SCAN_INVALID, "ScanStartUm and ScanStopUm must differ, and "
+            "ScanVelocity and ScanTriggerPitchUm must be positive" },
+        { ERR_SCAN_CONFLICT, "A scan cannot run together with a stage "
+            "sequence, and trigger port 2 cannot be changed during a scan" },
+        { ERR_POSITION_REPLY_TIMEOUT, "The device did not reply to a "
+            "position request in time" },
+        { ERR_DEVICE_NOT_IN_INVENTORY, "The device is not among those "
+            "found by the Hub (required with ConnectOnFirstUse)" },
+        { ERR_CHANNEL_IN_USE, "The controller channel is already in use by "
+            "another stage, XY stage, or move group axis" },
+    };
+    return texts;
+}
+
+
 inline auto& KinesisErrorCodes() {
     static std::map<short, std::string> const codes = {
         // Error codes are straight from Thorlabs documentation
@@ -0,0 +1,120 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "HomedStateStore.h"
+
+#include <fstream>
+#include <sstream>
+
+
+namespace {
+    char const* const HOMED_STATE_FILE_HEADER = "# Thorlabs Kinesis homed state v1";
+}
+
+
+HomedStateStore::HomedStateStore(std::string const& path) :
+    path_{ path }
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    LoadLocked();
+}
+
+
+bool
+HomedStateStore::Find(std::string const& serialNo, short channel,
+    HomedStateRecord& record) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = records_.find({ serialNo, channel });
+    if (it == records_.end())
+        return false;
+    record = it->second;
+    return true;
+}
+
+
+bool
+HomedStateStore::Set(std::string const& serialNo, short channel,
+    HomedStateRecord const& record) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    records_[{ serialNo, channel }] = record;
+    return SaveLocked();
+}
+
+
+// File format: header line, then tab-separated lines of
+// serialNo, channel, homed, positionCounter, reportsHomedBit, firmwareVersion
+// where channel is -1 for devices that are not multi-channel.
+
+void
+HomedStateStore::LoadLocked() {
+    records_.clear();
+
+    std::ifstream file{ path_ };
+    std::string line;
+    if (!std::getline(file, line) || line != HOMED_STATE_FILE_HEADER)
+        return;
+
+    while (std::getline(file, line)) {
+        std::istringstream fields{ line };
+        std::string serialNo;
+        short channel;
+        int homed, reportsHomedBit;
+        HomedStateRecord record;
+        fields >> serialNo >> channel >> homed >> record.positionCounter >>
+            reportsHomedBit >> record.firmwareVersion;
+        if (fields.fail()) {
+            records_.clear(); // Not trusted if any of it is corrupt
+            return;
+        }
+        record.homed = homed != 0;
+        record.reportsHomedBit = reportsHomedBit != 0;
+        records_[{ serialNo, channel }] = record;
+    }
+}
+
+
+bool
+HomedStateStore::SaveLocked() const {
+    std::ostringstream contents;
+    contents << HOMED_STATE_FILE_HEADER << '\n';
+    for (auto const& item : records_) {
+        HomedStateRecord const& record = item.second;
+        contents << item.first.first << '\t' << item.first.second << '\t' <<
+            (record.homed ? 1 : 0) << '\t' << record.positionCounter << '\t' <<
+            (record.reportsHomedBit ? 1 : 0) << '\t' <<
+            record.firmwareVersion << '\n';
+    }
+
+    std::ofstream file{ path_, std::ios::trunc };
+    file << contents.str();
+    return file.good();
+}
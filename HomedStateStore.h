@@ -0,0 +1,89 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+
+// What is known about a stage's homing when it was last shut down
+struct HomedStateRecord {
+    bool homed = false;
+    long positionCounter = 0;
+    // Whether the controller reported the Homed status bit; if so, the bit
+    // (cleared when the controller is powered up) tells whether it is still
+    // in the same power session
+    bool reportsHomedBit = false;
+    DWORD firmwareVersion = 0;
+};
+
+
+// Homed state of each stage (serial number and channel), kept in a file so
+// that stages whose controllers stayed powered need not be homed again when
+// Micro-Manager is restarted. Thread safe.
+class HomedStateStore {
+    std::string const path_;
+    mutable std::mutex mutex_;
+    std::map<std::pair<std::string, short>, HomedStateRecord> records_;
+
+public:
+    // Loads the file, if it exists and is a homed state file
+    explicit HomedStateStore(std::string const& path);
+
+    // channel is -1 if not multi-channel
+    bool Find(std::string const& serialNo, short channel,
+        HomedStateRecord& record) const;
+
+    // Also saves the file; returns false if it cannot be written
+    bool Set(std::string const& serialNo, short channel,
+        HomedStateRecord const& record);
+
+private:
+    void LoadLocked();
+    bool SaveLocked() const;
+};
+
+
+// Implemented by the hub, so that stages can find the store through
+// GetParentHub()
+class HomedStateProvider {
+public:
+    virtual ~HomedStateProvider() = default;
+    // Null if the homed state is not persisted
+    virtual std::shared_ptr<HomedStateStore> GetHomedStateStore() = 0;
+};
@@ -32,180 +32,11 @@
 
 #include "IntegratedStepper.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.IntegratedStepperMotors.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.IntegratedStepperMotors.dll" };
-
-
-bool
-IntegratedStepperAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-IntegratedStepperAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepperAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-IntegratedStepper::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_RequestSettings, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_RequestStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-bool
-IntegratedStepper::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, ISC_StartPolling, func);
-    return func(CSerialNo(), intervalMs);
-}
-
-
-void
-IntegratedStepper::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_StopPolling, func);
-    func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetHardwareInfo, func);
-    return func(CSerialNo(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-IntegratedStepper::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_EnableChannel, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_DisableChannel, func);
-    return func(CSerialNo());
-}
-
-
-int
-IntegratedStepper::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetMotorTravelMode, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, ISC_SetMotorTravelMode, func);
-    return func(CSerialNo(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-IntegratedStepper::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_ResetRotationModes, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, ISC_SetRotationModes, func);
-    return func(CSerialNo(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-
-short
-IntegratedStepper::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_RequestPosition, func);
-    return func(CSerialNo());
-}
-
-
-int
-IntegratedStepper::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetPosition, func);
-    return func(CSerialNo());
-}
-
-
-long
-IntegratedStepper::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetPositionCounter, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, ISC_MoveToPosition, func);
-    return func(CSerialNo(), index);
-}
-
-
-bool
-IntegratedStepper::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_CanHome, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, ISC_Home, func);
-    return func(CSerialNo());
-}
-
-
-short
-IntegratedStepper::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), deviceUnits, realValue, unitType);
-}
-
-
-short
-IntegratedStepper::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, ISC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), realValue, deviceUnits, unitType);
-}
+#define KINESIS_FAMILY IntegratedStepper
+#define KINESIS_FUNC(name) ISC_##name
+#define KINESIS_DLL_TYPE_ID TypeIDLongTravelStage
+#define KINESIS_HAS_ROTATION_MODES 1
+#include "MotorDriveFamily.inl"
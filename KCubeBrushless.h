@@ -41,6 +41,9 @@ public:
         KinesisDeviceAccess{ serialNo }
     {}
 
+    // Load the DLL and resolve its functions ahead of first use
+    static bool PreloadDriver();
+
 protected:
     bool IsKinesisDriverAvailable() override;
     short Kinesis_Open() override;
@@ -54,6 +57,10 @@ public:
         NonStepperMotorDrive{ connection }
     {}
 
+    bool HasTriggerPorts() const override { return true; }
+
+    MotionScale GetMotionScale() override { return MotionScales::Brushless; }
+
 protected: // General
     short Kinesis_RequestSettings() override;
     short Kinesis_RequestStatusBits() override;
@@ -67,6 +74,15 @@ protected: // General
 
     DWORD Kinesis_GetStatusBits() override;
 
+    void Kinesis_EnableLastMsgTimer(bool enable, __int32 lastMsgTimeout) override;
+    bool Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) override;
+
+    void Kinesis_RegisterMessageCallback(void (*callback)()) override;
+    int Kinesis_MessageQueueSize() override;
+    void Kinesis_ClearMessageQueue() override;
+    bool Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+        DWORD* messageData) override;
+
 protected: // Motor
     short Kinesis_EnableChannel() override;
     short Kinesis_DisableChannel() override;
@@ -80,9 +96,16 @@ protected: // Motor
     int Kinesis_GetPosition() override;
     long Kinesis_GetPositionCounter() override;
     short Kinesis_MoveToPosition(int index) override;
+    short Kinesis_MoveRelative(int displacement) override;
+    short Kinesis_MoveAtVelocity(int direction) override;
+    short Kinesis_StopProfiled() override;
 
     bool Kinesis_CanHome() override;
     short Kinesis_Home() override;
+    short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) override;
+    short Kinesis_SetVelParams(int acceleration, int maxVelocity) override;
+    short Kinesis_GetJogVelParams(int* acceleration, int* maxVelocity) override;
+    short Kinesis_SetJogVelParams(int acceleration, int maxVelocity) override;
 
     short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
         double* realValue, int unitType) override;
@@ -91,4 +114,20 @@ protected: // Motor
 
 protected: // Non-stepper
     long Kinesis_GetEncoderCounter() override;
+
+protected: // Trigger ports
+    short Kinesis_GetTriggerConfigParams(int* mode1, int* polarity1,
+        int* mode2, int* polarity2) override;
+    short Kinesis_SetTriggerConfigParams(int mode1, int polarity1,
+        int mode2, int polarity2) override;
+    short Kinesis_SetMoveAbsolutePosition(int position) override;
+    short Kinesis_SetMoveRelativeDistance(int distance) override;
+    short Kinesis_GetTriggerParamsParams(int* startPositionFwd,
+        int* intervalFwd, int* pulseCountFwd, int* startPositionRev,
+        int* intervalRev, int* pulseCountRev, int* pulseWidth,
+        int* cycleCount) override;
+    short Kinesis_SetTriggerParamsParams(int startPositionFwd,
+        int intervalFwd, int pulseCountFwd, int startPositionRev,
+        int intervalRev, int pulseCountRev, int pulseWidth,
+        int cycleCount) override;
 };
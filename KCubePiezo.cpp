@@ -0,0 +1,294 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "KCubePiezo.h"
+
+#include "DeviceTypes.h"
+#include "DLLAccess.h"
+
+#include "Thorlabs.MotionControl.KCube.Piezo.h"
+
+#include <atomic>
+
+
+// The piezo API shares only the general functions with the motor APIs, so
+// this family does not use MotorDriveFamily.inl; the structure is the same.
+
+#define TABLE_ENTRY(name) \
+    DLLFunc<decltype(PCC_##name)> name{ kinesisDll, "PCC_" #name };
+
+
+namespace {
+    DLLAccess kinesisDll{ FindDeviceType(TypeIDKCubePiezo)->dllName };
+
+    struct FunctionTable {
+        TABLE_ENTRY(Open)
+        TABLE_ENTRY(Close)
+        TABLE_ENTRY(RequestSettings)
+        TABLE_ENTRY(RequestStatusBits)
+        TABLE_ENTRY(StartPolling)
+        TABLE_ENTRY(StopPolling)
+        TABLE_ENTRY(GetHardwareInfo)
+        TABLE_ENTRY(GetStatusBits)
+        TABLE_ENTRY(EnableLastMsgTimer)
+        TABLE_ENTRY(TimeSinceLastMsgReceived)
+        TABLE_ENTRY(RegisterMessageCallback)
+        TABLE_ENTRY(MessageQueueSize)
+        TABLE_ENTRY(ClearMessageQueue)
+        TABLE_ENTRY(GetNextMessage)
+
+        TABLE_ENTRY(RequestPosition)
+        TABLE_ENTRY(Enable)
+        TABLE_ENTRY(Disable)
+        TABLE_ENTRY(GetPositionControlMode)
+        TABLE_ENTRY(SetPositionControlMode)
+        TABLE_ENTRY(GetMaxOutputVoltage)
+        TABLE_ENTRY(GetMaximumTravel)
+        TABLE_ENTRY(GetOutputVoltage)
+        TABLE_ENTRY(SetOutputVoltage)
+        TABLE_ENTRY(GetPosition)
+        TABLE_ENTRY(SetPosition)
+        TABLE_ENTRY(GetVoltageSource)
+        TABLE_ENTRY(SetVoltageSource)
+        TABLE_ENTRY(SetLUTwaveParams)
+        TABLE_ENTRY(SetLUTwaveSample)
+        TABLE_ENTRY(StartLUTOutput)
+        TABLE_ENTRY(StopLUTOutput)
+    };
+
+    std::atomic<FunctionTable*> functionTable{ nullptr };
+
+    // Thread safe
+    bool ResolveFunctions() {
+        if (functionTable.load(std::memory_order_acquire))
+            return true;
+        if (!kinesisDll.IsValid())
+            return false;
+        static FunctionTable table; // Constructed once
+        functionTable.store(&table, std::memory_order_release);
+        return true;
+    }
+
+    // Only valid after ResolveFunctions() has succeeded
+    FunctionTable& Kinesis() {
+        return *functionTable.load(std::memory_order_acquire);
+    }
+}
+
+
+bool
+KCubePiezoAccess::PreloadDriver() {
+    return ResolveFunctions();
+}
+
+
+bool
+KCubePiezoAccess::IsKinesisDriverAvailable() {
+    return ResolveFunctions();
+}
+
+
+short
+KCubePiezoAccess::Kinesis_Open() {
+    return Kinesis().Open(CSerialNo());
+}
+
+
+short
+KCubePiezoAccess::Kinesis_Close() {
+    Kinesis().Close(CSerialNo());
+    return 0;
+}
+
+short
+KCubePiezo::Kinesis_RequestSettings() {
+    return Kinesis().RequestSettings(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_RequestStatusBits() {
+    return Kinesis().RequestStatusBits(CSerialNo());
+}
+
+bool
+KCubePiezo::Kinesis_StartPolling(int intervalMs) {
+    return Kinesis().StartPolling(CSerialNo(), intervalMs);
+}
+
+void
+KCubePiezo::Kinesis_StopPolling() {
+    Kinesis().StopPolling(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
+    return Kinesis().GetHardwareInfo(CSerialNo(), modelNo, sizeOfModelNo,
+        type, numChannels, notes, sizeOfNotes, firmwareVersion,
+        hardwareVersion, modificationState);
+}
+
+DWORD
+KCubePiezo::Kinesis_GetStatusBits() {
+    return Kinesis().GetStatusBits(CSerialNo());
+}
+
+void
+KCubePiezo::Kinesis_EnableLastMsgTimer(bool enable, __int32 lastMsgTimeout) {
+    Kinesis().EnableLastMsgTimer(CSerialNo(), enable, lastMsgTimeout);
+}
+
+bool
+KCubePiezo::Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) {
+    return Kinesis().TimeSinceLastMsgReceived(CSerialNo(), lastUpdateTimeMS);
+}
+
+void
+KCubePiezo::Kinesis_RegisterMessageCallback(void (*callback)()) {
+    Kinesis().RegisterMessageCallback(CSerialNo(), callback);
+}
+
+int
+KCubePiezo::Kinesis_MessageQueueSize() {
+    return Kinesis().MessageQueueSize(CSerialNo());
+}
+
+void
+KCubePiezo::Kinesis_ClearMessageQueue() {
+    Kinesis().ClearMessageQueue(CSerialNo());
+}
+
+bool
+KCubePiezo::Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+    DWORD* messageData) {
+    return Kinesis().GetNextMessage(CSerialNo(), messageType, messageID,
+        messageData);
+}
+
+short
+KCubePiezo::Kinesis_RequestPosition() {
+    return Kinesis().RequestPosition(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_Enable() {
+    return Kinesis().Enable(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_Disable() {
+    return Kinesis().Disable(CSerialNo());
+}
+
+int
+KCubePiezo::Kinesis_GetPositionControlMode() {
+    return Kinesis().GetPositionControlMode(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_SetPositionControlMode(int mode) {
+    return Kinesis().SetPositionControlMode(CSerialNo(),
+        static_cast<PZ_ControlModeTypes>(mode));
+}
+
+short
+KCubePiezo::Kinesis_GetMaxOutputVoltage() {
+    return Kinesis().GetMaxOutputVoltage(CSerialNo());
+}
+
+WORD
+KCubePiezo::Kinesis_GetMaximumTravel() {
+    return Kinesis().GetMaximumTravel(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_GetOutputVoltage() {
+    return Kinesis().GetOutputVoltage(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_SetOutputVoltage(short voltage) {
+    return Kinesis().SetOutputVoltage(CSerialNo(), voltage);
+}
+
+WORD
+KCubePiezo::Kinesis_GetPosition() {
+    return Kinesis().GetPosition(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_SetPosition(WORD position) {
+    return Kinesis().SetPosition(CSerialNo(), position);
+}
+
+int
+KCubePiezo::Kinesis_GetVoltageSource() {
+    return Kinesis().GetVoltageSource(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_SetVoltageSource(int source) {
+    return Kinesis().SetVoltageSource(CSerialNo(),
+        static_cast<PZ_InputSourceFlags>(source));
+}
+
+short
+KCubePiezo::Kinesis_SetLUTWaveParams(LUTWaveParams const& params) {
+    PZ_LUTWaveParameters p{};
+    p.mode = static_cast<PZ_OutputLUTModes>(params.mode);
+    p.cycleLength = params.cycleLength;
+    p.numCycles = params.numCycles;
+    p.LUTValueDelay = params.valueDelayMs;
+    p.preCycleRest = params.preCycleRestMs;
+    p.postCycleRest = params.postCycleRestMs;
+    p.outputTriggerStart = params.outputTriggerStart;
+    p.outputTriggerWidth = params.outputTriggerWidthMs;
+    p.numOutTriggerRepeat = params.numOutputTriggerRepeat;
+    p.outputTriggerRepeatInterval = params.outputTriggerRepeatIntervalMs;
+    return Kinesis().SetLUTwaveParams(CSerialNo(), &p);
+}
+
+short
+KCubePiezo::Kinesis_SetLUTWaveSample(short index, WORD value) {
+    return Kinesis().SetLUTwaveSample(CSerialNo(), index, value);
+}
+
+short
+KCubePiezo::Kinesis_StartLUTOutput() {
+    return Kinesis().StartLUTOutput(CSerialNo());
+}
+
+short
+KCubePiezo::Kinesis_StopLUTOutput() {
+    return Kinesis().StopLUTOutput(CSerialNo());
+}
@@ -0,0 +1,100 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+
+class KCubePiezoAccess final : public KinesisDeviceAccess {
+public:
+    explicit KCubePiezoAccess(std::string const& serialNo) :
+        KinesisDeviceAccess{ serialNo }
+    {}
+
+    // Load the DLL and resolve its functions ahead of first use
+    static bool PreloadDriver();
+
+protected:
+    bool IsKinesisDriverAvailable() override;
+    short Kinesis_Open() override;
+    short Kinesis_Close() override;
+};
+
+
+class KCubePiezo final : public PiezoDrive {
+public:
+    KCubePiezo(std::shared_ptr<KinesisDeviceConnection> connection) :
+        PiezoDrive{ connection }
+    {}
+
+protected: // General
+    short Kinesis_RequestSettings() override;
+    short Kinesis_RequestStatusBits() override;
+    bool Kinesis_StartPolling(int intervalMs) override;
+    void Kinesis_StopPolling() override;
+
+    short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+        WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+        DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState)
+        override;
+
+    DWORD Kinesis_GetStatusBits() override;
+
+    void Kinesis_EnableLastMsgTimer(bool enable, __int32 lastMsgTimeout) override;
+    bool Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) override;
+
+    void Kinesis_RegisterMessageCallback(void (*callback)()) override;
+    int Kinesis_MessageQueueSize() override;
+    void Kinesis_ClearMessageQueue() override;
+    bool Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+        DWORD* messageData) override;
+
+protected: // Piezo
+    short Kinesis_RequestPosition() override;
+    short Kinesis_Enable() override;
+    short Kinesis_Disable() override;
+    int Kinesis_GetPositionControlMode() override;
+    short Kinesis_SetPositionControlMode(int mode) override;
+    short Kinesis_GetMaxOutputVoltage() override;
+    WORD Kinesis_GetMaximumTravel() override;
+    short Kinesis_GetOutputVoltage() override;
+    short Kinesis_SetOutputVoltage(short voltage) override;
+    WORD Kinesis_GetPosition() override;
+    short Kinesis_SetPosition(WORD position) override;
+    int Kinesis_GetVoltageSource() override;
+    short Kinesis_SetVoltageSource(int source) override;
+    short Kinesis_SetLUTWaveParams(LUTWaveParams const& params) override;
+    short Kinesis_SetLUTWaveSample(short index, WORD value) override;
+    short Kinesis_StartLUTOutput() override;
+    short Kinesis_StopLUTOutput() override;
+};
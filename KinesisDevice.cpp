@@ -32,20 +32,241 @@
 
 #include "KinesisDevice.h"
 
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
-std::string
-KinesisDevice::GetModelNo() {
+
+// The Kinesis message callback takes no arguments, so we register the same
+// callback for every device and drain the queues of all devices that have
+// message handling enabled. Draining happens on our own thread rather than in
+// the callback, to avoid calling into Kinesis from within its own callback.
+//
+// The thread exists only while at least one device is registered, so that it
+// is never running when the adapter DLL is unloaded.
+class KinesisDevice::MessageDispatcher {
+    std::mutex devicesMutex_; // Also held while draining
+    std::vector<KinesisDevice*> devices_;
+
+    std::mutex signalMutex_;
+    std::condition_variable signalCondition_;
+    bool signaled_ = false;
+    unsigned generation_ = 0; // Incremented to stop the current thread
+    std::thread thread_;
+
+public:
+    static MessageDispatcher& Instance() {
+        static MessageDispatcher instance;
+        return instance;
+    }
+
+    static void KinesisCallback() {
+        Instance().Signal();
+    }
+
+    void Add(KinesisDevice* device) {
+        std::lock_guard<std::mutex> lock(devicesMutex_);
+        devices_.push_back(device);
+
+        std::lock_guard<std::mutex> signalLock(signalMutex_);
+        if (!thread_.joinable()) {
+            unsigned generation = generation_;
+            thread_ = std::thread([this, generation] { Run(generation); });
+        }
+    }
+
+    // Once this returns, the device's handler is no longer running or called
+    void Remove(KinesisDevice* device) {
+        std::thread finished;
+        {
+            std::lock_guard<std::mutex> lock(devicesMutex_);
+            devices_.erase(std::remove(devices_.begin(), devices_.end(), device),
+                devices_.end());
+            if (!devices_.empty())
+                return;
+
+            std::lock_guard<std::mutex> signalLock(signalMutex_);
+            ++generation_;
+            finished = std::move(thread_);
+        }
+        signalCondition_.notify_all();
+        if (finished.joinable())
+            finished.join();
+    }
+
+    void Signal() {
+        {
+            std::lock_guard<std::mutex> lock(signalMutex_);
+            signaled_ = true;
+        }
+        signalCondition_.notify_all();
+    }
+
+private:
+    void Run(unsigned generation) {
+        for (;;) {
+            {
+                std::unique_lock<std::mutex> lock(signalMutex_);
+                signalCondition_.wait(lock, [&] {
+                    return signaled_ || generation_ != generation;
+                });
+                if (generation_ != generation)
+                    return;
+                signaled_ = false;
+            }
+
+            std::lock_guard<std::mutex> lock(devicesMutex_);
+            for (KinesisDevice* device : devices_)
+                device->DrainMessageQueue();
+        }
+    }
+};
+
+
+short
+KinesisDevice::GetHardwareInfo(HardwareInfo& info) {
     char modelNo[16];
-    WORD type;
-    WORD numChannels;
     char notes[128];
-    DWORD firmwareVersion;
-    WORD hardwareVersion;
-    WORD modificationState;
     short err = Kinesis_GetHardwareInfo(modelNo, sizeof(modelNo),
-        &type, &numChannels, notes, sizeof(notes), &firmwareVersion,
-        &hardwareVersion, &modificationState);
+        &info.type, &info.numChannels, notes, sizeof(notes),
+        &info.firmwareVersion, &info.hardwareVersion, &info.modificationState);
+    if (err)
+        return err;
+    info.modelNo = modelNo;
+    info.notes = notes;
+    return 0;
+}
+
+
+std::string
+KinesisDevice::GetModelNo() {
+    HardwareInfo info;
+    short err = GetHardwareInfo(info);
     if (err)
         return "Error";
-    return modelNo;
+    return info.modelNo;
+}
+
+
+void
+KinesisDevice::StartMessageHandling(MessageHandler handler) {
+    if (handlingMessages_)
+        StopMessageHandling();
+
+    messageHandler_ = std::move(handler);
+    Kinesis_ClearMessageQueue();
+    MessageDispatcher::Instance().Add(this);
+    handlingMessages_ = true;
+    Kinesis_RegisterMessageCallback(&MessageDispatcher::KinesisCallback);
+}
+
+
+void
+KinesisDevice::StopMessageHandling() {
+    if (!handlingMessages_)
+        return;
+
+    // There is no way to unregister the callback; it becomes a no-op for
+    // this device once removed from the dispatcher.
+    MessageDispatcher::Instance().Remove(this);
+    handlingMessages_ = false;
+    messageHandler_ = nullptr;
+}
+
+
+void
+KinesisDevice::DrainMessageQueue() {
+    WORD type;
+    WORD id;
+    DWORD data;
+    while (Kinesis_MessageQueueSize() > 0 &&
+        Kinesis_GetNextMessage(&type, &id, &data)) {
+        if (messageHandler_)
+            messageHandler_(type, id, data);
+    }
+}
+
+
+void
+MotorDrive::StartMotionEvents(std::function<void()> onMotionCompleted) {
+    motionCompletedHandler_ = std::move(onMotionCompleted);
+    pendingMotions_ = 0;
+    StartMessageHandling([this](WORD type, WORD id, DWORD) {
+        HandleMotorMessage(type, id);
+    });
+}
+
+
+MotorDrive::StatusSnapshot
+MotorDrive::Snapshot() {
+    std::lock_guard<std::mutex> lock(snapshotMutex_);
+    auto const now = std::chrono::steady_clock::now();
+    int const intervalMs = PollingIntervalMs();
+    if (snapshotValid_ && intervalMs > 0 &&
+        now - snapshot_.time < std::chrono::milliseconds(intervalMs))
+        return snapshot_;
+
+    snapshot_.statusBits = GetStatusBits();
+    snapshot_.position = GetPositionCounter();
+    long count = 0;
+    snapshot_.encoderCount = ReadEncoderCounter(count) ? count : 0;
+    snapshot_.time = now;
+    snapshotValid_ = true;
+    return snapshot_;
+}
+
+
+void
+MotorDrive::InvalidateSnapshot() {
+    std::lock_guard<std::mutex> lock(snapshotMutex_);
+    snapshotValid_ = false;
+}
+
+
+double
+MotorDrive::MsSinceMotionCompleted() const {
+    long long ticks = lastMotionCompletedTicks_;
+    if (ticks == 0)
+        return 1e300;
+    auto then = std::chrono::steady_clock::time_point(
+        std::chrono::steady_clock::duration(ticks));
+    return std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - then).count();
+}
+
+
+void
+MotorDrive::EndMotion() {
+    int pending = pendingMotions_;
+    while (pending > 0 &&
+        !pendingMotions_.compare_exchange_weak(pending, pending - 1))
+        ;
+}
+
+
+void
+MotorDrive::HandleMotorMessage(WORD messageType, WORD messageID) {
+    if (messageType != MessageTypeGenericMotor)
+        return;
+    switch (messageID) {
+    case GenericMotorMessageHomed:
+    case GenericMotorMessageMoved:
+    case GenericMotorMessageStopped:
+        break;
+    default:
+        return;
+    }
+
+    // A move that is retargeted by another move may or may not be reported
+    // separately; if it is not, the count stays positive and the caller's
+    // status-bit fallback takes over.
+    lastMotionCompletedTicks_ =
+        std::chrono::steady_clock::now().time_since_epoch().count();
+    EndMotion();
+    InvalidateSnapshot();
+    if (motionCompletedHandler_)
+        motionCompletedHandler_();
 }
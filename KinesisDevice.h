@@ -32,8 +32,16 @@
 
 #pragma once
 
+#include "CommandQueue.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <Windows.h>
 
@@ -50,6 +58,12 @@
 // open the device. These "connection" objects should be managed with
 // shared_ptr. They form a class hierarchy just like KinesisDeivce.
 
+// Kinesis error code TL_FUNCTION_NOT_SUPPORTED ("The function is not available
+// for this device"). We also return this from wrappers for functions that a
+// device type does not have at all.
+short const KinesisErrorFunctionNotSupported = 18;
+
+
 // Common base class for KinesisDeviceConnection and KinesisDevice
 class SerialNumbered {
     std::string const serialNo_;
@@ -105,6 +119,9 @@ protected: // Functions to be implemented by derived classes
 class KinesisDeviceConnection {
     std::unique_ptr<KinesisDeviceAccess> access_;
     short const connectionError_;
+    CommandQueue commands_;
+    std::mutex claimsMutex_;
+    std::vector<short> claimedChannels_;
 
 public:
     explicit KinesisDeviceConnection(std::unique_ptr<KinesisDeviceAccess> access) :
@@ -132,6 +149,30 @@ public:
     short ConnectionError() const {
         return connectionError_;
     }
+
+    // Commands to the device (all channels) go through this queue
+    CommandQueue& Commands() {
+        return commands_;
+    }
+
+    // A channel (-1 if not multi-channel) may be driven by only one device
+    // adapter device at a time, because the owner stops its polling,
+    // disables it and consumes its messages. Returns false if already
+    // claimed. Thread safe.
+    bool ClaimChannel(short channel) {
+        std::lock_guard<std::mutex> lock(claimsMutex_);
+        if (std::find(claimedChannels_.begin(), claimedChannels_.end(),
+            channel) != claimedChannels_.end())
+            return false;
+        claimedChannels_.push_back(channel);
+        return true;
+    }
+
+    void ReleaseChannel(short channel) {
+        std::lock_guard<std::mutex> lock(claimsMutex_);
+        claimedChannels_.erase(std::remove(claimedChannels_.begin(),
+            claimedChannels_.end(), channel), claimedChannels_.end());
+    }
 };
 
 
@@ -139,6 +180,16 @@ class KinesisDevice : public SerialNumbered {
     short const channel_;
     std::shared_ptr<KinesisDeviceConnection> const connection_;
 
+public:
+    using MessageHandler = std::function<void(WORD messageType,
+        WORD messageID, DWORD messageData)>;
+
+private:
+    class MessageDispatcher;
+    MessageHandler messageHandler_;
+    bool handlingMessages_ = false;
+    std::atomic<int> pollingIntervalMs_{ 0 }; // 0 if not polling
+
 public:
     explicit KinesisDevice(std::shared_ptr<KinesisDeviceConnection> connection) :
         KinesisDevice{ connection, -1 }
@@ -150,20 +201,76 @@ public:
         connection_{ connection }
     {}
 
+    // Owners should call StopMessageHandling() before destroying the device;
+    // by the time this runs, derived-class overrides are already gone.
+    ~KinesisDevice() override { StopMessageHandling(); }
+
     std::shared_ptr<KinesisDeviceConnection> GetConnection() { return connection_; }
 
+    // Shared by all channels of the device
+    CommandQueue& Commands() { return connection_->Commands(); }
+
     // Return channel, or -1 if device is not multi-channel
     short Channel() const { return channel_; }
 
     short RequestSettings() { return Kinesis_RequestSettings(); }
     short RequestStatusBits() { return Kinesis_RequestStatusBits(); }
-    bool StartPolling(int intervalMs) { return Kinesis_StartPolling(intervalMs); }
-    void StopPolling() { Kinesis_StopPolling(); }
+    bool StartPolling(int intervalMs) {
+        bool ok = Kinesis_StartPolling(intervalMs);
+        pollingIntervalMs_ = ok ? intervalMs : 0;
+        return ok;
+    }
+    void StopPolling() {
+        Kinesis_StopPolling();
+        pollingIntervalMs_ = 0;
+    }
+    // Interval of the Kinesis status polling, or 0 if not polling
+    int PollingIntervalMs() const { return pollingIntervalMs_; }
+
+    struct HardwareInfo {
+        std::string modelNo;
+        WORD type = 0;
+        WORD numChannels = 0;
+        std::string notes;
+        DWORD firmwareVersion = 0;
+        WORD hardwareVersion = 0;
+        WORD modificationState = 0;
+    };
+    short GetHardwareInfo(HardwareInfo& info);
 
     std::string GetModelNo();
 
     DWORD GetStatusBits() { return Kinesis_GetStatusBits(); }
 
+    // The last-message timer records when the device last sent us anything
+    // (e.g. a reply to RequestPosition()).
+    void EnableLastMessageTimer(bool enable) {
+        Kinesis_EnableLastMsgTimer(enable, 0); // No overrun timeout
+    }
+    // Returns -1 if the timer is not enabled
+    long long MsSinceLastMessage() {
+        __int64 ms;
+        if (!Kinesis_TimeSinceLastMsgReceived(ms))
+            return -1;
+        return ms;
+    }
+
+    // Kinesis message types (the messageType of the message queue)
+    enum MessageType : WORD {
+        MessageTypeGenericDevice = 0,
+        MessageTypeGenericPiezo = 1,
+        MessageTypeGenericMotor = 2,
+        MessageTypeGenericDCMotor = 3,
+    };
+
+    // Deliver the device's Kinesis messages to handler. The handler is called
+    // on a thread shared by all devices, and must not block or call back into
+    // Kinesis. Messages already queued are discarded. The owner must call
+    // StopMessageHandling() before destroying the device.
+    void StartMessageHandling(MessageHandler handler);
+    void StopMessageHandling();
+    bool IsHandlingMessages() const { return handlingMessages_; }
+
 protected: // 1:1 wrappers for Kinesis API functions
     virtual short Kinesis_RequestSettings() = 0;
     virtual short Kinesis_RequestStatusBits() = 0;
@@ -175,10 +282,66 @@ protected: // 1:1 wrappers for Kinesis API functions
         DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) = 0;
 
     virtual DWORD Kinesis_GetStatusBits() = 0;
+
+    virtual void Kinesis_EnableLastMsgTimer(bool enable, __int32 lastMsgTimeout) = 0;
+    virtual bool Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) = 0;
+
+    virtual void Kinesis_RegisterMessageCallback(void (*callback)()) = 0;
+    virtual int Kinesis_MessageQueueSize() = 0;
+    virtual void Kinesis_ClearMessageQueue() = 0;
+    virtual bool Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+        DWORD* messageData) = 0;
+
+private:
+    void DrainMessageQueue();
+};
+
+
+// Scale factors from position device units (encoder counts or microsteps) per
+// second, and per second squared, to the device's velocity and acceleration
+// units. They follow from each controller type's sampling interval (Thorlabs
+// APT communications protocol).
+struct MotionScale {
+    double velocity;
+    double acceleration;
 };
 
+namespace MotionScales {
+    // Sampling interval 2048 / 6 MHz
+    MotionScale const DCServo{ 65536.0 * (2048.0 / 6e6),
+        65536.0 * (2048.0 / 6e6) * (2048.0 / 6e6) };
+    // Sampling interval 102.4 us
+    MotionScale const Brushless{ 65536.0 * 102.4e-6,
+        65536.0 * 102.4e-6 * 102.4e-6 };
+    // KST101, TST101, BSC20x, and integrated stepper stages
+    MotionScale const Stepper{ 53.68, 1.0 / 90.9 };
+    // TST001, BSC10x: velocity and acceleration are in microsteps
+    MotionScale const LegacyStepper{ 1.0, 1.0 };
+}
+
 
 class MotorDrive : public KinesisDevice {
+    // Number of commanded moves (including homing) not yet reported complete
+    // by the controller; only meaningful while motion events are enabled
+    std::atomic<int> pendingMotions_{ 0 };
+    std::atomic<long long> lastMotionCompletedTicks_{ 0 };
+    std::function<void()> motionCompletedHandler_;
+
+public:
+    // Polled state, read in one go so that the values are mutually
+    // consistent
+    struct StatusSnapshot {
+        long position = 0; // As GetPositionCounter()
+        long encoderCount = 0; // As GetEncoderCounter(); 0 if no encoder
+        DWORD statusBits = 0;
+        std::chrono::steady_clock::time_point time;
+    };
+
+private:
+    std::mutex snapshotMutex_;
+    StatusSnapshot snapshot_;
+    bool snapshotValid_ = false;
+
 public:
     explicit MotorDrive(std::shared_ptr<KinesisDeviceConnection> connection) :
         KinesisDevice{ connection }
@@ -209,8 +372,12 @@ public:
         StatusBitsMotorConnected = 0x100, // Not applicable to KVS vertical stage
         StatusBitsHoming = 0x200,
         StatusBitsHomed = 0x400,
-        // There are several more for digital input etc.
+        // There are several more for digital inputs etc.
+        StatusBitsDigitalInput1 = 0x00100000,
         StatusBitsChannelEnabled = 0x80000000,
+
+        StatusBitsInMotion = StatusBitsMovingCW | StatusBitsMovingCCW |
+            StatusBitsJoggingCW | StatusBitsJoggingCCW | StatusBitsHoming,
     };
 
     // This function appears to be meaningless: although it does change the
@@ -263,13 +430,206 @@ public:
         return Kinesis_SetRotationModes(mode, direction);
     }
 
+    // Return the polled position and status. Kinesis only updates them once
+    // per polling interval, so the snapshot is reused until the interval has
+    // elapsed, or until a move is commanded or reported complete. Not cached
+    // when not polling. Thread safe.
+    StatusSnapshot Snapshot();
+    void InvalidateSnapshot();
+
     short RequestPosition() { return Kinesis_RequestPosition(); }
     int GetPosition() { return Kinesis_GetPosition(); }
     long GetPositionCounter() { return Kinesis_GetPositionCounter(); }
-    short MoveToPosition(int index) { return Kinesis_MoveToPosition(index); }
+    // Moves and homing go through the device's command queue, so that the
+    // channels of a multi-channel controller are commanded one at a time
+    short MoveToPosition(int index) {
+        BeginMotion();
+        short err = Commands().Execute([&] {
+            return Kinesis_MoveToPosition(index);
+        });
+        if (err)
+            EndMotion();
+        return err;
+    }
+
+    // Relative to the current position as known to the controller, so that
+    // this does not depend on our (polled) position being up to date
+    short MoveRelative(int displacement) {
+        BeginMotion();
+        short err = Commands().Execute([&] {
+            return Kinesis_MoveRelative(displacement);
+        });
+        if (err)
+            EndMotion();
+        return err;
+    }
+
+    // Values match MOT_TravelDirection
+    enum TravelDirection {
+        TravelDirectionForwards = 1,
+        TravelDirectionBackwards = 2,
+    };
+
+    // Move at the maximum velocity of the velocity parameters until stopped
+    // (or a limit is reached)
+    short MoveAtVelocity(TravelDirection direction) {
+        BeginMotion();
+        short err = Commands().Execute([&] {
+            return Kinesis_MoveAtVelocity(direction);
+        });
+        if (err)
+            EndMotion();
+        return err;
+    }
+
+    // Decelerate to a stop (the move in progress reports Stopped)
+    short StopProfiled() {
+        return Commands().Execute([&] { return Kinesis_StopProfiled(); });
+    }
+
+    // Velocity parameters are in device units; see GetMotionScale()
+    short GetVelocityParams(int& acceleration, int& maxVelocity) {
+        return Kinesis_GetVelParams(&acceleration, &maxVelocity);
+    }
+    short SetVelocityParams(int acceleration, int maxVelocity) {
+        return Commands().Execute([&] {
+            return Kinesis_SetVelParams(acceleration, maxVelocity);
+        });
+    }
+    short GetJogVelocityParams(int& acceleration, int& maxVelocity) {
+        return Kinesis_GetJogVelParams(&acceleration, &maxVelocity);
+    }
+    short SetJogVelocityParams(int acceleration, int maxVelocity) {
+        return Commands().Execute([&] {
+            return Kinesis_SetJogVelParams(acceleration, maxVelocity);
+        });
+    }
+
+    virtual MotionScale GetMotionScale() = 0;
 
     bool CanHome() { return Kinesis_CanHome(); }
-    short Home() { return Kinesis_Home(); }
+    short Home() {
+        BeginMotion();
+        short err = Commands().Execute([&] { return Kinesis_Home(); });
+        if (err)
+            EndMotion();
+        return err;
+    }
+
+    // Message IDs of MessageTypeGenericMotor
+    enum GenericMotorMessage : WORD {
+        GenericMotorMessageHomed = 0,
+        GenericMotorMessageMoved = 1,
+        GenericMotorMessageStopped = 2,
+        GenericMotorMessageLimitUpdated = 3,
+    };
+
+    // Motion events: track completion of moves through the controller's
+    // Homed/Moved/Stopped messages, which arrive without waiting for the next
+    // status poll. onMotionCompleted (optional) is called on the message
+    // thread for every completion, including moves we did not command (e.g.
+    // trigger-in moves).
+    void StartMotionEvents(std::function<void()> onMotionCompleted = {});
+    void StopMotionEvents() { StopMessageHandling(); }
+    bool MotionEventsEnabled() const { return IsHandlingMessages(); }
+
+    // True if a move or home we commanded has not been reported complete
+    bool IsMotionPending() const { return pendingMotions_ > 0; }
+    // Forget pending moves (use when the completion message was missed)
+    void ClearMotionPending() { pendingMotions_ = 0; }
+    // Milliseconds since the last completion message (large if never)
+    double MsSinceMotionCompleted() const;
+
+    // Trigger ports exist only on K-Cube motor controllers. On other devices,
+    // HasTriggerPorts() returns false and the trigger functions return
+    // KinesisErrorFunctionNotSupported. Values match KMOT_TriggerPortMode and
+    // KMOT_TriggerPortPolarity.
+    enum TriggerPortMode {
+        TriggerPortModeDisabled = 0x00,
+        TriggerPortModeInGPI = 0x01,
+        TriggerPortModeInRelativeMove = 0x02,
+        TriggerPortModeInAbsoluteMove = 0x03,
+        TriggerPortModeInHome = 0x04,
+        TriggerPortModeInStop = 0x05,
+        TriggerPortModeOutGPO = 0x0A,
+        TriggerPortModeOutInMotion = 0x0B,
+        TriggerPortModeOutAtMaxVelocity = 0x0C,
+        TriggerPortModeOutAtPositionSteps = 0x0D,
+        TriggerPortModeOutSynch = 0x0E,
+    };
+    enum TriggerPortPolarity {
+        TriggerPortPolarityHigh = 0x01,
+        TriggerPortPolarityLow = 0x02,
+    };
+    struct TriggerConfig {
+        TriggerPortMode mode1;
+        TriggerPortPolarity polarity1;
+        TriggerPortMode mode2;
+        TriggerPortPolarity polarity2;
+    };
+
+    virtual bool HasTriggerPorts() const { return false; }
+
+    short GetTriggerConfig(TriggerConfig& config) {
+        int mode1, polarity1, mode2, polarity2;
+        short err = Kinesis_GetTriggerConfigParams(&mode1, &polarity1,
+            &mode2, &polarity2);
+        if (err)
+            return err;
+        config.mode1 = static_cast<TriggerPortMode>(mode1);
+        config.polarity1 = static_cast<TriggerPortPolarity>(polarity1);
+        config.mode2 = static_cast<TriggerPortMode>(mode2);
+        config.polarity2 = static_cast<TriggerPortPolarity>(polarity2);
+        return 0;
+    }
+    short SetTriggerConfig(TriggerConfig const& config) {
+        return Kinesis_SetTriggerConfigParams(config.mode1, config.polarity1,
+            config.mode2, config.polarity2);
+    }
+
+    // Target of the next trigger-in absolute move
+    short SetMoveAbsolutePosition(int position) {
+        return Commands().Execute([&] {
+            return Kinesis_SetMoveAbsolutePosition(position);
+        });
+    }
+
+    // Displacement of each trigger-in relative move
+    short SetMoveRelativeDistance(int distance) {
+        return Commands().Execute([&] {
+            return Kinesis_SetMoveRelativeDistance(distance);
+        });
+    }
+
+    // Pulses output by ports in TriggerPortModeOutAtPositionSteps mode:
+    // pulseCount pulses of pulseWidthUs, starting at startPosition and
+    // spaced by interval (device units), for moves in each direction. The
+    // pattern is repeated cycleCount times.
+    struct TriggerPositionParams {
+        int startPositionFwd;
+        int intervalFwd;
+        int pulseCountFwd;
+        int startPositionRev;
+        int intervalRev;
+        int pulseCountRev;
+        int pulseWidthUs;
+        int cycleCount;
+    };
+
+    short GetTriggerPositionParams(TriggerPositionParams& params) {
+        return Kinesis_GetTriggerParamsParams(&params.startPositionFwd,
+            &params.intervalFwd, &params.pulseCountFwd,
+            &params.startPositionRev, &params.intervalRev,
+            &params.pulseCountRev, &params.pulseWidthUs, &params.cycleCount);
+    }
+    short SetTriggerPositionParams(TriggerPositionParams const& params) {
+        return Commands().Execute([&] {
+            return Kinesis_SetTriggerParamsParams(params.startPositionFwd,
+                params.intervalFwd, params.pulseCountFwd,
+                params.startPositionRev, params.intervalRev,
+                params.pulseCountRev, params.pulseWidthUs, params.cycleCount);
+        });
+    }
 
     // These conversion functions seem to always return an error (tested with
     // cage rotator K10CR1; Kinesis 1.14.18)
@@ -293,14 +653,63 @@ protected:
     virtual int Kinesis_GetPosition() = 0;
     virtual long Kinesis_GetPositionCounter() = 0;
     virtual short Kinesis_MoveToPosition(int index) = 0;
+    virtual short Kinesis_MoveRelative(int displacement) = 0;
+    virtual short Kinesis_MoveAtVelocity(int direction) = 0;
+    virtual short Kinesis_StopProfiled() = 0;
 
     virtual bool Kinesis_CanHome() = 0;
     virtual short Kinesis_Home() = 0;
 
+    virtual short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) = 0;
+    virtual short Kinesis_SetVelParams(int acceleration, int maxVelocity) = 0;
+    virtual short Kinesis_GetJogVelParams(int* acceleration, int* maxVelocity) = 0;
+    virtual short Kinesis_SetJogVelParams(int acceleration, int maxVelocity) = 0;
+
     virtual short Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
         double* realValue, int unitType) = 0;
     virtual short Kinesis_GetDeviceUnitFromRealValue(double realValue,
         int* deviceUnits, int unitType) = 0;
+
+    // Should be overridden only for device types with trigger ports
+    virtual short Kinesis_GetTriggerConfigParams(int* mode1, int* polarity1,
+        int* mode2, int* polarity2) {
+        return KinesisErrorFunctionNotSupported;
+    }
+    virtual short Kinesis_SetTriggerConfigParams(int mode1, int polarity1,
+        int mode2, int polarity2) {
+        return KinesisErrorFunctionNotSupported;
+    }
+    virtual short Kinesis_SetMoveAbsolutePosition(int position) {
+        return KinesisErrorFunctionNotSupported;
+    }
+    virtual short Kinesis_SetMoveRelativeDistance(int distance) {
+        return KinesisErrorFunctionNotSupported;
+    }
+    virtual short Kinesis_GetTriggerParamsParams(int* startPositionFwd,
+        int* intervalFwd, int* pulseCountFwd, int* startPositionRev,
+        int* intervalRev, int* pulseCountRev, int* pulseWidth,
+        int* cycleCount) {
+        return KinesisErrorFunctionNotSupported;
+    }
+    virtual short Kinesis_SetTriggerParamsParams(int startPositionFwd,
+        int intervalFwd, int pulseCountFwd, int startPositionRev,
+        int intervalRev, int pulseCountRev, int pulseWidth,
+        int cycleCount) {
+        return KinesisErrorFunctionNotSupported;
+    }
+
+    // Should be overridden only for device types with an encoder
+    virtual bool ReadEncoderCounter(long& count) {
+        return false;
+    }
+
+private:
+    void BeginMotion() {
+        ++pendingMotions_;
+        InvalidateSnapshot();
+    }
+    void EndMotion();
+    void HandleMotorMessage(WORD messageType, WORD messageID);
 };
 
 
@@ -318,4 +727,163 @@ public:
 
 protected:
     virtual long Kinesis_GetEncoderCounter() = 0;
+
+    bool ReadEncoderCounter(long& count) override {
+        count = Kinesis_GetEncoderCounter();
+        return true;
+    }
+};
+
+
+// Piezo controller (K-Cube piezo). The output is set as a voltage (open loop)
+// or, with a strain gauge reader, as a position (closed loop). Both are in
+// device units that are a fraction of the maximum: voltage -32767 to 32767 of
+// the maximum output voltage, position 0 to 32767 of the maximum travel.
+class PiezoDrive : public KinesisDevice {
+public:
+    explicit PiezoDrive(std::shared_ptr<KinesisDeviceConnection> connection) :
+        KinesisDevice{ connection }
+    {}
+
+    static int const MaxDeviceUnits = 32767;
+    static int const MaxLUTLength = 512; // KPZ101
+
+    // Values match PZ_ControlModeTypes
+    enum ControlMode {
+        ControlModeOpenLoop = 1,
+        ControlModeClosedLoop = 2,
+        ControlModeOpenLoopSmooth = 3,
+        ControlModeClosedLoopSmooth = 4,
+    };
+
+    // Values match PZ_InputSourceFlags
+    enum VoltageSource {
+        VoltageSourceSoftwareOnly = 0,
+        VoltageSourceExternalSignal = 1,
+        VoltageSourcePotentiometer = 2,
+        VoltageSourceAll = 3,
+    };
+
+    // From the KPZ101 documentation
+    enum StatusBits : DWORD {
+        StatusBitsActuatorConnected = 0x1,
+        StatusBitsZeroed = 0x10,
+        StatusBitsZeroing = 0x20,
+        StatusBitsStrainGaugeConnected = 0x100,
+        StatusBitsClosedLoop = 0x400,
+        StatusBitsChannelEnabled = 0x80000000,
+    };
+
+    // Values match PZ_OutputLUTModes (flags)
+    enum LUTMode {
+        LUTModeContinuous = 1,
+        LUTModeFixed = 2,
+        LUTModeOutputTriggerEnable = 4,
+        LUTModeInputTriggerEnable = 8,
+        LUTModeOutputTriggerSenseHigh = 16,
+        LUTModeInputTriggerSenseHigh = 32,
+        LUTModeOutputGated = 64,
+        LUTModeOutputTriggerRepeat = 128,
+    };
+
+    // As PZ_LUTWaveParameters; times are in ms
+    struct LUTWaveParams {
+        int mode = LUTModeContinuous;
+        short cycleLength = 0; // Number of samples
+        unsigned numCycles = 0; // Ignored in continuous mode
+        unsigned valueDelayMs = 1; // Time spent at each sample
+        unsigned preCycleRestMs = 0;
+        unsigned postCycleRestMs = 0;
+        short outputTriggerStart = 0;
+        unsigned outputTriggerWidthMs = 0;
+        short numOutputTriggerRepeat = 0;
+        unsigned outputTriggerRepeatIntervalMs = 0;
+    };
+
+    short RequestPosition() { return Kinesis_RequestPosition(); }
+
+    short SetChannelEnabled(bool enabled) {
+        return enabled ? Kinesis_Enable() : Kinesis_Disable();
+    }
+    bool IsChannelEnabled() {
+        return GetStatusBits() & StatusBitsChannelEnabled;
+    }
+
+    ControlMode GetControlMode() {
+        return static_cast<ControlMode>(Kinesis_GetPositionControlMode());
+    }
+    short SetControlMode(ControlMode mode) {
+        return Commands().Execute([&] {
+            return Kinesis_SetPositionControlMode(mode);
+        });
+    }
+    bool IsClosedLoop() {
+        ControlMode mode = GetControlMode();
+        return mode == ControlModeClosedLoop ||
+            mode == ControlModeClosedLoopSmooth;
+    }
+
+    // In units of 0.1 V and 100 nm; travel is 0 without a strain gauge
+    short GetMaxOutputVoltage() { return Kinesis_GetMaxOutputVoltage(); }
+    WORD GetMaxTravel() { return Kinesis_GetMaximumTravel(); }
+
+    short GetOutputVoltage() { return Kinesis_GetOutputVoltage(); }
+    short SetOutputVoltage(short voltage) {
+        return Commands().Execute([&] {
+            return Kinesis_SetOutputVoltage(voltage);
+        });
+    }
+    WORD GetPosition() { return Kinesis_GetPosition(); }
+    short SetPosition(WORD position) {
+        return Commands().Execute([&] {
+            return Kinesis_SetPosition(position);
+        });
+    }
+
+    VoltageSource GetVoltageSource() {
+        return static_cast<VoltageSource>(Kinesis_GetVoltageSource());
+    }
+    short SetVoltageSource(VoltageSource source) {
+        return Commands().Execute([&] {
+            return Kinesis_SetVoltageSource(source);
+        });
+    }
+
+    // Lookup table (waveform) output. Samples are in the device units of
+    // the current control mode (voltage or position).
+    short SetLUTWaveParams(LUTWaveParams const& params) {
+        return Commands().Execute([&] {
+            return Kinesis_SetLUTWaveParams(params);
+        });
+    }
+    short SetLUTWaveSample(short index, WORD value) {
+        return Commands().Execute([&] {
+            return Kinesis_SetLUTWaveSample(index, value);
+        });
+    }
+    short StartLUTOutput() {
+        return Commands().Execute([&] { return Kinesis_StartLUTOutput(); });
+    }
+    short StopLUTOutput() {
+        return Commands().Execute([&] { return Kinesis_StopLUTOutput(); });
+    }
+
+protected: // Piezo
+    virtual short Kinesis_RequestPosition() = 0;
+    virtual short Kinesis_Enable() = 0;
+    virtual short Kinesis_Disable() = 0;
+    virtual int Kinesis_GetPositionControlMode() = 0;
+    virtual short Kinesis_SetPositionControlMode(int mode) = 0;
+    virtual short Kinesis_GetMaxOutputVoltage() = 0;
+    virtual WORD Kinesis_GetMaximumTravel() = 0;
+    virtual short Kinesis_GetOutputVoltage() = 0;
+    virtual short Kinesis_SetOutputVoltage(short voltage) = 0;
+    virtual WORD Kinesis_GetPosition() = 0;
+    virtual short Kinesis_SetPosition(WORD position) = 0;
+    virtual int Kinesis_GetVoltageSource() = 0;
+    virtual short Kinesis_SetVoltageSource(int source) = 0;
+    virtual short Kinesis_SetLUTWaveParams(LUTWaveParams const& params) = 0;
+    virtual short Kinesis_SetLUTWaveSample(short index, WORD value) = 0;
+    virtual short Kinesis_StartLUTOutput() = 0;
+    virtual short Kinesis_StopLUTOutput() = 0;
 };
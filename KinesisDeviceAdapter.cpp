@@ -31,17 +31,48 @@
 // POSSIBILITY OF SUCH DAMAGE.
 
 #include "Connections.h"
+#include "DLLCallStats.h"
 #include "DeviceEnumeration.h"
 #include "DeviceInstantiation.h"
+#include "DeviceInventory.h"
+#include "DeviceWatcher.h"
+#include "HomedStateStore.h"
+#include "MockKinesis.h"
+#include "MoveGroup.h"
+#include "StageRegistry.h"
+#include "XYStage.h"
 
 #include "DeviceBase.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
 #include <sstream>
+#include <thread>
+#include <vector>
 
 namespace {
     std::string const DEVICENAME_HUB = "ThorlabsKinesis";
 
     std::string const PROPERTY_ENABLE_SIMULATED = "EnableSimulatedDevices";
+    std::string const PROPERTY_INVENTORY_CACHE_FILE = "InventoryCacheFile";
+    std::string const PROPERTY_HOMED_STATE_FILE = "HomedStateFile";
+    std::string const PROPERTY_MOCK_DEVICES = "MockDevices";
+    std::string const PROPERTY_DETECT_HOT_PLUG = "DetectHotPlug";
+    std::string const PROPERTY_CALL_STATISTICS = "CallStatistics";
+    std::string const PROPERTY_CALL_STATISTICS_REPORT = "CallStatisticsReport";
+    std::string const PROPERTY_HOME_ALL = "HomeAll";
+    std::string const PROPERTY_HOMED_STAGES = "HomedStages";
+
+    std::string const PROPVALUE_REPORT_IDLE = "Idle";
+    std::string const PROPVALUE_REPORT_LOG = "Log";
+    std::string const PROPVALUE_REPORT_LOG_AND_RESET = "Log and reset";
+
+    std::string const PROPVALUE_HOME_IDLE = "Idle";
+    std::string const PROPVALUE_HOME_START = "Home";
 
     std::string const PROPVALUE_YES = "Yes";
     std::string const PROPVALUE_NO = "No";
@@ -49,14 +80,74 @@ namespace {
 
     int const ERR_KINESIS_DRIVER_NOT_FOUND = 99999;
     int const ERR_MULTIPLE_HUBS = 99998;
+
+    // Upper bound on devices opened concurrently
+    size_t const MAX_CONNECTION_THREADS = 8;
+
+    // Call func(0), ..., func(count - 1) on up to MAX_CONNECTION_THREADS
+    // threads (including the calling thread)
+    void ForEachConcurrently(size_t count, std::function<void(size_t)> func) {
+        std::atomic<size_t> nextIndex{ 0 };
+        auto worker = [&] {
+            for (;;) {
+                size_t i = nextIndex++;
+                if (i >= count)
+                    return;
+                func(i);
+            }
+        };
+
+        size_t numThreads = std::min(MAX_CONNECTION_THREADS, count);
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < numThreads; ++t)
+            threads.emplace_back(worker);
+        worker();
+        for (auto& thread : threads)
+            thread.join();
+    }
 }
 
 
 namespace {
 
-    class KinesisHub final : public HubBase<KinesisHub> {
-        std::vector<std::string> deviceSerialNos_;
+    class KinesisHub final : public HubBase<KinesisHub>,
+        public DeviceInventoryProvider, public HomedStateProvider,
+        public StageRegistry {
+        std::shared_ptr<DeviceInventory> const inventory_;
+        std::string inventoryCacheFile_;
+        std::shared_ptr<HomedStateStore> homedStateStore_; // Null if not set
+        std::thread validationThread_;
+        std::thread preloadThread_;
+
+        // Connections to configured devices, opened in the background after
+        // enumeration and kept open until the peripherals have picked them up
+        // (through UniqueConnection()).
+        std::thread warmUpThread_;
+        std::mutex warmUpMutex_;
+        std::vector<std::shared_ptr<KinesisDeviceConnection>> warmConnections_;
+
+        // Controllers plugged in after initialization are added to the
+        // inventory once the notifications have been quiet for a moment
+        // (plugging in a USB hub of controllers produces a burst); unplugged
+        // ones are removed right away
+        std::unique_ptr<DeviceWatcher> deviceWatcher_;
+        std::thread hotPlugThread_;
+        std::mutex hotPlugMutex_;
+        std::condition_variable hotPlugCondition_;
+        std::vector<std::string> arrivedSerialNos_;
+        std::chrono::steady_clock::time_point lastArrival_;
+        bool hotPlugStopRequested_{ false };
+
         bool simulatorsEnabled_;
+        bool mockEnabled_{ false };
+
+        // Initialized stages, and those still homing after HomeAll
+        std::mutex stagesMutex_;
+        std::vector<RegisteredStage*> stages_;
+        std::vector<RegisteredStage*> homingStages_;
+        // Held by HomeAll while it calls stages outside stagesMutex_, so that
+        // UnregisterStage can still wait until a stage is no longer called
+        std::mutex homeAllMutex_;
 
         // Only allow a single instance of hub to be initialized at a time.
         static bool lock_;
@@ -64,6 +155,7 @@ namespace {
 
     public:
         KinesisHub() :
+            inventory_{ std::make_shared<DeviceInventory>() },
             simulatorsEnabled_{ false },
             lockHeld_{ false }
         {
@@ -72,37 +164,254 @@ namespace {
             AddAllowedValue(PROPERTY_ENABLE_SIMULATED.c_str(), PROPVALUE_YES.c_str());
             AddAllowedValue(PROPERTY_ENABLE_SIMULATED.c_str(), PROPVALUE_NO.c_str());
 
+            // Optional; if set, devices are taken from this file at startup
+            // while the actual device list is built in the background
+            CreateStringProperty(PROPERTY_INVENTORY_CACHE_FILE.c_str(), "",
+                false, nullptr, true);
+
+            // Optional; if set, stages that have been homed are not homed
+            // again after a restart, as long as their controllers stayed on
+            CreateStringProperty(PROPERTY_HOMED_STATE_FILE.c_str(), "",
+                false, nullptr, true);
+
+            // Add controllers that are plugged in while running (they then
+            // appear in the Hardware Configuration Wizard). Off by default,
+            // so that existing configurations behave as before (no device
+            // list changes or Kinesis rebuilds while running).
+            CreateStringProperty(PROPERTY_DETECT_HOT_PLUG.c_str(),
+                PROPVALUE_NO.c_str(), false, nullptr, true);
+            AddAllowedValue(PROPERTY_DETECT_HOT_PLUG.c_str(), PROPVALUE_NO.c_str());
+            AddAllowedValue(PROPERTY_DETECT_HOT_PLUG.c_str(), PROPVALUE_YES.c_str());
+
+            // For testing without hardware: comma-separated serial numbers of
+            // in-process mock devices, used instead of Kinesis
+            CreateStringProperty(PROPERTY_MOCK_DEVICES.c_str(), "",
+                false, nullptr, true);
+
             SetErrorText(ERR_KINESIS_DRIVER_NOT_FOUND,
                 "Cannot load the Thorlabs Kinesis DLLs. Make sure Kinesis is "
                 "installed at the standard location");
             SetErrorText(ERR_MULTIPLE_HUBS, "Only one hub can be created");
         }
 
+        ~KinesisHub() override {
+            StopHotPlugDetection();
+            JoinBackgroundThreads();
+        }
+
         int Initialize() override {
             if (lock_)
                 return ERR_MULTIPLE_HUBS;
 
+            char s[MM::MaxStrLength];
+            GetProperty(PROPERTY_MOCK_DEVICES.c_str(), s);
+            std::vector<std::string> mockSerialNos;
+            std::istringstream mockStream{ s };
+            std::string mockSerialNo;
+            while (std::getline(mockStream, mockSerialNo, ',')) {
+                if (IsValidSerialNo(mockSerialNo))
+                    mockSerialNos.push_back(mockSerialNo);
+            }
+            if (!mockSerialNos.empty()) {
+                EnableMockKinesis(mockSerialNos);
+                mockEnabled_ = true;
+            }
+
             if (!IsKinesisDriverAvailable())
                 return ERR_KINESIS_DRIVER_NOT_FOUND;
 
             lock_ = true;
             lockHeld_ = true;
 
-            char s[MM::MaxStrLength];
             GetProperty("EnableSimulatedDevices", s);
-            if (s == PROPVALUE_YES) {
+            if (s == PROPVALUE_YES && !mockEnabled_) {
                 EnableSimulatedDevices();
                 simulatorsEnabled_ = true;
             }
 
-            deviceSerialNos_ = EnumerateSerialNumbers();
+            GetProperty(PROPERTY_INVENTORY_CACHE_FILE.c_str(), s);
+            inventoryCacheFile_ = s;
+
+            GetProperty(PROPERTY_HOMED_STATE_FILE.c_str(), s);
+            if (s[0] != '\0')
+                homedStateStore_ = std::make_shared<HomedStateStore>(s);
+
+            // Building the device list takes a while. With a cache file, we
+            // do it in the background; anything that opens a device waits for
+            // it to finish (see DeviceInventory::WaitForValidation()).
+            // Hardware info is added when devices are opened, either by
+            // DetectInstalledDevices() or by peripheral initialization.
+            if (!inventoryCacheFile_.empty() &&
+                inventory_->LoadFromFile(inventoryCacheFile_)) {
+                inventory_->BeginValidation();
+                validationThread_ = std::thread([this] { ValidateInventory(); });
+            }
+            else {
+                inventory_->Clear();
+                ValidateInventory();
+            }
+
+            StartPreload();
+            StartWarmUp();
+
+            GetProperty(PROPERTY_DETECT_HOT_PLUG.c_str(), s);
+            if (s == PROPVALUE_YES && !mockEnabled_)
+                StartHotPlugDetection();
+
+            // Timing of all calls into Kinesis, for diagnosing slow USB
+            // communication; off by default
+            CreateStringProperty(PROPERTY_CALL_STATISTICS.c_str(),
+                DLLCallStats::IsEnabled() ? PROPVALUE_YES.c_str() : PROPVALUE_NO.c_str(),
+                false, new CPropertyAction(this, &KinesisHub::OnCallStatistics));
+            AddAllowedValue(PROPERTY_CALL_STATISTICS.c_str(), PROPVALUE_NO.c_str());
+            AddAllowedValue(PROPERTY_CALL_STATISTICS.c_str(), PROPVALUE_YES.c_str());
+            CreateStringProperty(PROPERTY_CALL_STATISTICS_REPORT.c_str(),
+                PROPVALUE_REPORT_IDLE.c_str(), false,
+                new CPropertyAction(this, &KinesisHub::OnCallStatisticsReport));
+            AddAllowedValue(PROPERTY_CALL_STATISTICS_REPORT.c_str(),
+                PROPVALUE_REPORT_IDLE.c_str());
+            AddAllowedValue(PROPERTY_CALL_STATISTICS_REPORT.c_str(),
+                PROPVALUE_REPORT_LOG.c_str());
+            AddAllowedValue(PROPERTY_CALL_STATISTICS_REPORT.c_str(),
+                PROPVALUE_REPORT_LOG_AND_RESET.c_str());
+
+            // Home all stages at once; the hub is busy until all are done
+            CreateStringProperty(PROPERTY_HOME_ALL.c_str(),
+                PROPVALUE_HOME_IDLE.c_str(), false,
+                new CPropertyAction(this, &KinesisHub::OnHomeAll));
+            AddAllowedValue(PROPERTY_HOME_ALL.c_str(),
+                PROPVALUE_HOME_IDLE.c_str());
+            AddAllowedValue(PROPERTY_HOME_ALL.c_str(),
+                PROPVALUE_HOME_START.c_str());
+            CreateStringProperty(PROPERTY_HOMED_STAGES.c_str(), "", true,
+                new CPropertyAction(this, &KinesisHub::OnHomedStages));
+
+            return DEVICE_OK;
+        }
+
+        void RegisterStage(RegisteredStage* stage) override {
+            std::lock_guard<std::mutex> lock(stagesMutex_);
+            stages_.push_back(stage);
+        }
+
+        void UnregisterStage(RegisteredStage* stage) override {
+            std::lock_guard<std::mutex> homeAllLock(homeAllMutex_);
+            std::lock_guard<std::mutex> lock(stagesMutex_);
+            stages_.erase(std::remove(stages_.begin(), stages_.end(), stage),
+                stages_.end());
+            homingStages_.erase(std::remove(homingStages_.begin(),
+                homingStages_.end(), stage), homingStages_.end());
+        }
+
+        int OnHomeAll(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::AfterSet) {
+                std::string s;
+                pProp->Get(s);
+                if (s != PROPVALUE_HOME_IDLE) {
+                    pProp->Set(PROPVALUE_HOME_IDLE.c_str());
+                    return HomeAll();
+                }
+            }
+            return DEVICE_OK;
+        }
+
+        // Start homing every registered stage (that can home), without
+        // waiting for homing to finish. StartHoming() returns once the home
+        // command is sent, but may first wait for a ConnectOnFirstUse stage
+        // to connect, so the stages are called one by one and without
+        // holding stagesMutex_ (which Busy() and HomedStages need).
+        int HomeAll() {
+            std::lock_guard<std::mutex> homeAllLock(homeAllMutex_);
+            std::vector<RegisteredStage*> stages;
+            {
+                std::lock_guard<std::mutex> lock(stagesMutex_);
+                stages = stages_;
+                homingStages_.clear();
+            }
+
+            int ret = DEVICE_OK;
+            for (RegisteredStage* stage : stages) {
+                int result = stage->StartHoming();
+                if (result == DEVICE_OK) {
+                    std::lock_guard<std::mutex> lock(stagesMutex_);
+                    homingStages_.push_back(stage);
+                }
+                else if (result != DEVICE_UNSUPPORTED_COMMAND) {
+                    LogMessage("HomeAll: failed to start homing " +
+                        stage->StageName() + " (error " +
+                        std::to_string(result) + ")");
+                    if (ret == DEVICE_OK)
+                        ret = result;
+                }
+            }
+            return ret;
+        }
+
+        int OnHomedStages(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet) {
+                std::lock_guard<std::mutex> lock(stagesMutex_);
+                size_t homed = 0;
+                for (RegisteredStage* stage : stages_) {
+                    if (stage->IsHomed())
+                        ++homed;
+                }
+                pProp->Set((std::to_string(homed) + " of " +
+                    std::to_string(stages_.size())).c_str());
+            }
+            return DEVICE_OK;
+        }
+
+        int OnCallStatistics(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::BeforeGet) {
+                pProp->Set(DLLCallStats::IsEnabled() ?
+                    PROPVALUE_YES.c_str() : PROPVALUE_NO.c_str());
+            }
+            else if (eAct == MM::AfterSet) {
+                std::string s;
+                pProp->Get(s);
+                DLLCallStats::SetEnabled(s == PROPVALUE_YES);
+            }
+            return DEVICE_OK;
+        }
 
+        // Setting to Log writes the statistics to the CoreLog
+        int OnCallStatisticsReport(MM::PropertyBase* pProp, MM::ActionType eAct) {
+            if (eAct == MM::AfterSet) {
+                std::string s;
+                pProp->Get(s);
+                if (s != PROPVALUE_REPORT_IDLE) {
+                    LogMessage(DLLCallStats::FormatReport());
+                    if (s == PROPVALUE_REPORT_LOG_AND_RESET)
+                        DLLCallStats::ResetAll();
+                    pProp->Set(PROPVALUE_REPORT_IDLE.c_str());
+                }
+            }
             return DEVICE_OK;
         }
 
         int Shutdown() override {
+            StopHotPlugDetection();
+            JoinBackgroundThreads();
+            {
+                std::lock_guard<std::mutex> lock(warmUpMutex_);
+                warmConnections_.clear();
+            }
+            {
+                // Stages that are still initialized must not be called after
+                // this (they may outlive the hub)
+                std::lock_guard<std::mutex> lock(stagesMutex_);
+                stages_.clear();
+                homingStages_.clear();
+            }
+            if (!inventoryCacheFile_.empty())
+                inventory_->SaveToFile(inventoryCacheFile_);
+
             if (simulatorsEnabled_)
                 DisableSimulatedDevices();
+            if (mockEnabled_) {
+                DisableMockKinesis();
+                mockEnabled_ = false;
+            }
             if (lockHeld_)
                 lock_ = false;
             return DEVICE_OK;
@@ -112,51 +421,309 @@ namespace {
             CDeviceUtils::CopyLimitedString(name, DEVICENAME_HUB.c_str());
         }
 
+        // Busy while any stage started by HomeAll is still homing
         bool Busy() override {
-            return false;
+            std::lock_guard<std::mutex> lock(stagesMutex_);
+            homingStages_.erase(std::remove_if(homingStages_.begin(),
+                homingStages_.end(), [](RegisteredStage* stage) {
+                    return !stage->IsBusy();
+                }), homingStages_.end());
+            return !homingStages_.empty();
+        }
+
+        std::shared_ptr<DeviceInventory> GetDeviceInventory() override {
+            return inventory_;
+        }
+
+        std::shared_ptr<HomedStateStore> GetHomedStateStore() override {
+            return homedStateStore_;
         }
 
         int DetectInstalledDevices() override {
             ClearInstalledDevices();
 
-            for (auto const& serialNo : deviceSerialNos_) {
-                // We need to make a connection to the device in order to
-                // determine the number of channels, and also to get the model
-                // number.
-                // TODO Currently the dummy device will reconnect when
-                // GetName() is called. It might be good to prime the dummy
-                // device with the connection to avoid that (some devices are
-                // slow). This would mean passing the connection to
-                // MakeDevice() et al.
-                std::shared_ptr<KinesisDeviceConnection> connection = MakeConnection(serialNo);
-                if (!connection) {
+            inventory_->WaitForValidation();
+            std::vector<std::string> serialNos;
+            for (auto const& entry : inventory_->Entries())
+                serialNos.push_back(entry.serialNo);
+
+            // Opening a device can take about a second, so we open all devices
+            // concurrently, then register the peripherals in enumeration
+            // order.
+            std::vector<DiscoveredDevice> discovered(serialNos.size());
+            ForEachConcurrently(serialNos.size(), [&](size_t i) {
+                discovered[i] = DiscoverDevice(serialNos[i]);
+            });
+
+            size_t numMotorChannels = 0;
+            for (auto const& device : discovered) {
+                if (!device.connection) {
                     // Unsupported or (less likely) could not connect. If we
                     // can detect the device, create a placeholder to inform
                     // the user.
-                    KinesisDeviceInfo info{ serialNo };
-                    if (info.IsDevicePresent()) {
-                        MM::Device* dummy = MakeUnsupportedDevice(serialNo);
+                    if (device.isPresent) {
+                        MM::Device* dummy = MakeUnsupportedDevice(device.entry.serialNo);
                         if (dummy)
                             AddInstalledDevice(dummy);
                     }
+                    continue;
                 }
-                else if (IsPotentiallyMultiChannel(serialNo)) {
-                    short numChannels = connection->GetNumChannels();
-                    for (short ch = 1; ch <= numChannels; ++ch) {
-                        MM::Device* dummy = MakeDevice("", serialNo, ch, connection);
-                        if (dummy)
-                            AddInstalledDevice(dummy);
-                    }
+
+                inventory_->Set(device.entry);
+
+                // The peripherals get their names from the inventory, so
+                // GetName() need not reconnect
+                std::vector<short> channels;
+                if (IsPotentiallyMultiChannel(device.entry.serialNo)) {
+                    for (short ch = 1; ch <= device.entry.numChannels; ++ch)
+                        channels.push_back(ch);
                 }
                 else {
-                    MM::Device* dummy = MakeDevice("", serialNo, short(-1), connection);
+                    channels.push_back(short(-1));
+                }
+                for (short ch : channels) {
+                    MM::Device* dummy = MakeDevice("", device.entry.serialNo,
+                        ch, device.connection, inventory_);
                     if (dummy)
                         AddInstalledDevice(dummy);
                 }
+                DeviceType const* type = FindDeviceType(device.entry.typeID);
+                if (device.connection->IsValid() && type &&
+                    type->stageKind == StageKindMotor)
+                    numMotorChannels += channels.size();
             }
 
+            // Any two or more motor channels can be combined into an XY stage
+            // or a move group (the axes are chosen with pre-init properties)
+            if (numMotorChannels >= 2) {
+                AddInstalledDevice(new XYStage{ inventory_ });
+                AddInstalledDevice(new MoveGroup{ inventory_ });
+            }
+
+            if (!inventoryCacheFile_.empty())
+                inventory_->SaveToFile(inventoryCacheFile_);
+
             return DEVICE_OK;
         }
+
+    private:
+        // Build the Kinesis device list (required before opening devices)
+        // and make the inventory match it
+        void ValidateInventory() {
+            inventory_->Reconcile(EnumerateSerialNumbers());
+            if (!inventoryCacheFile_.empty())
+                inventory_->SaveToFile(inventoryCacheFile_);
+            inventory_->EndValidation();
+        }
+
+        // Load the Kinesis DLLs of the device types in the inventory (which
+        // may still be the cached one), so that neither DetectInstalledDevices()
+        // nor peripheral initialization waits for the loader
+        void StartPreload() {
+            if (mockEnabled_)
+                return;
+
+            std::vector<uint32_t> typeIDs;
+            for (auto const& entry : inventory_->Entries()) {
+                if (std::find(typeIDs.begin(), typeIDs.end(), entry.typeID) ==
+                    typeIDs.end())
+                    typeIDs.push_back(entry.typeID);
+            }
+
+            preloadThread_ = std::thread([typeIDs] {
+                PreloadFTDIDriver();
+                for (uint32_t typeID : typeIDs)
+                    PreloadKinesisDriver(typeID);
+            });
+        }
+
+        void StartHotPlugDetection() {
+            hotPlugStopRequested_ = false;
+            hotPlugThread_ = std::thread([this] { RunHotPlug(); });
+            deviceWatcher_ = std::make_unique<DeviceWatcher>(
+                [this](std::string const& serialNo, bool arrived) {
+                    HandleHotPlug(serialNo, arrived);
+                });
+            if (!deviceWatcher_->IsRunning())
+                LogMessage("Failed to register for USB device notifications; "
+                    "controllers plugged in later will not be detected");
+        }
+
+        void StopHotPlugDetection() {
+            deviceWatcher_.reset(); // No more calls to HandleHotPlug()
+            if (!hotPlugThread_.joinable())
+                return;
+            {
+                std::lock_guard<std::mutex> lock(hotPlugMutex_);
+                hotPlugStopRequested_ = true;
+            }
+            hotPlugCondition_.notify_one();
+            hotPlugThread_.join();
+        }
+
+        // Called on the watcher thread
+        void HandleHotPlug(std::string const& serialNo, bool arrived) {
+            std::lock_guard<std::mutex> lock(hotPlugMutex_);
+            arrivedSerialNos_.erase(std::remove(arrivedSerialNos_.begin(),
+                arrivedSerialNos_.end(), serialNo), arrivedSerialNos_.end());
+            if (arrived) {
+                arrivedSerialNos_.push_back(serialNo);
+                lastArrival_ = std::chrono::steady_clock::now();
+                hotPlugCondition_.notify_one();
+            }
+            else {
+                // Nothing to ask Kinesis; open connections fail on their own
+                inventory_->Remove(serialNo);
+                LogMessage("Device " + serialNo + " was disconnected");
+            }
+        }
+
+        void RunHotPlug() {
+            auto const quietPeriod = std::chrono::milliseconds(1000);
+            std::unique_lock<std::mutex> lock(hotPlugMutex_);
+            for (;;) {
+                hotPlugCondition_.wait(lock, [&] {
+                    return hotPlugStopRequested_ || !arrivedSerialNos_.empty();
+                });
+                while (!hotPlugStopRequested_ &&
+                    std::chrono::steady_clock::now() < lastArrival_ + quietPeriod)
+                    hotPlugCondition_.wait_until(lock, lastArrival_ + quietPeriod);
+                if (hotPlugStopRequested_)
+                    return;
+
+                std::vector<std::string> arrived;
+                arrived.swap(arrivedSerialNos_);
+                lock.unlock();
+                AddArrivedDevices(arrived);
+                lock.lock();
+            }
+        }
+
+        void AddArrivedDevices(std::vector<std::string> const& arrived) {
+            std::vector<std::string> added;
+            for (auto const& serialNo : arrived) {
+                DeviceInventoryEntry entry;
+                if (!inventory_->Find(serialNo, entry))
+                    added.push_back(serialNo);
+            }
+            if (added.empty()) // E.g. reconnected before we noticed removal
+                return;
+
+            // Kinesis can only open devices in its device list, and there is
+            // no way to add a single device to it. Rebuilding the list is
+            // the price of an arrival; the existing entries are left as they
+            // are, and devices are not opened until the list is rebuilt.
+            inventory_->WaitForValidation();
+            inventory_->BeginValidation();
+            std::vector<std::string> listed = EnumerateSerialNumbers();
+            for (auto const& serialNo : added) {
+                if (std::find(listed.begin(), listed.end(), serialNo) ==
+                    listed.end()) {
+                    LogMessage("Device " + serialNo + " was connected but is "
+                        "not (yet) known to Kinesis");
+                    continue;
+                }
+                DeviceInventoryEntry entry;
+                entry.serialNo = serialNo;
+                entry.typeID = TypeIDOfSerialNo(serialNo);
+                inventory_->Set(entry);
+                PreloadKinesisDriver(entry.typeID);
+                LogMessage("Device " + serialNo + " was connected");
+            }
+            inventory_->EndValidation();
+
+            if (!inventoryCacheFile_.empty())
+                inventory_->SaveToFile(inventoryCacheFile_);
+        }
+
+        // Open the connections of the peripherals in the configuration
+        // (which have all been created by now), so that their Initialize()
+        // only has to wait for its own connection
+        void StartWarmUp() {
+            std::vector<std::string> configured = ConfiguredSerialNumbers();
+            if (configured.empty())
+                return;
+
+            warmUpThread_ = std::thread([this, configured] {
+                inventory_->WaitForValidation();
+
+                // Skip devices that are not present; opening them would fail,
+                // possibly slowly
+                std::vector<std::string> serialNos;
+                for (auto const& serialNo : configured) {
+                    DeviceInventoryEntry entry;
+                    if (inventory_->Find(serialNo, entry))
+                        serialNos.push_back(serialNo);
+                }
+
+                std::vector<std::shared_ptr<KinesisDeviceConnection>>
+                    connections(serialNos.size());
+                ForEachConcurrently(serialNos.size(), [&](size_t i) {
+                    connections[i] = MakeConnection(serialNos[i]);
+                });
+
+                std::lock_guard<std::mutex> lock(warmUpMutex_);
+                warmConnections_ = std::move(connections);
+            });
+        }
+
+        void JoinBackgroundThreads() {
+            if (validationThread_.joinable())
+                validationThread_.join();
+            if (preloadThread_.joinable())
+                preloadThread_.join();
+            if (warmUpThread_.joinable())
+                warmUpThread_.join();
+        }
+
+        struct DiscoveredDevice {
+            std::shared_ptr<KinesisDeviceConnection> connection;
+            bool isPresent = false; // Only set when there is no connection
+            DeviceInventoryEntry entry;
+        };
+
+        // Called concurrently for different serial numbers
+        static DiscoveredDevice DiscoverDevice(std::string const& serialNo) {
+            DiscoveredDevice ret;
+            ret.entry.serialNo = serialNo;
+            ret.entry.typeID = TypeIDOfSerialNo(serialNo);
+
+            // We need to make a connection to the device in order to
+            // determine the number of channels, and also to get the model
+            // number.
+            ret.connection = MakeConnection(serialNo);
+            if (!ret.connection) {
+                ret.isPresent = KinesisDeviceInfo{ serialNo }.IsDevicePresent();
+                return ret;
+            }
+            if (!ret.connection->IsValid()) {
+                ret.entry.connectionError = ret.connection->ConnectionError();
+                return ret;
+            }
+
+            std::vector<short> channels;
+            if (IsPotentiallyMultiChannel(serialNo)) {
+                ret.entry.numChannels = ret.connection->GetNumChannels();
+                for (short ch = 1; ch <= ret.entry.numChannels; ++ch)
+                    channels.push_back(ch);
+            }
+            else {
+                channels.push_back(short(-1));
+            }
+
+            for (short ch : channels) {
+                KinesisDevice::HardwareInfo info;
+                std::unique_ptr<KinesisDevice> device =
+                    MakeKinesisMotorDrive(ret.connection, ch);
+                if (!device)
+                    device = MakeKinesisPiezoDrive(ret.connection);
+                if (device && device->GetHardwareInfo(info) == 0)
+                    ret.entry.hardwareInfo.push_back(info);
+                else
+                    ret.entry.hardwareInfo.push_back({}); // Unknown
+            }
+            return ret;
+        }
     };
 
     bool KinesisHub::lock_ = false;
@@ -177,6 +744,12 @@ MODULE_API MM::Device* CreateDevice(char const* name) {
     if (name == DEVICENAME_HUB)
         return new KinesisHub();
 
+    if (name == std::string{ DEVICENAME_XYSTAGE })
+        return new XYStage();
+
+    if (name == std::string{ DEVICENAME_MOVEGROUP })
+        return new MoveGroup();
+
     // Device names are ModelNo_SerialNo or ModelNo_SerialNo-Channel.
     // ModelNo may be Error[N] or Unsupported.
     std::istringstream nameStream{ name };
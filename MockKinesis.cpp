@@ -0,0 +1,606 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "MockKinesis.h"
+
+#include "DeviceEnumeration.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <random>
+#include <thread>
+
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double SecondsBetween(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double>(to - from).count();
+    }
+
+    // State of one motor axis, shared by all MockMotorDrive objects for the
+    // same serial number and channel
+    class MockAxis {
+        std::mutex mutex_;
+        double maxVelocity_;
+        double acceleration_;
+        double jogMaxVelocity_;
+        double jogAcceleration_;
+        bool enabled_ = false;
+        bool homed_ = false;
+        bool homing_ = false;
+
+        // Current move: from startPosition_ at startTime_ to targetPosition_
+        double startPosition_ = 0.0;
+        double targetPosition_ = 0.0;
+        Clock::time_point startTime_;
+        double duration_ = 0.0; // Seconds
+
+    public:
+        explicit MockAxis(MockTimingModel const& model) :
+            maxVelocity_{ model.maxVelocity },
+            acceleration_{ model.acceleration },
+            jogMaxVelocity_{ model.maxVelocity },
+            jogAcceleration_{ model.acceleration }
+        {}
+
+        struct State {
+            int position;
+            DWORD statusBits;
+            bool moving;
+        };
+
+        State GetState(Clock::time_point now) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            State state;
+            double t = SecondsBetween(startTime_, now);
+            state.moving = t < duration_;
+            if (!state.moving)
+                homing_ = false;
+            state.position = static_cast<int>(std::lround(PositionAt(t)));
+            state.statusBits = MotorDrive::StatusBitsMotorConnected;
+            if (enabled_)
+                state.statusBits |= MotorDrive::StatusBitsChannelEnabled;
+            if (homed_ && !homing_)
+                state.statusBits |= MotorDrive::StatusBitsHomed;
+            if (state.moving) {
+                if (homing_)
+                    state.statusBits |= MotorDrive::StatusBitsHoming;
+                else if (targetPosition_ > startPosition_)
+                    state.statusBits |= MotorDrive::StatusBitsMovingCW;
+                else
+                    state.statusBits |= MotorDrive::StatusBitsMovingCCW;
+            }
+            return state;
+        }
+
+        // A new move starts from rest at the current position (the real
+        // controllers blend moves, but this is close enough for timing)
+        void MoveTo(double target, bool homing = false) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto now = Clock::now();
+            startPosition_ = PositionAt(SecondsBetween(startTime_, now));
+            startTime_ = now;
+            targetPosition_ = target;
+            homing_ = homing;
+            if (homing)
+                homed_ = true;
+            duration_ = Duration(std::abs(target - startPosition_));
+        }
+
+        void SetEnabled(bool enabled) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            enabled_ = enabled;
+        }
+
+        void GetVelParams(bool jog, int& acceleration, int& maxVelocity) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            acceleration = static_cast<int>(jog ? jogAcceleration_ : acceleration_);
+            maxVelocity = static_cast<int>(jog ? jogMaxVelocity_ : maxVelocity_);
+        }
+
+        short SetVelParams(bool jog, int acceleration, int maxVelocity) {
+            if (acceleration <= 0 || maxVelocity <= 0)
+                return 39; // Invalid velocity parameter
+            std::lock_guard<std::mutex> lock(mutex_);
+            (jog ? jogAcceleration_ : acceleration_) = acceleration;
+            (jog ? jogMaxVelocity_ : maxVelocity_) = maxVelocity;
+            return 0;
+        }
+
+    private:
+        double Duration(double distance) const {
+            double const rampDistance = maxVelocity_ * maxVelocity_ / acceleration_;
+            if (distance < rampDistance)
+                return 2.0 * std::sqrt(distance / acceleration_);
+            return distance / maxVelocity_ + maxVelocity_ / acceleration_;
+        }
+
+        double PositionAt(double t) const {
+            if (t >= duration_)
+                return targetPosition_;
+            if (t <= 0.0)
+                return startPosition_;
+            double const distance = std::abs(targetPosition_ - startPosition_);
+            double const direction = targetPosition_ > startPosition_ ? 1.0 : -1.0;
+            double const peakVelocity = std::min(maxVelocity_,
+                std::sqrt(distance * acceleration_));
+            double const rampTime = peakVelocity / acceleration_;
+            double travelled;
+            if (t < rampTime)
+                travelled = 0.5 * acceleration_ * t * t;
+            else if (t < duration_ - rampTime)
+                travelled = 0.5 * peakVelocity * rampTime +
+                    peakVelocity * (t - rampTime);
+            else {
+                double const remaining = duration_ - t;
+                travelled = distance - 0.5 * acceleration_ * remaining * remaining;
+            }
+            return startPosition_ + direction * travelled;
+        }
+    };
+
+
+    // All mock state, guarded by mutex
+    struct MockRegistry {
+        std::mutex mutex;
+        std::atomic<bool> enabled{ false };
+        std::vector<std::string> serialNos;
+        MockTimingModel model;
+        std::map<std::pair<std::string, short>, std::shared_ptr<MockAxis>> axes;
+
+        static MockRegistry& Instance() {
+            static MockRegistry instance;
+            return instance;
+        }
+
+        MockTimingModel Model() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return model;
+        }
+
+        std::shared_ptr<MockAxis> Axis(std::string const& serialNo,
+            short channel) {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto& axis = axes[std::make_pair(serialNo, channel)];
+            if (!axis)
+                axis = std::make_shared<MockAxis>(model);
+            return axis;
+        }
+    };
+
+
+    void SleepCommandLatency() {
+        int us = MockRegistry::Instance().Model().commandLatencyUs;
+        if (us > 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(us));
+    }
+
+
+    std::string ModelNoOfType(uint32_t typeID) {
+        switch (typeID) {
+        case TypeIDBenchtopBrushless: return "BBD203";
+        case TypeIDBenchtopDCServo1Channel: return "BDC101";
+        case TypeIDBenchtopDCServo3Channel: return "BDC103";
+        case TypeIDBenchtopStepper1Channel: return "BSC201";
+        case TypeIDBenchtopStepper3Channel: return "BSC203";
+        case TypeIDCageRotator: return "K10CR1";
+        case TypeIDKCubeBrushless: return "KBD101";
+        case TypeIDKCubeDCServo: return "KDC101";
+        case TypeIDKCubeStepper: return "KST101";
+        case TypeIDLabJack050: return "MLJ050";
+        case TypeIDLabJack490: return "L490MZ";
+        case TypeIDLongTravelStage: return "LTS300";
+        case TypeIDTCubeBrushless: return "TBD001";
+        case TypeIDTCubeDCServo: return "TDC001";
+        case TypeIDTCubeStepper: return "TST101";
+        case TypeIDVerticalStage: return "MVS005";
+        default: return "MOCK";
+        }
+    }
+
+
+    WORD NumChannelsOfType(uint32_t typeID) {
+        DeviceType const* type = FindDeviceType(typeID);
+        return type ? type->numChannels : 1;
+    }
+
+
+    class MockAccess final : public KinesisDeviceAccess {
+    public:
+        explicit MockAccess(std::string const& serialNo) :
+            KinesisDeviceAccess{ serialNo }
+        {}
+
+    protected:
+        bool IsKinesisDriverAvailable() override { return true; }
+
+        short Kinesis_Open() override {
+            if (!IsMockDevice(SerialNo()))
+                return 2; // Device not found
+            int ms = MockRegistry::Instance().Model().openLatencyMs;
+            if (ms > 0)
+                std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            return 0;
+        }
+
+        short Kinesis_Close() override { return 0; }
+
+        short Kinesis_GetNumChannels() override {
+            if (!IsPotentiallyMultiChannel(SerialNo()))
+                return 0;
+            return NumChannelsOfType(TypeIDOfSerialNo(SerialNo()));
+        }
+    };
+
+
+    class MockMotorDrive final : public NonStepperMotorDrive {
+        std::shared_ptr<MockAxis> const axis_;
+
+        std::mutex mutex_;
+        MockAxis::State polled_{}; // As of the last poll or request
+        bool lastMessageTimerEnabled_ = false;
+        Clock::time_point lastMessageTime_;
+        std::deque<std::pair<WORD, WORD>> messages_;
+        void (*callback_)() = nullptr;
+        bool movePending_ = false; // Completion not yet posted
+        bool homingPending_ = false;
+
+        std::thread pollingThread_;
+        std::condition_variable stopPollingCondition_;
+        bool stopPolling_ = false;
+
+    public:
+        MockMotorDrive(std::shared_ptr<KinesisDeviceConnection> connection,
+            short channel, std::shared_ptr<MockAxis> axis) :
+            NonStepperMotorDrive{ connection, channel },
+            axis_{ axis }
+        {}
+
+        ~MockMotorDrive() override {
+            Kinesis_StopPolling();
+        }
+
+        MotionScale GetMotionScale() override { return { 1.0, 1.0 }; }
+
+    protected: // General
+        short Kinesis_RequestSettings() override {
+            SleepCommandLatency();
+            return 0;
+        }
+
+        short Kinesis_RequestStatusBits() override {
+            SleepCommandLatency();
+            Update();
+            return 0;
+        }
+
+        bool Kinesis_StartPolling(int intervalMs) override {
+            Kinesis_StopPolling();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopPolling_ = false;
+            }
+            MockTimingModel const model = MockRegistry::Instance().Model();
+            pollingThread_ = std::thread([this, intervalMs, model] {
+                std::minstd_rand random{ model.jitterSeed };
+                std::uniform_int_distribution<int> jitter{ 0,
+                    std::max(0, model.pollingJitterMs) };
+                std::unique_lock<std::mutex> lock(mutex_);
+                for (;;) {
+                    auto interval = std::chrono::milliseconds(
+                        intervalMs + jitter(random));
+                    if (stopPollingCondition_.wait_for(lock, interval,
+                        [this] { return stopPolling_; }))
+                        return;
+                    lock.unlock();
+                    Update();
+                    lock.lock();
+                }
+            });
+            return true;
+        }
+
+        void Kinesis_StopPolling() override {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopPolling_ = true;
+            }
+            stopPollingCondition_.notify_all();
+            if (pollingThread_.joinable())
+                pollingThread_.join();
+        }
+
+        short Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+            WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+            DWORD* firmwareVersion, WORD* hardwareVersion,
+            WORD* modificationState) override {
+            uint32_t const typeID = TypeIDOfSerialNo(SerialNo());
+            CopyString(ModelNoOfType(typeID), modelNo, sizeOfModelNo);
+            CopyString("Mock device", notes, sizeOfNotes);
+            *type = 16; // Motor
+            *numChannels = NumChannelsOfType(typeID);
+            *firmwareVersion = 0x00010000;
+            *hardwareVersion = 1;
+            *modificationState = 0;
+            return 0;
+        }
+
+        DWORD Kinesis_GetStatusBits() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return polled_.statusBits;
+        }
+
+        void Kinesis_EnableLastMsgTimer(bool enable, __int32) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            lastMessageTimerEnabled_ = enable;
+        }
+
+        bool Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!lastMessageTimerEnabled_)
+                return false;
+            lastUpdateTimeMS = std::chrono::duration_cast<
+                std::chrono::milliseconds>(Clock::now() - lastMessageTime_).count();
+            return true;
+        }
+
+        void Kinesis_RegisterMessageCallback(void (*callback)()) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            callback_ = callback;
+        }
+
+        int Kinesis_MessageQueueSize() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return static_cast<int>(messages_.size());
+        }
+
+        void Kinesis_ClearMessageQueue() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            messages_.clear();
+        }
+
+        bool Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+            DWORD* messageData) override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (messages_.empty())
+                return false;
+            *messageType = messages_.front().first;
+            *messageID = messages_.front().second;
+            *messageData = 0;
+            messages_.pop_front();
+            return true;
+        }
+
+    protected: // Motor
+        short Kinesis_EnableChannel() override {
+            SleepCommandLatency();
+            axis_->SetEnabled(true);
+            return 0;
+        }
+
+        short Kinesis_DisableChannel() override {
+            SleepCommandLatency();
+            axis_->SetEnabled(false);
+            return 0;
+        }
+
+        int Kinesis_GetMotorTravelMode() override { return 1; } // Linear
+        short Kinesis_SetMotorTravelMode(int) override { return 0; }
+        short Kinesis_ResetRotationModes() override { return 0; }
+        short Kinesis_SetRotationModes(int, int) override { return 0; }
+
+        short Kinesis_RequestPosition() override {
+            SleepCommandLatency();
+            Update();
+            return 0;
+        }
+
+        int Kinesis_GetPosition() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return polled_.position;
+        }
+
+        long Kinesis_GetPositionCounter() override {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return polled_.position;
+        }
+
+        long Kinesis_GetEncoderCounter() override {
+            return Kinesis_GetPositionCounter();
+        }
+
+        short Kinesis_MoveToPosition(int index) override {
+            SleepCommandLatency();
+            StartMove(index, false);
+            return 0;
+        }
+
+        short Kinesis_MoveRelative(int displacement) override {
+            SleepCommandLatency();
+            double const position = axis_->GetState(Clock::now()).position;
+            StartMove(position + displacement, false);
+            return 0;
+        }
+
+        short Kinesis_MoveAtVelocity(int direction) override {
+            SleepCommandLatency();
+            double const position = axis_->GetState(Clock::now()).position;
+            double const distance = 1e9; // Far enough to seem endless
+            StartMove(position + (direction == 2 ? -distance : distance),
+                false);
+            return 0;
+        }
+
+        short Kinesis_StopProfiled() override {
+            // Stops abruptly, unlike the real thing (see MockAxis::MoveTo())
+            SleepCommandLatency();
+            double const position = axis_->GetState(Clock::now()).position;
+            StartMove(position, false);
+            return 0;
+        }
+
+        bool Kinesis_CanHome() override { return true; }
+
+        short Kinesis_Home() override {
+            SleepCommandLatency();
+            StartMove(0.0, true);
+            return 0;
+        }
+
+        short Kinesis_GetVelParams(int* acceleration, int* maxVelocity) override {
+            axis_->GetVelParams(false, *acceleration, *maxVelocity);
+            return 0;
+        }
+
+        short Kinesis_SetVelParams(int acceleration, int maxVelocity) override {
+            SleepCommandLatency();
+            return axis_->SetVelParams(false, acceleration, maxVelocity);
+        }
+
+        short Kinesis_GetJogVelParams(int* acceleration, int* maxVelocity) override {
+            axis_->GetVelParams(true, *acceleration, *maxVelocity);
+            return 0;
+        }
+
+        short Kinesis_SetJogVelParams(int acceleration, int maxVelocity) override {
+            SleepCommandLatency();
+            return axis_->SetVelParams(true, acceleration, maxVelocity);
+        }
+
+        short Kinesis_GetRealValueFromDeviceUnit(int, double*, int) override {
+            return 46; // No motor parameters (same as the real devices)
+        }
+
+        short Kinesis_GetDeviceUnitFromRealValue(double, int*, int) override {
+            return 46;
+        }
+
+    private:
+        static void CopyString(std::string const& s, char* dest, DWORD size) {
+            if (size == 0)
+                return;
+            dest[s.copy(dest, size - 1)] = '\0';
+        }
+
+        void StartMove(double target, bool homing) {
+            axis_->MoveTo(target, homing);
+            std::lock_guard<std::mutex> lock(mutex_);
+            movePending_ = true;
+            homingPending_ = homing;
+        }
+
+        // Receive position and status from the device, as a poll or reply
+        // would; posts the completion message when a move has ended
+        void Update() {
+            MockAxis::State state = axis_->GetState(Clock::now());
+            void (*callback)() = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                bool const finished = movePending_ && !state.moving;
+                polled_ = state;
+                lastMessageTime_ = Clock::now();
+                if (finished) {
+                    messages_.emplace_back(MessageTypeGenericMotor,
+                        homingPending_ ? GenericMotorMessageHomed :
+                        GenericMotorMessageMoved);
+                    movePending_ = false;
+                    homingPending_ = false;
+                    callback = callback_;
+                }
+            }
+            if (callback)
+                callback();
+        }
+    };
+}
+
+
+void EnableMockKinesis(std::vector<std::string> const& serialNos,
+    MockTimingModel const& model) {
+    auto& registry = MockRegistry::Instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.serialNos = serialNos;
+    registry.model = model;
+    registry.axes.clear();
+    registry.enabled = true;
+}
+
+
+void DisableMockKinesis() {
+    auto& registry = MockRegistry::Instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.enabled = false;
+    registry.serialNos.clear();
+    registry.axes.clear();
+}
+
+
+bool IsMockKinesisEnabled() {
+    return MockRegistry::Instance().enabled;
+}
+
+
+bool IsMockDevice(std::string const& serialNo) {
+    auto& registry = MockRegistry::Instance();
+    if (!registry.enabled)
+        return false;
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return std::find(registry.serialNos.begin(), registry.serialNos.end(),
+        serialNo) != registry.serialNos.end();
+}
+
+
+std::vector<std::string> MockSerialNumbers() {
+    auto& registry = MockRegistry::Instance();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.serialNos;
+}
+
+
+std::unique_ptr<KinesisDeviceAccess> MakeMockAccess(
+    std::string const& serialNo) {
+    return std::make_unique<MockAccess>(serialNo);
+}
+
+
+std::unique_ptr<MotorDrive> MakeMockMotorDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel) {
+    auto axis = MockRegistry::Instance().Axis(connection->SerialNo(), channel);
+    return std::make_unique<MockMotorDrive>(connection, channel, axis);
+}
@@ -0,0 +1,72 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// In-process stand-in for the Kinesis motor APIs, for timing the adapter
+// without hardware (or the Kinesis Simulator). When enabled, enumeration
+// returns the mock serial numbers and connections to them are made with
+// MockAccess and MockMotorDrive instead of the real device families. Each
+// serial number's type ID (first two digits) determines the reported
+// model and number of channels, as for real devices.
+//
+// Motion follows a trapezoidal profile in real time; position and status are
+// only updated when polled, as with the real controllers.
+
+struct MockTimingModel {
+    int openLatencyMs = 200; // Connection open
+    int commandLatencyUs = 1000; // Each command sent to the device
+    double maxVelocity = 20000.0; // Device units per second
+    double acceleration = 200000.0; // Device units per second squared
+    int pollingJitterMs = 0; // Added (uniformly random) to each poll interval
+    unsigned jitterSeed = 1; // Fixed, so that runs are repeatable
+};
+
+// Replaces any previous set of mock devices
+void EnableMockKinesis(std::vector<std::string> const& serialNos,
+    MockTimingModel const& model = {});
+void DisableMockKinesis();
+bool IsMockKinesisEnabled();
+bool IsMockDevice(std::string const& serialNo);
+std::vector<std::string> MockSerialNumbers();
+
+std::unique_ptr<KinesisDeviceAccess> MakeMockAccess(
+    std::string const& serialNo);
+std::unique_ptr<MotorDrive> MakeMockMotorDrive(
+    std::shared_ptr<KinesisDeviceConnection> connection, short channel);
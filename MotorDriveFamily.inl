@@ -0,0 +1,514 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+// Implementation of a motor drive family (the XXXAccess and XXX classes
+// declared in XXX.h) on top of its Kinesis DLL. Each family's .cpp file
+// includes its Thorlabs header, defines the macros below, and then includes
+// this file. (This cannot be done with templates alone, because the function
+// names are only known by their prefix, and because only one Thorlabs header
+// can be included per compilation unit; see DeviceEnumeration.cpp.)
+//
+// Required:
+//   KINESIS_FAMILY          Class name of the motor drive (e.g. KCubeDCServo)
+//   KINESIS_FUNC(name)      Kinesis function name (e.g. CC_##name)
+//   KINESIS_DLL_TYPE_ID     A device type using the family's Kinesis DLL
+//                           (the DLL name is taken from DeviceTypes.h)
+// Optional (define to 1):
+//   KINESIS_MULTI_CHANNEL   Functions take a channel (benchtop controllers)
+//   KINESIS_SHORT_NUM_CHANNELS  GetHardwareInfo() takes short* numChannels
+//   KINESIS_HAS_ROTATION_MODES  Has ResetRotationModes/SetRotationModes
+//   KINESIS_HAS_ENCODER     Has GetEncoderCounter (NonStepperMotorDrive)
+//   KINESIS_HAS_TRIGGER_PORTS   Has trigger configuration (K-Cubes)
+//
+// All functions are resolved in one batch when the DLL is first loaded (by
+// IsKinesisDriverAvailable(), which KinesisDeviceAccess calls before opening
+// a device, or earlier by PreloadDriver()), so the wrappers are direct calls
+// through the table.
+
+#include "DeviceTypes.h"
+#include "DLLAccess.h"
+
+#include <atomic>
+
+
+#define KINESIS_CAT2(a, b) a##b
+#define KINESIS_CAT(a, b) KINESIS_CAT2(a, b)
+#define KINESIS_STR2(x) #x
+#define KINESIS_STR(x) KINESIS_STR2(x)
+
+#define KINESIS_ACCESS KINESIS_CAT(KINESIS_FAMILY, Access)
+
+#if KINESIS_MULTI_CHANNEL
+#   define KINESIS_CHANNEL , Channel()
+#else
+#   define KINESIS_CHANNEL
+#endif
+
+#define KINESIS_TABLE_ENTRY(name) \
+    DLLFunc<decltype(KINESIS_FUNC(name))> name{ \
+        kinesisDll, KINESIS_STR(KINESIS_FUNC(name)) };
+
+
+namespace {
+    DLLAccess kinesisDll{ FindDeviceType(KINESIS_DLL_TYPE_ID)->dllName };
+
+    struct FunctionTable {
+        KINESIS_TABLE_ENTRY(Open)
+        KINESIS_TABLE_ENTRY(Close)
+#if KINESIS_MULTI_CHANNEL
+        KINESIS_TABLE_ENTRY(GetNumChannels)
+#endif
+
+        KINESIS_TABLE_ENTRY(RequestSettings)
+        KINESIS_TABLE_ENTRY(RequestStatusBits)
+        KINESIS_TABLE_ENTRY(StartPolling)
+        KINESIS_TABLE_ENTRY(StopPolling)
+        KINESIS_TABLE_ENTRY(GetHardwareInfo)
+        KINESIS_TABLE_ENTRY(GetStatusBits)
+        KINESIS_TABLE_ENTRY(EnableLastMsgTimer)
+        KINESIS_TABLE_ENTRY(TimeSinceLastMsgReceived)
+        KINESIS_TABLE_ENTRY(RegisterMessageCallback)
+        KINESIS_TABLE_ENTRY(MessageQueueSize)
+        KINESIS_TABLE_ENTRY(ClearMessageQueue)
+        KINESIS_TABLE_ENTRY(GetNextMessage)
+
+        KINESIS_TABLE_ENTRY(EnableChannel)
+        KINESIS_TABLE_ENTRY(DisableChannel)
+        KINESIS_TABLE_ENTRY(GetMotorTravelMode)
+        KINESIS_TABLE_ENTRY(SetMotorTravelMode)
+#if KINESIS_HAS_ROTATION_MODES
+        KINESIS_TABLE_ENTRY(ResetRotationModes)
+        KINESIS_TABLE_ENTRY(SetRotationModes)
+#endif
+        KINESIS_TABLE_ENTRY(RequestPosition)
+        KINESIS_TABLE_ENTRY(GetPosition)
+        KINESIS_TABLE_ENTRY(GetPositionCounter)
+        KINESIS_TABLE_ENTRY(MoveToPosition)
+        KINESIS_TABLE_ENTRY(MoveRelative)
+        KINESIS_TABLE_ENTRY(MoveAtVelocity)
+        KINESIS_TABLE_ENTRY(StopProfiled)
+        KINESIS_TABLE_ENTRY(CanHome)
+        KINESIS_TABLE_ENTRY(Home)
+        KINESIS_TABLE_ENTRY(GetVelParams)
+        KINESIS_TABLE_ENTRY(SetVelParams)
+        KINESIS_TABLE_ENTRY(GetJogVelParams)
+        KINESIS_TABLE_ENTRY(SetJogVelParams)
+        KINESIS_TABLE_ENTRY(GetRealValueFromDeviceUnit)
+        KINESIS_TABLE_ENTRY(GetDeviceUnitFromRealValue)
+#if KINESIS_HAS_ENCODER
+        KINESIS_TABLE_ENTRY(GetEncoderCounter)
+#endif
+#if KINESIS_HAS_TRIGGER_PORTS
+        KINESIS_TABLE_ENTRY(GetTriggerConfigParams)
+        KINESIS_TABLE_ENTRY(SetTriggerConfigParams)
+        KINESIS_TABLE_ENTRY(SetMoveAbsolutePosition)
+        KINESIS_TABLE_ENTRY(SetMoveRelativeDistance)
+        KINESIS_TABLE_ENTRY(GetTriggerParamsParams)
+        KINESIS_TABLE_ENTRY(SetTriggerParamsParams)
+#endif
+    };
+
+    std::atomic<FunctionTable*> functionTable{ nullptr };
+
+    // Thread safe
+    bool ResolveFunctions() {
+        if (functionTable.load(std::memory_order_acquire))
+            return true;
+        if (!kinesisDll.IsValid())
+            return false;
+        static FunctionTable table; // Constructed once
+        functionTable.store(&table, std::memory_order_release);
+        return true;
+    }
+
+    // Only valid after ResolveFunctions() has succeeded
+    FunctionTable& Kinesis() {
+        return *functionTable.load(std::memory_order_acquire);
+    }
+}
+
+
+bool
+KINESIS_ACCESS::PreloadDriver() {
+    return ResolveFunctions();
+}
+
+
+bool
+KINESIS_ACCESS::IsKinesisDriverAvailable() {
+    return ResolveFunctions();
+}
+
+
+short
+KINESIS_ACCESS::Kinesis_Open() {
+    return Kinesis().Open(CSerialNo());
+}
+
+
+short
+KINESIS_ACCESS::Kinesis_Close() {
+    Kinesis().Close(CSerialNo());
+    return 0;
+}
+
+
+#if KINESIS_MULTI_CHANNEL
+short
+KINESIS_ACCESS::Kinesis_GetNumChannels() {
+    return Kinesis().GetNumChannels(CSerialNo());
+}
+#endif
+
+
+short
+KINESIS_FAMILY::Kinesis_RequestSettings() {
+    return Kinesis().RequestSettings(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_RequestStatusBits() {
+    return Kinesis().RequestStatusBits(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+bool
+KINESIS_FAMILY::Kinesis_StartPolling(int intervalMs) {
+    return Kinesis().StartPolling(CSerialNo() KINESIS_CHANNEL, intervalMs);
+}
+
+
+void
+KINESIS_FAMILY::Kinesis_StopPolling() {
+    Kinesis().StopPolling(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
+    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
+    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
+
+#if KINESIS_SHORT_NUM_CHANNELS
+    short shortNumChannels;
+
+    short ret = Kinesis().GetHardwareInfo(CSerialNo() KINESIS_CHANNEL,
+        modelNo, sizeOfModelNo, type, &shortNumChannels, notes, sizeOfNotes,
+        firmwareVersion, hardwareVersion, modificationState);
+
+    *numChannels = shortNumChannels;
+
+    return ret;
+#else
+    return Kinesis().GetHardwareInfo(CSerialNo() KINESIS_CHANNEL,
+        modelNo, sizeOfModelNo, type, numChannels, notes, sizeOfNotes,
+        firmwareVersion, hardwareVersion, modificationState);
+#endif
+}
+
+
+DWORD
+KINESIS_FAMILY::Kinesis_GetStatusBits() {
+    return Kinesis().GetStatusBits(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+void
+KINESIS_FAMILY::Kinesis_EnableLastMsgTimer(bool enable, __int32 lastMsgTimeout) {
+    Kinesis().EnableLastMsgTimer(CSerialNo() KINESIS_CHANNEL, enable,
+        lastMsgTimeout);
+}
+
+
+bool
+KINESIS_FAMILY::Kinesis_TimeSinceLastMsgReceived(__int64& lastUpdateTimeMS) {
+    return Kinesis().TimeSinceLastMsgReceived(CSerialNo() KINESIS_CHANNEL,
+        lastUpdateTimeMS);
+}
+
+
+void
+KINESIS_FAMILY::Kinesis_RegisterMessageCallback(void (*callback)()) {
+    Kinesis().RegisterMessageCallback(CSerialNo() KINESIS_CHANNEL, callback);
+}
+
+
+int
+KINESIS_FAMILY::Kinesis_MessageQueueSize() {
+    return Kinesis().MessageQueueSize(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+void
+KINESIS_FAMILY::Kinesis_ClearMessageQueue() {
+    Kinesis().ClearMessageQueue(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+bool
+KINESIS_FAMILY::Kinesis_GetNextMessage(WORD* messageType, WORD* messageID,
+    DWORD* messageData) {
+
+    return Kinesis().GetNextMessage(CSerialNo() KINESIS_CHANNEL,
+        messageType, messageID, messageData);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_EnableChannel() {
+    return Kinesis().EnableChannel(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_DisableChannel() {
+    return Kinesis().DisableChannel(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+int
+KINESIS_FAMILY::Kinesis_GetMotorTravelMode() {
+    return Kinesis().GetMotorTravelMode(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetMotorTravelMode(int mode) {
+    return Kinesis().SetMotorTravelMode(CSerialNo() KINESIS_CHANNEL,
+        static_cast<MOT_TravelModes>(mode));
+}
+
+
+#if KINESIS_HAS_ROTATION_MODES
+short
+KINESIS_FAMILY::Kinesis_ResetRotationModes() {
+    return Kinesis().ResetRotationModes(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetRotationModes(int mode, int direction) {
+    return Kinesis().SetRotationModes(CSerialNo() KINESIS_CHANNEL,
+        static_cast<MOT_MovementModes>(mode),
+        static_cast<MOT_MovementDirections>(direction));
+}
+#else
+short
+KINESIS_FAMILY::Kinesis_ResetRotationModes() {
+    return 18;
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetRotationModes(int, int) {
+    return 18;
+}
+#endif
+
+
+short
+KINESIS_FAMILY::Kinesis_RequestPosition() {
+    return Kinesis().RequestPosition(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+int
+KINESIS_FAMILY::Kinesis_GetPosition() {
+    return Kinesis().GetPosition(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+long
+KINESIS_FAMILY::Kinesis_GetPositionCounter() {
+    return Kinesis().GetPositionCounter(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_MoveToPosition(int index) {
+    return Kinesis().MoveToPosition(CSerialNo() KINESIS_CHANNEL, index);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_MoveRelative(int displacement) {
+    return Kinesis().MoveRelative(CSerialNo() KINESIS_CHANNEL, displacement);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_MoveAtVelocity(int direction) {
+    return Kinesis().MoveAtVelocity(CSerialNo() KINESIS_CHANNEL,
+        static_cast<MOT_TravelDirection>(direction));
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_StopProfiled() {
+    return Kinesis().StopProfiled(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+bool
+KINESIS_FAMILY::Kinesis_CanHome() {
+    return Kinesis().CanHome(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_Home() {
+    return Kinesis().Home(CSerialNo() KINESIS_CHANNEL);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_GetVelParams(int* acceleration, int* maxVelocity) {
+    return Kinesis().GetVelParams(CSerialNo() KINESIS_CHANNEL,
+        acceleration, maxVelocity);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetVelParams(int acceleration, int maxVelocity) {
+    return Kinesis().SetVelParams(CSerialNo() KINESIS_CHANNEL,
+        acceleration, maxVelocity);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_GetJogVelParams(int* acceleration, int* maxVelocity) {
+    return Kinesis().GetJogVelParams(CSerialNo() KINESIS_CHANNEL,
+        acceleration, maxVelocity);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetJogVelParams(int acceleration, int maxVelocity) {
+    return Kinesis().SetJogVelParams(CSerialNo() KINESIS_CHANNEL,
+        acceleration, maxVelocity);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
+    double* realValue, int unitType) {
+
+    return Kinesis().GetRealValueFromDeviceUnit(CSerialNo() KINESIS_CHANNEL,
+        deviceUnits, realValue, unitType);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_GetDeviceUnitFromRealValue(double realValue,
+    int* deviceUnits, int unitType) {
+
+    return Kinesis().GetDeviceUnitFromRealValue(CSerialNo() KINESIS_CHANNEL,
+        realValue, deviceUnits, unitType);
+}
+
+
+#if KINESIS_HAS_ENCODER
+long
+KINESIS_FAMILY::Kinesis_GetEncoderCounter() {
+    return Kinesis().GetEncoderCounter(CSerialNo() KINESIS_CHANNEL);
+}
+#endif
+
+
+#if KINESIS_HAS_TRIGGER_PORTS
+short
+KINESIS_FAMILY::Kinesis_GetTriggerConfigParams(int* mode1, int* polarity1,
+    int* mode2, int* polarity2) {
+
+    KMOT_TriggerPortMode kMode1, kMode2;
+    KMOT_TriggerPortPolarity kPolarity1, kPolarity2;
+
+    short ret = Kinesis().GetTriggerConfigParams(CSerialNo() KINESIS_CHANNEL,
+        &kMode1, &kPolarity1, &kMode2, &kPolarity2);
+
+    *mode1 = kMode1;
+    *polarity1 = kPolarity1;
+    *mode2 = kMode2;
+    *polarity2 = kPolarity2;
+
+    return ret;
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetTriggerConfigParams(int mode1, int polarity1,
+    int mode2, int polarity2) {
+
+    return Kinesis().SetTriggerConfigParams(CSerialNo() KINESIS_CHANNEL,
+        static_cast<KMOT_TriggerPortMode>(mode1),
+        static_cast<KMOT_TriggerPortPolarity>(polarity1),
+        static_cast<KMOT_TriggerPortMode>(mode2),
+        static_cast<KMOT_TriggerPortPolarity>(polarity2));
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetMoveAbsolutePosition(int position) {
+    return Kinesis().SetMoveAbsolutePosition(CSerialNo() KINESIS_CHANNEL,
+        position);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetMoveRelativeDistance(int distance) {
+    return Kinesis().SetMoveRelativeDistance(CSerialNo() KINESIS_CHANNEL,
+        distance);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_GetTriggerParamsParams(int* startPositionFwd,
+    int* intervalFwd, int* pulseCountFwd, int* startPositionRev,
+    int* intervalRev, int* pulseCountRev, int* pulseWidth, int* cycleCount) {
+
+    return Kinesis().GetTriggerParamsParams(CSerialNo() KINESIS_CHANNEL,
+        startPositionFwd, intervalFwd, pulseCountFwd, startPositionRev,
+        intervalRev, pulseCountRev, pulseWidth, cycleCount);
+}
+
+
+short
+KINESIS_FAMILY::Kinesis_SetTriggerParamsParams(int startPositionFwd,
+    int intervalFwd, int pulseCountFwd, int startPositionRev,
+    int intervalRev, int pulseCountRev, int pulseWidth, int cycleCount) {
+
+    return Kinesis().SetTriggerParamsParams(CSerialNo() KINESIS_CHANNEL,
+        startPositionFwd, intervalFwd, pulseCountFwd, startPositionRev,
+        intervalRev, pulseCountRev, pulseWidth, cycleCount);
+}
+#endif
@@ -0,0 +1,225 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "MotorDriveSetup.h"
+
+#include "Errors.h"
+
+#include "DeviceBase.h"
+
+#include <chrono>
+#include <cmath>
+
+
+namespace {
+    // Replies normally take a few ms, but some controllers are slower
+    int const INITIAL_REPLY_TIMEOUT_MS = 1000;
+    // Shorter, since the caller is waiting for a position
+    int const POSITION_REPLY_TIMEOUT_MS = 250;
+
+    // Wait for the first message after the request, which is its reply if
+    // polling has not started yet. (When polling, it may instead be a poll
+    // reply, which is equally fresh.)
+    //
+    // The Kinesis API has no way to tell which item a message updated, so
+    // this only guarantees that the channel sent something after the
+    // request. The last-message timer is per channel for every family we
+    // support (the benchtop BMC_, BDC_ and SBC_ functions take the channel),
+    // so a message for another channel of the same controller does not
+    // count. Before polling starts, a channel rarely sends anything
+    // unprompted other than move-completed messages, which carry the
+    // position and status bits as well.
+    template <typename Device>
+    int RequestAndAwaitReply(Device& device, short (Device::*request)(),
+        int timeoutMs = INITIAL_REPLY_TIMEOUT_MS,
+        int timeoutError = ERR_INITIAL_REPLY_TIMEOUT) {
+        auto const sent = std::chrono::steady_clock::now();
+        short err = (device.*request)();
+        if (err)
+            return ERR_OFFSET + err;
+
+        auto const deadline = sent + std::chrono::milliseconds(timeoutMs);
+        for (;;) {
+            long long msSinceLastMessage = device.MsSinceLastMessage();
+            auto now = std::chrono::steady_clock::now();
+            if (msSinceLastMessage < 0) {
+                // Timer not available; fall back to waiting a fixed time
+                CDeviceUtils::SleepMs(100);
+                return DEVICE_OK;
+            }
+
+            double msSinceSent =
+                std::chrono::duration<double, std::milli>(now - sent).count();
+            if (msSinceLastMessage < msSinceSent) {
+                // The timer has 1 ms resolution; make sure a subsequent
+                // request cannot mistake this reply for its own.
+                CDeviceUtils::SleepMs(2);
+                return DEVICE_OK;
+            }
+
+            if (now >= deadline)
+                return timeoutError;
+            CDeviceUtils::SleepMs(1);
+        }
+    }
+
+    template <typename Device>
+    int EnableIfDisabled(Device& device, bool& didEnable) {
+        if (device.IsChannelEnabled())
+            return DEVICE_OK;
+
+        // A call to XXX_EnableChannel was added to Thorlabs example code at
+        // some point, but only for some devices. If this causes errors, we
+        // may need to branch depending on device type. At least some devices
+        // always start up disabled, so enabling _is_ necessary for those.
+        short err = device.SetChannelEnabled(true);
+        if (err)
+            return ERR_OFFSET + err;
+        didEnable = true;
+        return DEVICE_OK;
+    }
+}
+
+
+int AwaitInitialState(MotorDrive& motorDrive) {
+    motorDrive.EnableLastMessageTimer(true);
+    int ret = RequestAndAwaitReply(motorDrive, &MotorDrive::RequestPosition);
+    if (ret == DEVICE_OK)
+        ret = RequestAndAwaitReply<KinesisDevice>(motorDrive,
+            &KinesisDevice::RequestStatusBits);
+    motorDrive.EnableLastMessageTimer(false);
+    return ret;
+}
+
+
+int AwaitInitialState(PiezoDrive& piezoDrive) {
+    piezoDrive.EnableLastMessageTimer(true);
+    int ret = RequestAndAwaitReply(piezoDrive, &PiezoDrive::RequestPosition);
+    if (ret == DEVICE_OK)
+        ret = RequestAndAwaitReply<KinesisDevice>(piezoDrive,
+            &KinesisDevice::RequestStatusBits);
+    piezoDrive.EnableLastMessageTimer(false);
+    return ret;
+}
+
+
+int RefreshPositionIfStale(MotorDrive& motorDrive, double maxAgeMs) {
+    // While polling, every message carries the position, so the time since
+    // the last one is the age of the position
+    long long const ageMs = motorDrive.MsSinceLastMessage();
+    if (ageMs >= 0 && ageMs <= maxAgeMs) {
+        // The driver's position is fresh, but our snapshot of it may be up
+        // to a polling interval older (which can exceed maxAgeMs)
+        motorDrive.InvalidateSnapshot();
+        return DEVICE_OK;
+    }
+
+    int ret = RequestAndAwaitReply(motorDrive, &MotorDrive::RequestPosition,
+        POSITION_REPLY_TIMEOUT_MS, ERR_POSITION_REPLY_TIMEOUT);
+    motorDrive.InvalidateSnapshot();
+    return ret;
+}
+
+
+int EnableChannelIfDisabled(MotorDrive& motorDrive, bool& didEnable) {
+    return EnableIfDisabled(motorDrive, didEnable);
+}
+
+
+int EnableChannelIfDisabled(PiezoDrive& piezoDrive, bool& didEnable) {
+    return EnableIfDisabled(piezoDrive, didEnable);
+}
+
+
+bool IsMotorDriveMoving(MotorDrive& motorDrive, double msSinceMovementStart,
+    double statusLagMs) {
+    // We are busy if the motor is moving, which we get from the status bits.
+    // However, the status bits are only updated every polling interval, so
+    // they do not immediately indicate movement after we kick off a move. So
+    // we need to unconditionally report "busy" for one polling interval after
+    // starting a movement.
+    //
+    // With motion events, the controller tells us when a commanded move has
+    // finished, so we do not need to wait for the status bits to catch up at
+    // either end of the move. The status bits are still used to detect motion
+    // we did not command (e.g. the jog knob), and as a fallback in case a
+    // completion message never arrives.
+
+    if (motorDrive.MotionEventsEnabled()) {
+        if (!motorDrive.IsMotionPending()) {
+            // Status bits may still show the move that just finished
+            if (motorDrive.MsSinceMotionCompleted() <= statusLagMs)
+                return false;
+            return motorDrive.Snapshot().statusBits &
+                MotorDrive::StatusBitsInMotion;
+        }
+    }
+
+    if (msSinceMovementStart <= statusLagMs)
+        return true;
+
+    DWORD status = motorDrive.Snapshot().statusBits;
+    bool moving = status & MotorDrive::StatusBitsInMotion;
+    if (!moving)
+        motorDrive.ClearMotionPending(); // Completion message was missed
+    return moving;
+}
+
+
+int GetMoveProfile(MotorDrive& motorDrive, double& maxVelocity,
+    double& acceleration) {
+    int accel, maxVel;
+    short err = motorDrive.GetVelocityParams(accel, maxVel);
+    if (err)
+        return ERR_OFFSET + err;
+    MotionScale const scale = motorDrive.GetMotionScale();
+    maxVelocity = maxVel / scale.velocity;
+    acceleration = accel / scale.acceleration;
+    return DEVICE_OK;
+}
+
+
+double EstimateMoveTimeMs(double distance, double maxVelocity,
+    double acceleration) {
+    if (!(maxVelocity > 0.0) || !(acceleration > 0.0))
+        return 0.0;
+    distance = std::abs(distance);
+
+    // Short moves never reach max velocity (triangular profile)
+    double const rampDistance = maxVelocity * maxVelocity / acceleration;
+    double seconds;
+    if (distance < rampDistance)
+        seconds = 2.0 * std::sqrt(distance / acceleration);
+    else
+        seconds = distance / maxVelocity + maxVelocity / acceleration;
+    return 1000.0 * seconds;
+}
@@ -0,0 +1,70 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+
+// Steps shared by the stage devices for bringing up and monitoring a motor
+// (or piezo) drive. Functions returning int return Micro-Manager error codes.
+
+// Request position and status bits, and wait for the replies, so that they
+// are up to date before polling starts. Must be called before StartPolling().
+int AwaitInitialState(MotorDrive& motorDrive);
+int AwaitInitialState(PiezoDrive& piezoDrive);
+
+// Request the position, and wait for the reply, if the last one received is
+// older than maxAgeMs; either way, the next Snapshot() reads the device (so
+// its position is no older than maxAgeMs). Requires the last-message timer
+// to be enabled, and is only worthwhile while polling.
+int RefreshPositionIfStale(MotorDrive& motorDrive, double maxAgeMs);
+
+// Enable the channel if it is disabled; didEnable is set if we enabled it
+int EnableChannelIfDisabled(MotorDrive& motorDrive, bool& didEnable);
+int EnableChannelIfDisabled(PiezoDrive& piezoDrive, bool& didEnable);
+
+// Whether the motor is moving, given the time since we last started a move or
+// home (msSinceMovementStart) and how stale the status bits may be
+// (statusLagMs; the polling interval plus some margin).
+bool IsMotorDriveMoving(MotorDrive& motorDrive, double msSinceMovementStart,
+    double statusLagMs);
+
+// Read the move profile (max velocity and acceleration) from the controller,
+// converted to position device units per second (and per second squared)
+int GetMoveProfile(MotorDrive& motorDrive, double& maxVelocity,
+    double& acceleration);
+
+// Duration of a move over distance (in position device units) with a
+// trapezoidal velocity profile; zero if the profile is unknown
+double EstimateMoveTimeMs(double distance, double maxVelocity,
+    double acceleration);
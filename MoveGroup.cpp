@@ -0,0 +1,427 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "MoveGroup.h"
+
+#include "Clamp.h"
+#include "Connections.h"
+#include "DeviceEnumeration.h"
+#include "DeviceInstantiation.h"
+#include "Errors.h"
+#include "MotorDriveSetup.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <limits>
+#include <utility>
+
+
+namespace {
+    char const* const PROP_Targets = "Targets";
+    char const* const PROP_Positions = "Positions";
+    char const* const PROP_PollingIntervalMs = "PollingIntervalMs";
+
+    std::string AxisPropertyName(int number, char const* suffix) {
+        return "Axis" + std::to_string(number) + suffix;
+    }
+
+    int StepsFromUm(double um, double deviceUnitsPerUm) {
+        return clamp_int(std::round(um * deviceUnitsPerUm));
+    }
+
+    // Comma-separated positions; an empty entry (NaN) leaves that axis where
+    // it is
+    bool ParseTargets(std::string const& text, std::vector<double>& targets) {
+        targets.clear();
+        char const* p = text.c_str();
+        for (;;) {
+            while (*p == ' ')
+                ++p;
+            if (*p == ',' || *p == '\0') {
+                targets.push_back(std::numeric_limits<double>::quiet_NaN());
+            }
+            else {
+                char* end;
+                targets.push_back(std::strtod(p, &end));
+                if (end == p)
+                    return false;
+                p = end;
+                while (*p == ' ')
+                    ++p;
+                if (*p != ',' && *p != '\0')
+                    return false;
+            }
+            if (*p == '\0')
+                return true;
+            ++p;
+        }
+    }
+}
+
+
+MoveGroup::MoveGroup(std::shared_ptr<DeviceInventory> inventory) :
+    inventory_{ inventory }
+{
+    for (auto const& item : KinesisErrorCodes()) {
+        SetErrorText(ERR_OFFSET + item.first, item.second.c_str());
+    }
+    for (auto const& item : AdapterErrorTexts()) {
+        SetErrorText(item.first, item.second.c_str());
+    }
+
+    // Axes whose serial number is left empty are not used. As with the XY
+    // stage, the channel is ignored for devices that are not multi-channel.
+    for (int i = 0; i < MAX_AXES; ++i) {
+        int number = i + 1;
+        CreateStringProperty(AxisPropertyName(number, "SerialNo").c_str(), "",
+            false, new CPropertyActionEx(this, &MoveGroup::OnSerialNo, i),
+            true);
+        std::string channelProp = AxisPropertyName(number, "Channel");
+        CreateIntegerProperty(channelProp.c_str(), 1, false, nullptr, true);
+        SetPropertyLimits(channelProp.c_str(), 1, 3);
+        CreateFloatProperty(
+            AxisPropertyName(number, "DeviceUnitsPerMillimeter").c_str(),
+            1000.0, false, nullptr, true);
+    }
+
+    CreateIntegerProperty(PROP_PollingIntervalMs, pollingIntervalMs_,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_PollingIntervalMs, 1, 1000);
+}
+
+
+MoveGroup::~MoveGroup() {
+    for (auto& axis : axes_) {
+        if (!axis.serialNo.empty())
+            UnregisterConfiguredDevice(axis.serialNo);
+    }
+}
+
+
+int
+MoveGroup::Initialize() {
+    if (initialized_)
+        return DEVICE_OK;
+
+    activeAxes_.clear();
+    for (int i = 0; i < MAX_AXES; ++i) {
+        Axis& axis = axes_[i];
+        if (axis.serialNo.empty())
+            continue;
+
+        long channel;
+        GetProperty(AxisPropertyName(i + 1, "Channel").c_str(), channel);
+        axis.channel = IsPotentiallyMultiChannel(axis.serialNo) ?
+            short(channel) : short(-1);
+        for (Axis* other : activeAxes_) {
+            if (other->serialNo == axis.serialNo &&
+                other->channel == axis.channel)
+                return ERR_MOVE_GROUP_AXIS_INVALID;
+        }
+
+        double deviceUnitsPerMm;
+        GetProperty(AxisPropertyName(i + 1, "DeviceUnitsPerMillimeter").c_str(),
+            deviceUnitsPerMm);
+        axis.deviceUnitsPerUm = deviceUnitsPerMm / 1000.0;
+        activeAxes_.push_back(&axis);
+    }
+    if (activeAxes_.empty())
+        return ERR_MOVE_GROUP_AXIS_INVALID;
+
+    long intervalMs;
+    GetProperty(PROP_PollingIntervalMs, intervalMs);
+    pollingIntervalMs_ = static_cast<int>(intervalMs);
+
+    // Kinesis devices can only be opened after the Hub has built the device
+    // list, which it may be doing in the background
+    if (!inventory_) {
+        auto provider = dynamic_cast<DeviceInventoryProvider*>(GetParentHub());
+        if (provider)
+            inventory_ = provider->GetDeviceInventory();
+    }
+    if (inventory_)
+        inventory_->WaitForValidation();
+
+    for (int i = 0; i < MAX_AXES; ++i) {
+        if (axes_[i].serialNo.empty())
+            continue;
+        int ret = InitializeAxis(axes_[i], i + 1);
+        if (ret != DEVICE_OK)
+            return ret;
+    }
+    GroupByController();
+
+    int ret = CreateStringProperty(PROP_Targets, "", false,
+        new CPropertyAction(this, &MoveGroup::OnTargets), false);
+    if (ret != DEVICE_OK)
+        return ret;
+    ret = CreateStringProperty(PROP_Positions, "", true,
+        new CPropertyAction(this, &MoveGroup::OnPositions), false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    initialized_ = true;
+    return DEVICE_OK;
+}
+
+
+int
+MoveGroup::InitializeAxis(Axis& axis, int number) {
+    if (!IsValidSerialNo(axis.serialNo))
+        return ERR_MOVE_GROUP_AXIS_INVALID;
+
+    // Channels of one benchtop controller share the connection (and so the
+    // command queue)
+    auto connection = MakeConnection(axis.serialNo);
+    if (!connection)
+        return ERR_MOVE_GROUP_AXIS_INVALID;
+    if (!connection->IsValid())
+        return ERR_OFFSET + connection->ConnectionError();
+    auto motorDrive = MakeKinesisMotorDrive(connection, axis.channel);
+    if (!motorDrive)
+        return ERR_MOVE_GROUP_AXIS_INVALID;
+    if (!connection->ClaimChannel(motorDrive->Channel()))
+        return ERR_CHANNEL_IN_USE;
+    axis.motorDrive = std::move(motorDrive);
+
+    int ret = AwaitInitialState(*axis.motorDrive);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    bool ok = axis.motorDrive->StartPolling(pollingIntervalMs_);
+    if (!ok) {
+        LogMessage("Failed to start polling for axis " +
+            std::to_string(number) + " (serial no " + axis.serialNo + ")");
+    }
+
+    axis.motorDrive->StartMotionEvents();
+
+    return EnableChannelIfDisabled(*axis.motorDrive, axis.didEnable);
+}
+
+
+void
+MoveGroup::GroupByController() {
+    controllerGroups_.clear();
+    for (Axis* axis : activeAxes_) {
+        auto connection = axis->motorDrive->GetConnection();
+        auto it = std::find_if(controllerGroups_.begin(),
+            controllerGroups_.end(), [&](std::vector<Axis*> const& group) {
+                return group.front()->motorDrive->GetConnection() == connection;
+            });
+        if (it == controllerGroups_.end())
+            controllerGroups_.push_back({ axis });
+        else
+            it->push_back(axis);
+    }
+}
+
+
+int
+MoveGroup::Shutdown() {
+    controllerGroups_.clear();
+    activeAxes_.clear();
+    for (auto& axis : axes_)
+        ShutdownAxis(axis);
+    initialized_ = false;
+    return DEVICE_OK;
+}
+
+
+void
+MoveGroup::ShutdownAxis(Axis& axis) {
+    if (!axis.motorDrive)
+        return;
+
+    if (axis.didEnable)
+        axis.motorDrive->SetChannelEnabled(false);
+    axis.didEnable = false;
+
+    axis.motorDrive->StopMotionEvents();
+    axis.motorDrive->StopPolling();
+    axis.motorDrive->GetConnection()->ReleaseChannel(
+        axis.motorDrive->Channel());
+    axis.motorDrive.reset();
+}
+
+
+void
+MoveGroup::GetName(char* name) const {
+    CDeviceUtils::CopyLimitedString(name, DEVICENAME_MOVEGROUP);
+}
+
+
+bool
+MoveGroup::Busy() {
+    // As in XYStage, allow for jitter in the polling
+    double const statusLagMs = pollingIntervalMs_ + 10.0;
+
+    auto msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    for (Axis* axis : activeAxes_) {
+        if (IsMotorDriveMoving(*axis->motorDrive, msSinceMovementStart,
+            statusLagMs))
+            return true;
+    }
+    return false;
+}
+
+
+int
+MoveGroup::MoveTo(std::vector<double> const& positionsUm) {
+    if (positionsUm.size() != activeAxes_.size())
+        return ERR_MOVE_GROUP_TARGETS_INVALID;
+
+    // Build all commands first, so that the burst is not interleaved with
+    // unit conversion
+    std::vector<std::vector<CommandQueue::Command>> batches;
+    batches.reserve(controllerGroups_.size());
+    for (auto const& group : controllerGroups_) {
+        std::vector<CommandQueue::Command> batch;
+        for (Axis* axis : group) {
+            size_t index = std::find(activeAxes_.begin(), activeAxes_.end(),
+                axis) - activeAxes_.begin();
+            double um = positionsUm[index];
+            if (std::isnan(um))
+                continue;
+            int steps = StepsFromUm(um, axis->deviceUnitsPerUm);
+            MotorDrive* motorDrive = axis->motorDrive.get();
+            batch.push_back([motorDrive, steps] {
+                return motorDrive->MoveToPosition(steps);
+            });
+        }
+        batches.push_back(std::move(batch));
+    }
+
+    // The moves of one controller go out as a single batch; the controllers
+    // are independent, so they are simply sent one after the other
+    short firstErr = 0;
+    bool started = false;
+    for (size_t g = 0; g < batches.size(); ++g) {
+        if (batches[g].empty())
+            continue;
+        auto& queue = controllerGroups_[g].front()->motorDrive->Commands();
+        for (short err : queue.ExecuteBatch(batches[g])) {
+            if (err && !firstErr)
+                firstErr = err;
+            if (!err)
+                started = true;
+        }
+    }
+    if (started)
+        lastMovementStart_ = GetCurrentMMTime();
+    if (firstErr)
+        return ERR_OFFSET + firstErr;
+    return DEVICE_OK;
+}
+
+
+int
+MoveGroup::GetPositions(std::vector<double>& positionsUm) {
+    positionsUm.clear();
+    for (Axis* axis : activeAxes_) {
+        positionsUm.push_back(axis->motorDrive->Snapshot().position /
+            axis->deviceUnitsPerUm);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+MoveGroup::OnSerialNo(MM::PropertyBase* pProp, MM::ActionType eAct,
+    long index) {
+    Axis& axis = axes_[index];
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(axis.serialNo.c_str());
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string serialNo;
+        pProp->Get(serialNo);
+        if (serialNo == axis.serialNo)
+            return DEVICE_OK;
+
+        // Let the Hub open the connection ahead of Initialize()
+        if (!axis.serialNo.empty())
+            UnregisterConfiguredDevice(axis.serialNo);
+        axis.serialNo = serialNo;
+        if (!axis.serialNo.empty())
+            RegisterConfiguredDevice(axis.serialNo);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+MoveGroup::OnTargets(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(targets_.c_str());
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string text;
+        pProp->Get(text);
+        std::vector<double> targets;
+        if (!ParseTargets(text, targets)) {
+            pProp->Set(targets_.c_str());
+            return ERR_MOVE_GROUP_TARGETS_INVALID;
+        }
+        int ret = MoveTo(targets);
+        if (ret != DEVICE_OK) {
+            pProp->Set(targets_.c_str());
+            return ret;
+        }
+        targets_ = text;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+MoveGroup::OnPositions(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        std::vector<double> positions;
+        int ret = GetPositions(positions);
+        if (ret != DEVICE_OK)
+            return ret;
+        std::string text;
+        for (double um : positions) {
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%.3f", um);
+            if (!text.empty())
+                text += ",";
+            text += buf;
+        }
+        pProp->Set(text.c_str());
+    }
+    return DEVICE_OK;
+}
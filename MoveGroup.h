@@ -0,0 +1,101 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceInventory.h"
+#include "KinesisDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+char const* const DEVICENAME_MOVEGROUP = "KinesisMoveGroup";
+
+
+// Several unrelated motor drives (e.g. objective Z, filter slider, rotator)
+// moved together. The drives are chosen with pre-init properties; setting
+// Targets starts all moves in one burst, with the moves for each controller
+// sent as one batch. Busy until the slowest axis has finished.
+class MoveGroup final : public CGenericBase<MoveGroup> {
+public:
+    static int const MAX_AXES = 5;
+
+private:
+    struct Axis {
+        std::string serialNo;
+        short channel{ -1 }; // -1 if not multi-channel
+        double deviceUnitsPerUm{ 1.0 };
+        std::unique_ptr<MotorDrive> motorDrive;
+        bool didEnable{ false };
+    };
+    Axis axes_[MAX_AXES];
+
+    // Set during Initialize(): the configured axes, grouped by controller
+    // connection (each group shares a command queue)
+    std::vector<std::vector<Axis*>> controllerGroups_;
+    std::vector<Axis*> activeAxes_; // In property order
+
+    std::shared_ptr<DeviceInventory> inventory_;
+    int pollingIntervalMs_{ 50 };
+    std::string targets_;
+    MM::MMTime lastMovementStart_{ 0.0 };
+    bool initialized_{ false };
+
+public:
+    explicit MoveGroup(std::shared_ptr<DeviceInventory> inventory = {});
+    ~MoveGroup() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    void GetName(char* name) const override;
+    bool Busy() override;
+
+    // Positions are in um (degrees for rotational stages), one per active
+    // axis in axis order
+    int MoveTo(std::vector<double> const& positionsUm);
+    int GetPositions(std::vector<double>& positionsUm);
+
+    // Action interface
+    int OnSerialNo(MM::PropertyBase* pProp, MM::ActionType eAct, long axis);
+    int OnTargets(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnPositions(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    int InitializeAxis(Axis& axis, int number);
+    void ShutdownAxis(Axis& axis);
+    void GroupByController();
+};
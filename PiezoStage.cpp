@@ -0,0 +1,594 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#define NOMINMAX
+
+#include "PiezoStage.h"
+
+#include "Connections.h"
+#include "DeviceInstantiation.h"
+#include "Errors.h"
+#include "MotorDriveSetup.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+
+namespace {
+    char const* const PROP_PollingIntervalMs = "PollingIntervalMs";
+    char const* const PROP_ControlMode = "ControlMode";
+    char const* const PROPVAL_ClosedLoop = "Closed loop";
+    char const* const PROPVAL_OpenLoop = "Open loop";
+    char const* const PROP_OpenLoopTravelUm = "OpenLoopTravelUm";
+    char const* const PROP_TravelUm = "TravelUm";
+    char const* const PROP_OutputVoltage = "OutputVoltage";
+    char const* const PROP_InputSource = "InputSource";
+    char const* const PROP_SettleTimeMs = "SettleTimeMs";
+    char const* const PROP_WaveformSequencing = "WaveformSequencing";
+    char const* const PROPVAL_No = "No";
+    char const* const PROPVAL_Yes = "Yes";
+    char const* const PROP_SequenceStepIntervalMs = "SequenceStepIntervalMs";
+    char const* const PROP_SequenceTrigger = "SequenceTrigger";
+    char const* const PROPVAL_Software = "Software";
+    char const* const PROPVAL_ExternalInput = "External input";
+
+    struct InputSourceName {
+        PiezoDrive::VoltageSource source;
+        char const* name;
+    };
+    InputSourceName const INPUT_SOURCE_NAMES[] = {
+        { PiezoDrive::VoltageSourceSoftwareOnly, "Software" },
+        { PiezoDrive::VoltageSourceExternalSignal, "External signal" },
+        { PiezoDrive::VoltageSourcePotentiometer, "Potentiometer" },
+        { PiezoDrive::VoltageSourceAll, "All" },
+    };
+}
+
+
+PiezoStage::PiezoStage(std::string const& name, std::string const& serialNo,
+    std::shared_ptr<KinesisDeviceConnection> connection,
+    std::shared_ptr<DeviceInventory> inventory) :
+    serialNo_{ serialNo },
+    givenName_{ name },
+    retainedConnection_{ connection },
+    inventory_{ inventory }
+{
+    if (!givenName_.empty())
+        RegisterConfiguredDevice(serialNo_);
+
+    for (auto const& item : KinesisErrorCodes()) {
+        SetErrorText(ERR_OFFSET + item.first, item.second.c_str());
+    }
+    for (auto const& item : AdapterErrorTexts()) {
+        SetErrorText(item.first, item.second.c_str());
+    }
+
+    CreateIntegerProperty(PROP_PollingIntervalMs, pollingIntervalMs_,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_PollingIntervalMs, 1, 1000);
+
+    // Closed loop needs a strain gauge reader on the actuator, and then the
+    // travel is read from the controller. In open loop the voltage is set
+    // directly, and the user must tell us the travel at maximum voltage.
+    CreateStringProperty(PROP_ControlMode, PROPVAL_ClosedLoop,
+        false, nullptr, true);
+    AddAllowedValue(PROP_ControlMode, PROPVAL_ClosedLoop);
+    AddAllowedValue(PROP_ControlMode, PROPVAL_OpenLoop);
+    CreateFloatProperty(PROP_OpenLoopTravelUm, travelUm_,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_OpenLoopTravelUm, 0.1, 10000.0);
+}
+
+
+PiezoStage::~PiezoStage() {
+    if (!givenName_.empty())
+        UnregisterConfiguredDevice(serialNo_);
+}
+
+
+int
+PiezoStage::Initialize() {
+    if (initialized_)
+        return DEVICE_OK;
+
+    // Kinesis devices can only be opened after the Hub has built the device
+    // list, which it may be doing in the background
+    if (!inventory_) {
+        auto provider = dynamic_cast<DeviceInventoryProvider*>(GetParentHub());
+        if (provider)
+            inventory_ = provider->GetDeviceInventory();
+    }
+    if (inventory_)
+        inventory_->WaitForValidation();
+
+    auto piezoDrive = Connect();
+    if (!piezoDrive) // Shouldn't happen
+        return DEVICE_ERR;
+    if (!piezoDrive->GetConnection()->IsValid()) {
+        return ERR_OFFSET + piezoDrive->GetConnection()->ConnectionError();
+    }
+    piezoDrive_ = std::move(piezoDrive);
+
+    if (inventory_) {
+        KinesisDevice::HardwareInfo info;
+        if (piezoDrive_->GetHardwareInfo(info) == 0)
+            inventory_->SetChannelHardwareInfo(serialNo_, -1, info);
+    }
+
+    long intervalMs;
+    GetProperty(PROP_PollingIntervalMs, intervalMs);
+    pollingIntervalMs_ = static_cast<int>(intervalMs);
+    char controlMode[MM::MaxStrLength];
+    GetProperty(PROP_ControlMode, controlMode);
+    closedLoop_ = controlMode == std::string{ PROPVAL_ClosedLoop };
+
+    int ret = AwaitInitialState(*piezoDrive_);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    bool ok = piezoDrive_->StartPolling(pollingIntervalMs_);
+    if (!ok) {
+        LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
+    }
+
+    ret = EnableChannelIfDisabled(*piezoDrive_, didEnable_);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    if (closedLoop_) {
+        WORD maxTravel = piezoDrive_->GetMaxTravel(); // 100 nm units
+        if (maxTravel == 0)
+            return ERR_PIEZO_NO_STRAIN_GAUGE;
+        travelUm_ = maxTravel * 0.1;
+    }
+    else {
+        GetProperty(PROP_OpenLoopTravelUm, travelUm_);
+    }
+    short err = piezoDrive_->SetControlMode(closedLoop_ ?
+        PiezoDrive::ControlModeClosedLoop : PiezoDrive::ControlModeOpenLoop);
+    if (err)
+        return ERR_OFFSET + err;
+
+    short maxVoltage = piezoDrive_->GetMaxOutputVoltage(); // 0.1 V units
+    if (maxVoltage > 0)
+        maxVoltage_ = maxVoltage * 0.1;
+
+    ret = CreateFloatProperty(PROP_TravelUm, travelUm_, true, nullptr, false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    CPropertyAction* pAct = new CPropertyAction(this, &PiezoStage::OnOutputVoltage);
+    ret = CreateFloatProperty(PROP_OutputVoltage, 0.0, true, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    // Selecting the external signal (or potentiometer) adds it to the
+    // software-set output, e.g. for analog focus control from a DAQ
+    pAct = new CPropertyAction(this, &PiezoStage::OnInputSource);
+    ret = CreateStringProperty(PROP_InputSource, INPUT_SOURCE_NAMES[0].name,
+        false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    for (auto const& item : INPUT_SOURCE_NAMES)
+        AddAllowedValue(PROP_InputSource, item.name);
+
+    // The controller does not report when the actuator has settled, so
+    // Busy() can optionally wait a fixed time after each move
+    pAct = new CPropertyAction(this, &PiezoStage::OnSettleTime);
+    ret = CreateFloatProperty(PROP_SettleTimeMs, settleTimeMs_, false, pAct,
+        false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_SettleTimeMs, 0.0, 1000.0);
+
+    // Off by default, because MMCore then expects each camera frame to
+    // advance the stage by one position, whereas the controller plays the
+    // table on its own clock
+    pAct = new CPropertyAction(this, &PiezoStage::OnWaveformSequencing);
+    ret = CreateStringProperty(PROP_WaveformSequencing, PROPVAL_No, false,
+        pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_WaveformSequencing, PROPVAL_No);
+    AddAllowedValue(PROP_WaveformSequencing, PROPVAL_Yes);
+
+    pAct = new CPropertyAction(this, &PiezoStage::OnSequenceStepInterval);
+    ret = CreateIntegerProperty(PROP_SequenceStepIntervalMs,
+        sequenceStepIntervalMs_, false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_SequenceStepIntervalMs, 1, 10000);
+
+    // With an external trigger, the sequence starts on the trigger input
+    // instead of immediately
+    pAct = new CPropertyAction(this, &PiezoStage::OnSequenceTrigger);
+    ret = CreateStringProperty(PROP_SequenceTrigger, PROPVAL_Software,
+        false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_SequenceTrigger, PROPVAL_Software);
+    AddAllowedValue(PROP_SequenceTrigger, PROPVAL_ExternalInput);
+
+    initialized_ = true;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::Shutdown() {
+    if (piezoDrive_) {
+        StopStageSequence();
+        if (didEnable_)
+            piezoDrive_->SetChannelEnabled(false);
+        piezoDrive_->StopPolling();
+    }
+
+    piezoDrive_.reset();
+    initialized_ = false;
+
+    return DEVICE_OK;
+}
+
+
+void
+PiezoStage::GetName(char* name) const {
+    // Name format is ModelNo_SerialNo (see SingleAxisStage::GetName())
+    std::string n;
+    if (!givenName_.empty()) {
+        n = givenName_;
+    }
+    else {
+        n = MakeNameFromInventory();
+        if (n.empty()) {
+            auto tmpPiezoDrive = Connect();
+            n = MakeName(tmpPiezoDrive.get());
+        }
+    }
+
+    CDeviceUtils::CopyLimitedString(name, n.c_str());
+}
+
+
+bool
+PiezoStage::Busy() {
+    if (settleTimeMs_ <= 0.0)
+        return false;
+    double msSinceMove = (GetCurrentMMTime() - lastMoveStart_).getMsec();
+    return msSinceMove < settleTimeMs_;
+}
+
+
+int
+PiezoStage::GetPositionUm(double& pos) {
+    long steps;
+    int err = GetPositionSteps(steps);
+    if (err != DEVICE_OK)
+        return err;
+
+    pos = steps * travelUm_ / PiezoDrive::MaxDeviceUnits;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::SetPositionUm(double pos) {
+    return SetPositionSteps(UmToDeviceUnits(pos));
+}
+
+
+int
+PiezoStage::GetPositionSteps(long& steps) {
+    if (!piezoDrive_)
+        return DEVICE_NOT_CONNECTED;
+
+    // In open loop the output voltage is the position
+    if (closedLoop_)
+        steps = piezoDrive_->GetPosition();
+    else
+        steps = std::max<short>(0, piezoDrive_->GetOutputVoltage());
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::SetPositionSteps(long steps) {
+    if (!piezoDrive_)
+        return DEVICE_NOT_CONNECTED;
+
+    long const units = std::max(0L,
+        std::min<long>(PiezoDrive::MaxDeviceUnits, steps));
+    short err = closedLoop_ ?
+        piezoDrive_->SetPosition(static_cast<WORD>(units)) :
+        piezoDrive_->SetOutputVoltage(static_cast<short>(units));
+    if (err)
+        return ERR_OFFSET + err;
+
+    lastMoveStart_ = GetCurrentMMTime();
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::GetLimits(double& lower, double& upper) {
+    lower = 0.0;
+    upper = travelUm_;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnOutputVoltage(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet && piezoDrive_) {
+        short voltage = piezoDrive_->GetOutputVoltage(); // Fraction of max
+        pProp->Set(voltage * maxVoltage_ / PiezoDrive::MaxDeviceUnits);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnInputSource(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (!piezoDrive_)
+        return DEVICE_OK;
+
+    if (eAct == MM::BeforeGet) {
+        PiezoDrive::VoltageSource source = piezoDrive_->GetVoltageSource();
+        for (auto const& item : INPUT_SOURCE_NAMES) {
+            if (item.source == source) {
+                pProp->Set(item.name);
+                break;
+            }
+        }
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string name;
+        pProp->Get(name);
+        for (auto const& item : INPUT_SOURCE_NAMES) {
+            if (name == item.name) {
+                short err = piezoDrive_->SetVoltageSource(item.source);
+                if (err)
+                    return ERR_OFFSET + err;
+                break;
+            }
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnSettleTime(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(settleTimeMs_);
+    }
+    else if (eAct == MM::AfterSet) {
+        pProp->Get(settleTimeMs_);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnWaveformSequencing(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(waveformSequencing_ ? PROPVAL_Yes : PROPVAL_No);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        waveformSequencing_ = value == PROPVAL_Yes;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnSequenceStepInterval(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(sequenceStepIntervalMs_);
+    }
+    else if (eAct == MM::AfterSet) {
+        pProp->Get(sequenceStepIntervalMs_);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::OnSequenceTrigger(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(sequenceExternalTrigger_ ? PROPVAL_ExternalInput :
+            PROPVAL_Software);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        sequenceExternalTrigger_ = value == PROPVAL_ExternalInput;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::IsStageSequenceable(bool& f) const {
+    f = piezoDrive_ != nullptr && waveformSequencing_;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::GetStageSequenceMaxLength(long& nrEvents) const {
+    if (!piezoDrive_)
+        return DEVICE_UNSUPPORTED_COMMAND;
+    nrEvents = PiezoDrive::MaxLUTLength;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::StartStageSequence() {
+    if (!piezoDrive_)
+        return DEVICE_UNSUPPORTED_COMMAND;
+    if (sequence_.size() < 2)
+        return ERR_STAGE_SEQUENCE_INVALID;
+
+    StopStageSequence();
+
+    // Play the table once; the controller steps on its own clock (a
+    // trigger only starts playback), so repeating would drift out of step
+    // with the camera
+    PiezoDrive::LUTWaveParams params;
+    params.mode = PiezoDrive::LUTModeFixed;
+    if (sequenceExternalTrigger_)
+        params.mode |= PiezoDrive::LUTModeInputTriggerEnable |
+            PiezoDrive::LUTModeInputTriggerSenseHigh;
+    params.cycleLength = static_cast<short>(sequence_.size());
+    params.numCycles = 1;
+    params.valueDelayMs = static_cast<unsigned>(sequenceStepIntervalMs_);
+    short err = piezoDrive_->SetLUTWaveParams(params);
+    if (err)
+        return ERR_OFFSET + err;
+
+    err = piezoDrive_->StartLUTOutput();
+    if (err)
+        return ERR_OFFSET + err;
+    sequenceRunning_ = true;
+
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::StopStageSequence() {
+    if (!sequenceRunning_)
+        return DEVICE_OK;
+    sequenceRunning_ = false;
+
+    short err = piezoDrive_->StopLUTOutput();
+    if (err)
+        return ERR_OFFSET + err;
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::ClearStageSequence() {
+    pendingSequence_.clear();
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::AddToStageSequence(double position) {
+    if (pendingSequence_.size() >= PiezoDrive::MaxLUTLength)
+        return DEVICE_SEQUENCE_TOO_LARGE;
+    pendingSequence_.push_back(UmToDeviceUnits(position));
+    return DEVICE_OK;
+}
+
+
+int
+PiezoStage::SendStageSequence() {
+    if (!piezoDrive_)
+        return DEVICE_UNSUPPORTED_COMMAND;
+    if (pendingSequence_.size() < 2)
+        return ERR_STAGE_SEQUENCE_INVALID;
+
+    StopStageSequence();
+
+    for (size_t i = 0; i < pendingSequence_.size(); ++i) {
+        short err = piezoDrive_->SetLUTWaveSample(static_cast<short>(i),
+            pendingSequence_[i]);
+        if (err)
+            return ERR_OFFSET + err;
+    }
+
+    sequence_ = pendingSequence_;
+    return DEVICE_OK;
+}
+
+
+WORD
+PiezoStage::UmToDeviceUnits(double pos) const {
+    double units = std::round(pos / travelUm_ * PiezoDrive::MaxDeviceUnits);
+    units = std::max(0.0, std::min<double>(PiezoDrive::MaxDeviceUnits, units));
+    return static_cast<WORD>(units);
+}
+
+
+std::unique_ptr<PiezoDrive>
+PiezoStage::Connect() const {
+    auto connection = MakeConnection(serialNo_);
+    if (!connection) // Shouldn't happen
+        return {};
+
+    return MakeKinesisPiezoDrive(connection);
+}
+
+
+std::string
+PiezoStage::MakeNameFromInventory() const {
+    DeviceInventoryEntry entry;
+    if (!inventory_ || !inventory_->Find(serialNo_, entry))
+        return {};
+
+    if (entry.connectionError) {
+        return MakeDeviceName("Error" + std::to_string(entry.connectionError),
+            serialNo_, -1);
+    }
+
+    auto info = entry.ChannelHardwareInfo(-1);
+    if (!info || info->modelNo.empty())
+        return {};
+    return MakeDeviceName(info->modelNo, serialNo_, -1);
+}
+
+
+std::string
+PiezoStage::MakeName(PiezoDrive* piezoDrive) const {
+    std::string modelNo;
+
+    if (piezoDrive && piezoDrive->GetConnection()->IsValid()) {
+        modelNo = piezoDrive->GetModelNo();
+    }
+    else {
+        modelNo = "Error";
+        if (piezoDrive) {
+            modelNo += std::to_string(piezoDrive->GetConnection()->ConnectionError());
+        }
+    }
+
+    return MakeDeviceName(modelNo, serialNo_, -1);
+}
@@ -0,0 +1,127 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceInventory.h"
+#include "KinesisDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Focus drive using a K-Cube piezo controller (KPZ101). Positions are mapped
+// linearly onto the controller's full output range: the strain gauge travel
+// in closed loop, or the user-given travel at maximum voltage in open loop.
+class PiezoStage final : public CStageBase<PiezoStage> {
+    std::string const serialNo_;
+
+    // The device name, if created via CreateDevice() (empty if created via
+    // DetectInstalledDevices())
+    std::string const givenName_;
+
+    // Connection that is optionally passed in to constructor, so that existing
+    // connection is kept instead of creating a new one when needed.
+    std::shared_ptr<KinesisDeviceConnection> retainedConnection_;
+
+    // Hub's cache of device info (may be null; see SingleAxisStage)
+    std::shared_ptr<DeviceInventory> inventory_;
+
+    // Set during Initialize():
+    std::unique_ptr<PiezoDrive> piezoDrive_;
+    bool closedLoop_{ true };
+    double travelUm_{ 20.0 };
+    double maxVoltage_{ 75.0 };
+    int pollingIntervalMs_{ 50 };
+    bool didEnable_{ false };
+
+    // Dynamic state:
+    MM::MMTime lastMoveStart_{ 0.0 };
+    double settleTimeMs_{ 0.0 };
+
+    // Stage sequence, in device units. The sequence is played from the
+    // controller's lookup table, one sample per step interval, once per
+    // start.
+    std::vector<WORD> pendingSequence_;
+    std::vector<WORD> sequence_;
+    bool waveformSequencing_{ false };
+    long sequenceStepIntervalMs_{ 10 };
+    bool sequenceExternalTrigger_{ false };
+    bool sequenceRunning_{ false };
+
+    bool initialized_{ false };
+
+public:
+    PiezoStage(std::string const& name, std::string const& serialNo,
+        std::shared_ptr<KinesisDeviceConnection> connection,
+        std::shared_ptr<DeviceInventory> inventory = {});
+    ~PiezoStage() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    void GetName(char* name) const override;
+    bool Busy() override;
+
+    int GetPositionUm(double& pos) override;
+    int SetPositionUm(double pos) override;
+    int GetPositionSteps(long& steps) override;
+    int SetPositionSteps(long steps) override;
+    int SetOrigin() override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int GetLimits(double& lower, double& upper) override;
+
+    bool IsContinuousFocusDrive() const override { return false; }
+    int IsStageSequenceable(bool& f) const override;
+    int GetStageSequenceMaxLength(long& nrEvents) const override;
+    int StartStageSequence() override;
+    int StopStageSequence() override;
+    int ClearStageSequence() override;
+    int AddToStageSequence(double position) override;
+    int SendStageSequence() override;
+
+    // Action interface
+    int OnOutputVoltage(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnInputSource(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSettleTime(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnWaveformSequencing(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSequenceStepInterval(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSequenceTrigger(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    std::unique_ptr<PiezoDrive> Connect() const;
+    std::string MakeNameFromInventory() const;
+    std::string MakeName(PiezoDrive* piezoDrive) const;
+    WORD UmToDeviceUnits(double pos) const;
+};
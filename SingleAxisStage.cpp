@@ -34,13 +34,19 @@
 
 #include "SingleAxisStage.h"
 
+#include "Clamp.h"
 #include "Connections.h"
 #include "DeviceEnumeration.h"
+#include "DeviceInstantiation.h"
 #include "Errors.h"
+#include "HomedStateStore.h"
+#include "MotorDriveSetup.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <limits>
+#include <utility>
 
 
 namespace {
@@ -49,49 +55,159 @@ namespace {
     char const* const PROPVAL_StageTypeRotational = "Rotational";
     char const* const PROP_DeviceUnitsPerMillimeter = "DeviceUnitsPerMillimeter";
     char const* const PROP_DeviceUnitsPerRevolution = "DeviceUnitsPerRevolution";
-}
-
-
-namespace {
-    // TODO C++17 will have std::clamp()
-    template <typename T>
-    inline T clamp(T const& value, T const& lower, T const& upper) {
-        return std::max(lower, std::min(upper, value));
-    }
-
-    template <typename T>
-    inline int clamp_int(T const& value) {
-        T const lower{ std::numeric_limits<int>::min() };
-        T const upper{ std::numeric_limits<int>::max() };
-        T ret = clamp(value, lower, upper);
-        return static_cast<int>(ret);
-    }
+    char const* const PROP_ConnectOnFirstUse = "ConnectOnFirstUse";
+    char const* const PROP_PollingIntervalMs = "PollingIntervalMs";
+    char const* const PROP_AdaptivePolling = "AdaptivePolling";
+    char const* const PROP_MovingPollingIntervalMs = "MovingPollingIntervalMs";
+    char const* const PROP_MaxVelocity = "MaxVelocity";
+    char const* const PROP_Acceleration = "Acceleration";
+    char const* const PROP_JogMaxVelocity = "JogMaxVelocity";
+    char const* const PROP_JogAcceleration = "JogAcceleration";
+    // Indexed by the OnVelocityInEffect() 'which' argument
+    char const* const VELOCITY_IN_EFFECT_PROPERTIES[] = {
+        "MaxVelocityInEffect",
+        "AccelerationInEffect",
+        "JogMaxVelocityInEffect",
+        "JogAccelerationInEffect",
+    };
+    char const* const PROP_EstimatedMoveTimeMs = "EstimatedMoveTimeMs";
+    char const* const PROP_PositionMaxAgeMs = "PositionMaxAgeMs";
+    char const* const PROP_Homed = "Homed";
+    char const* const PROP_ForceHome = "ForceHome";
+    char const* const PROPVAL_Home = "Home";
+    char const* const PROP_SettleToleranceUm = "SettleToleranceUm";
+    char const* const PROP_SettleDwellMs = "SettleDwellMs";
+    char const* const PROP_MoveCoalescingWindowMs = "MoveCoalescingWindowMs";
+    char const* const PROP_ApproachDirection = "ApproachDirection";
+    char const* const PROP_ApproachOvershootUm = "ApproachOvershootUm";
+    char const* const PROPVAL_ApproachAny = "Any";
+    char const* const PROPVAL_ApproachForwards = "Forwards";
+    char const* const PROPVAL_ApproachBackwards = "Backwards";
+    char const* const PROP_HardwareSequencing = "HardwareSequencing";
+    char const* const PROP_SoftwareSequencing = "SoftwareSequencing";
+    char const* const PROP_TrajectoryBufferSize = "TrajectoryBufferSize";
+    char const* const PROP_TrajectoryIntervalMs = "TrajectorySampleIntervalMs";
+    char const* const PROP_TrajectoryRecording = "TrajectoryRecording";
+    char const* const PROP_TrajectoryFile = "TrajectoryFile";
+    char const* const PROP_TrajectoryWindowMs = "TrajectorySaveWindowMs";
+    char const* const PROP_TrajectorySave = "TrajectorySave";
+    char const* const PROPVAL_Idle = "Idle";
+    char const* const PROPVAL_Save = "Save";
+    char const* const PROP_TriggerPort1Mode = "TriggerPort1Mode";
+    char const* const PROP_TriggerPort2Mode = "TriggerPort2Mode";
+    char const* const PROP_TriggerPort1Polarity = "TriggerPort1Polarity";
+    char const* const PROP_TriggerPort2Polarity = "TriggerPort2Polarity";
+    char const* const PROPVAL_PolarityHigh = "High";
+    char const* const PROPVAL_PolarityLow = "Low";
+    char const* const PROP_TriggerMoveRelativeUm = "TriggerMoveRelativeUm";
+    char const* const PROP_TriggerMoveAbsoluteUm = "TriggerMoveAbsoluteUm";
+    char const* const PROP_TriggerOutStartUm = "TriggerOutStartUm";
+    char const* const PROP_TriggerOutIntervalUm = "TriggerOutIntervalUm";
+    char const* const PROP_TriggerOutPulseCount = "TriggerOutPulseCount";
+    char const* const PROP_TriggerOutPulseWidthUs = "TriggerOutPulseWidthUs";
+    char const* const PROP_TriggerOutCycleCount = "TriggerOutCycleCount";
+    char const* const PROP_ScanStartUm = "ScanStartUm";
+    char const* const PROP_ScanStopUm = "ScanStopUm";
+    char const* const PROP_ScanVelocity = "ScanVelocity";
+    char const* const PROP_ScanTriggerPitchUm = "ScanTriggerPitchUm";
+    char const* const PROP_ScanTriggerPulseWidthUs = "ScanTriggerPulseWidthUs";
+    char const* const PROP_Scan = "Scan";
+    char const* const PROPVAL_Start = "Start";
+    char const* const PROPVAL_Scanning = "Scanning";
+    char const* const PROP_StatisticsReport = "StatisticsReport";
+    char const* const PROPVAL_Log = "Log";
+    char const* const PROPVAL_LogAndReset = "Log and reset";
+    char const* const PROPVAL_Reset = "Reset";
+
+    // Read-only performance counters (index passed to OnStatistic())
+    enum StatisticIndex {
+        StatMovesIssued,
+        StatBusyQueries,
+        StatErrors,
+        StatMoveTimeMean,
+        StatMoveTimeP95,
+        StatMoveTimeMax,
+        StatIdleLatencyMean,
+        StatIdleLatencyMax,
+    };
+    struct StatisticProperty {
+        StatisticIndex index;
+        char const* name;
+        bool isCount;
+    };
+    StatisticProperty const STATISTIC_PROPERTIES[] = {
+        { StatMovesIssued, "StatisticsMovesIssued", true },
+        { StatBusyQueries, "StatisticsBusyQueries", true },
+        { StatErrors, "StatisticsErrors", true },
+        { StatMoveTimeMean, "StatisticsMoveTimeMeanMs", false },
+        { StatMoveTimeP95, "StatisticsMoveTimeP95Ms", false },
+        { StatMoveTimeMax, "StatisticsMoveTimeMaxMs", false },
+        { StatIdleLatencyMean, "StatisticsIdleLatencyMeanMs", false },
+        { StatIdleLatencyMax, "StatisticsIdleLatencyMaxMs", false },
+    };
+
+    struct TriggerModeName {
+        MotorDrive::TriggerPortMode mode;
+        char const* name;
+    };
+    TriggerModeName const TRIGGER_MODE_NAMES[] = {
+        { MotorDrive::TriggerPortModeDisabled, "Disabled" },
+        { MotorDrive::TriggerPortModeInGPI, "In: General purpose" },
+        { MotorDrive::TriggerPortModeInRelativeMove, "In: Relative move" },
+        { MotorDrive::TriggerPortModeInAbsoluteMove, "In: Absolute move" },
+        { MotorDrive::TriggerPortModeInHome, "In: Home" },
+        { MotorDrive::TriggerPortModeInStop, "In: Stop" },
+        { MotorDrive::TriggerPortModeOutGPO, "Out: General purpose" },
+        { MotorDrive::TriggerPortModeOutInMotion, "Out: In motion" },
+        { MotorDrive::TriggerPortModeOutAtMaxVelocity, "Out: At max velocity" },
+        { MotorDrive::TriggerPortModeOutAtPositionSteps, "Out: At positions" },
+        { MotorDrive::TriggerPortModeOutSynch, "Out: Synch" },
+    };
+    char const* const PROPVAL_No = "No";
+    char const* const PROPVAL_Yes = "Yes";
+
+    // The sequence is run by the adapter (re-arming the trigger target after
+    // each move, or moving on each digital input edge), so the length is not
+    // limited by controller memory.
+    long const MAX_STAGE_SEQUENCE_LENGTH = 10000;
+
+    // A profiled stop at the end of a scan takes about the deceleration
+    // time; if the stage has not stopped by then, something else is wrong
+    int const SCAN_STOP_TIMEOUT_MS = 10000;
 }
 
 
 SingleAxisStage::SingleAxisStage(std::string const& name,
     std::string const& serialNo, short channel,
-    std::shared_ptr<KinesisDeviceConnection> connection) :
+    std::shared_ptr<KinesisDeviceConnection> connection,
+    std::shared_ptr<DeviceInventory> inventory) :
     serialNo_{ serialNo },
     channel_{ channel },
     givenName_{ name },
     homed_(false),
     initialized_(false),
-    retainedConnection_{ connection }
+    retainedConnection_{ connection },
+    inventory_{ inventory }
 {
+    // Created from the configuration (as opposed to by the Hub during
+    // hardware configuration)
+    if (!givenName_.empty())
+        RegisterConfiguredDevice(serialNo_);
+
     for (auto const& item : KinesisErrorCodes()) {
         SetErrorText(ERR_OFFSET + item.first, item.second.c_str());
     }
+    for (auto const& item : AdapterErrorTexts()) {
+        SetErrorText(item.first, item.second.c_str());
+    }
 
     // In general, the user must tell us whether the stage is linear or
     // rotational. (As far as I can tell, *_GetMotorTravelMode() doesn't work
     // as expected.)
 
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDCageRotator:
-        isRotational_ = true;
-        break;
-    }
+    DeviceType const* type = FindDeviceType(TypeIDOfSerialNo(serialNo));
+    if (type)
+        isRotational_ = type->isRotational;
     CreateStringProperty(PROP_StageType,
         isRotational_ ? PROPVAL_StageTypeRotational : PROPVAL_StageTypeLinear,
         false, nullptr, true);
@@ -104,32 +220,64 @@ SingleAxisStage::SingleAxisStage(std::string const& name,
     // are not equal to "steps"). And *_GetRealValueFromDeviceUnit() and
     // *_GetDeviceUnitFromRealValue() seem to always return an error.)
 
-    // The defaults below are set to small values to prevent accidents. Known
-    // defaults (taken from the Kinesis app) are given for integrated devices.
+    // The defaults (see DeviceTypes.h) are set to small values to prevent
+    // accidents, except for integrated devices whose values are known.
 
-    double defaultDeviceUnitsPerMm = 1000.0;
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDLabJack050: defaultDeviceUnitsPerMm = 1228800.0; break;
-    case TypeIDLabJack490: defaultDeviceUnitsPerMm = 134737.0; break;
-    case TypeIDLongTravelStage: defaultDeviceUnitsPerMm = 409600.0; break;
-    case TypeIDVerticalStage: defaultDeviceUnitsPerMm = 25050.0; break;
-    }
     CreateFloatProperty(PROP_DeviceUnitsPerMillimeter,
-        defaultDeviceUnitsPerMm, false, nullptr, true);
-
-    double defaultDeviceUnitsPerRevolution = 360.0;
-    switch (TypeIDOfSerialNo(serialNo)) {
-    case TypeIDCageRotator:
-        defaultDeviceUnitsPerRevolution = 49152000.0;
-        break;
-    }
+        type ? type->deviceUnitsPerMm : 1000.0, false, nullptr, true);
     CreateFloatProperty(PROP_DeviceUnitsPerRevolution,
-        defaultDeviceUnitsPerRevolution, false, nullptr, true);
-  
+        type ? type->deviceUnitsPerRevolution : 360.0, false, nullptr, true);
+
+    // For rarely used axes: Initialize() only checks the Hub's inventory, and
+    // the first command connects (saving startup time and idle polling)
+    CreateStringProperty(PROP_ConnectOnFirstUse, PROPVAL_No, false,
+        new CPropertyAction(this, &SingleAxisStage::OnConnectOnFirstUse),
+        true);
+    AddAllowedValue(PROP_ConnectOnFirstUse, PROPVAL_No);
+    AddAllowedValue(PROP_ConnectOnFirstUse, PROPVAL_Yes);
+
+    // Each polling cycle is a USB round trip, so with many controllers on one
+    // computer it pays to poll slowly while idle. Adaptive polling switches
+    // to the (fast) moving interval only while a move or home is in flight.
+    CreateIntegerProperty(PROP_PollingIntervalMs, pollingIntervalMs_,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_PollingIntervalMs, 1, 1000);
+    CreateStringProperty(PROP_AdaptivePolling, PROPVAL_No,
+        false, nullptr, true);
+    AddAllowedValue(PROP_AdaptivePolling, PROPVAL_No);
+    AddAllowedValue(PROP_AdaptivePolling, PROPVAL_Yes);
+    CreateIntegerProperty(PROP_MovingPollingIntervalMs,
+        movingPollingIntervalMs_, false, nullptr, true);
+    SetPropertyLimits(PROP_MovingPollingIntervalMs, 1, 1000);
+
+    // Velocity profile, in mm/s and mm/s^2 (deg/s and deg/s^2 if rotational).
+    // Zero leaves the value stored in the controller unchanged.
+    for (char const* prop : { PROP_MaxVelocity, PROP_Acceleration,
+        PROP_JogMaxVelocity, PROP_JogAcceleration }) {
+        CreateFloatProperty(prop, 0.0, false, nullptr, true);
+        SetPropertyLimits(prop, 0.0, 1000.0);
+    }
+
+    // Trajectory recorder (ring buffer of samples; the oldest are
+    // overwritten). Samples repeat if taken faster than the polling interval.
+    CreateIntegerProperty(PROP_TrajectoryBufferSize, 20000,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_TrajectoryBufferSize, 100, 1000000);
+    CreateIntegerProperty(PROP_TrajectoryIntervalMs, 5,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_TrajectoryIntervalMs, 1, 1000);
 }
 
 
-SingleAxisStage::~SingleAxisStage() = default;
+SingleAxisStage::~SingleAxisStage() {
+    UnregisterFromHub();
+    StopSequenceThread();
+    StopScan();
+    StopCoalescingThread();
+    JoinConnectThread();
+    if (!givenName_.empty() && !connectOnFirstUse_)
+        UnregisterConfiguredDevice(serialNo_);
+}
 
 
 int
@@ -137,21 +285,21 @@ SingleAxisStage::Initialize() {
     if (initialized_)
         return DEVICE_OK;
 
-    auto motorDrive = Connect();
-    if (!motorDrive) // Shouldn't happen
-        return DEVICE_ERR;
-    if (!motorDrive->GetConnection()->IsValid()) {
-        return ERR_OFFSET + motorDrive->GetConnection()->ConnectionError();
+    // Kinesis devices can only be opened after the Hub has built the device
+    // list, which it may be doing in the background
+    if (!inventory_) {
+        auto provider = dynamic_cast<DeviceInventoryProvider*>(GetParentHub());
+        if (provider)
+            inventory_ = provider->GetDeviceInventory();
     }
-    motorDrive_ = std::move(motorDrive);
+    if (inventory_)
+        inventory_->WaitForValidation();
+
+    auto homedStateProvider =
+        dynamic_cast<HomedStateProvider*>(GetParentHub());
+    if (homedStateProvider)
+        homedStateStore_ = homedStateProvider->GetHomedStateStore();
 
-    short err;
-    /*
-    // For what it's worth (doesn't seem to change anything)
-    err = motorDrive_->RequestSettings();
-    if (err)
-        return ERR_OFFSET + err;
-    */
     char stageType[MM::MaxStrLength];
     GetProperty(PROP_StageType, stageType);
     isRotational_ = stageType != std::string{ PROPVAL_StageTypeLinear };
@@ -167,57 +315,449 @@ SingleAxisStage::Initialize() {
         deviceUnitsPerUm_ = deviceUnitsPerMm / 1000.0;
     }
 
-    // Start polling, which will keep position and status bits up to date.
-    // Ensure we are immediately up to date by first requesting position and
-    // status bits.
+    long intervalMs;
+    GetProperty(PROP_PollingIntervalMs, intervalMs);
+    pollingIntervalMs_ = static_cast<int>(intervalMs);
+    GetProperty(PROP_MovingPollingIntervalMs, intervalMs);
+    movingPollingIntervalMs_ = static_cast<int>(intervalMs);
+    char adaptivePolling[MM::MaxStrLength];
+    GetProperty(PROP_AdaptivePolling, adaptivePolling);
+    adaptivePolling_ = adaptivePolling == std::string{ PROPVAL_Yes };
+
+    int ret;
+    if (connectOnFirstUse_) {
+        // Without connecting, only the Hub's inventory can tell us whether
+        // the device is there
+        if (inventory_) {
+            DeviceInventoryEntry entry;
+            if (!inventory_->Find(serialNo_, entry))
+                return ERR_DEVICE_NOT_IN_INVENTORY;
+            if (entry.connectionError)
+                return ERR_OFFSET + entry.connectionError;
+        }
+    }
+    else {
+        ret = ConnectAndWarmUp();
+        if (ret != DEVICE_OK)
+            return ret;
+        connected_ = true;
+    }
 
-    err = motorDrive_->RequestPosition();
-    if (err)
-        return ERR_OFFSET + err;
+    // It would be here to include the createProperty to expose stuff
+    CPropertyAction* pAct = new CPropertyAction(this, &SingleAxisStage::OnPositionChange);
+    ret = CreateFloatProperty("Position Degrees", 0.0, false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnEstimatedMoveTime);
+    ret = CreateFloatProperty(PROP_EstimatedMoveTimeMs, 0.0, true, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    // E.g. for autofocus, which needs the position right after a move; GUI
+    // refreshes within the bound still come from the polled position
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnPositionMaxAge);
+    ret = CreateFloatProperty(PROP_PositionMaxAgeMs, 0.0, false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_PositionMaxAgeMs, 0.0, 10000.0);
+
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnTrajectoryRecording);
+    ret = CreateStringProperty(PROP_TrajectoryRecording, PROPVAL_No, false,
+        pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_TrajectoryRecording, PROPVAL_No);
+    AddAllowedValue(PROP_TrajectoryRecording, PROPVAL_Yes);
+    ret = CreateStringProperty(PROP_TrajectoryFile, "", false, nullptr, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    // Length of the most recent part of the recording to save (0 for all)
+    ret = CreateFloatProperty(PROP_TrajectoryWindowMs, 0.0, false, nullptr,
+        false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_TrajectoryWindowMs, 0.0, 3600000.0);
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnTrajectorySave);
+    ret = CreateStringProperty(PROP_TrajectorySave, PROPVAL_Idle, false,
+        pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_TrajectorySave, PROPVAL_Idle);
+    AddAllowedValue(PROP_TrajectorySave, PROPVAL_Save);
+
+    // (The drive's capabilities are not known before it is connected, so
+    // these are not available with ConnectOnFirstUse)
+    if (connected_) {
+        // The pre-init velocity properties only say what to change (zero for
+        // nothing), so show what the controller is actually using
+        for (long i = 0; i < 4; ++i) {
+            auto pActEx = new CPropertyActionEx(this,
+                &SingleAxisStage::OnVelocityInEffect, i);
+            ret = CreateFloatProperty(VELOCITY_IN_EFFECT_PROPERTIES[i], 0.0,
+                true, pActEx, false);
+            if (ret != DEVICE_OK)
+                return ret;
+        }
+    }
+    if (connected_ && motorDrive_->HasTriggerPorts()) {
+        // Off by default, because MMCore then hardware-sequences Z-stacks,
+        // and without a TTL wired to trigger port 1 the stage never moves
+        pAct = new CPropertyAction(this, &SingleAxisStage::OnHardwareSequencing);
+        ret = CreateStringProperty(PROP_HardwareSequencing, PROPVAL_No, false,
+            pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+        AddAllowedValue(PROP_HardwareSequencing, PROPVAL_No);
+        AddAllowedValue(PROP_HardwareSequencing, PROPVAL_Yes);
+
+        ret = CreateTriggerProperties();
+        if (ret != DEVICE_OK)
+            return ret;
+        ret = CreateScanProperties();
+        if (ret != DEVICE_OK)
+            return ret;
+    }
+    else if (connected_) {
+        // Off by default, because MMCore then expects the stage to follow
+        // the camera without being told each position
+        pAct = new CPropertyAction(this, &SingleAxisStage::OnSoftwareSequencing);
+        ret = CreateStringProperty(PROP_SoftwareSequencing, PROPVAL_No, false,
+            pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+        AddAllowedValue(PROP_SoftwareSequencing, PROPVAL_No);
+        AddAllowedValue(PROP_SoftwareSequencing, PROPVAL_Yes);
+    }
+
+    if (hasEncoder_) {
+        pAct = new CPropertyAction(this, &SingleAxisStage::OnSettleTolerance);
+        ret = CreateFloatProperty(PROP_SettleToleranceUm, settleToleranceUm_,
+            false, pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+        SetPropertyLimits(PROP_SettleToleranceUm, 0.0, 1000.0);
+        pAct = new CPropertyAction(this, &SingleAxisStage::OnSettleDwell);
+        ret = CreateFloatProperty(PROP_SettleDwellMs, settleDwellMs_,
+            false, pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+        SetPropertyLimits(PROP_SettleDwellMs, 0.0, 1000.0);
+    }
+
+    // Absolute moves requested less than this long after the previous move
+    // are combined (0 sends every move immediately)
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnMoveCoalescingWindow);
+    ret = CreateIntegerProperty(PROP_MoveCoalescingWindowMs, 0, false, pAct,
+        false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_MoveCoalescingWindowMs, 0, 1000);
+
+    // For repeatability (backlash), absolute moves can end with an approach
+    // from one direction; only reversals cost an extra (overshoot) move
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnApproachDirection);
+    ret = CreateStringProperty(PROP_ApproachDirection, PROPVAL_ApproachAny,
+        false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_ApproachDirection, PROPVAL_ApproachAny);
+    AddAllowedValue(PROP_ApproachDirection, PROPVAL_ApproachForwards);
+    AddAllowedValue(PROP_ApproachDirection, PROPVAL_ApproachBackwards);
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnApproachOvershoot);
+    ret = CreateFloatProperty(PROP_ApproachOvershootUm, approachOvershootUm_,
+        false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_ApproachOvershootUm, 0.0, 10000.0);
+
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnHomed);
+    ret = CreateStringProperty(PROP_Homed, PROPVAL_No, true, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_Homed, PROPVAL_No);
+    AddAllowedValue(PROP_Homed, PROPVAL_Yes);
+
+    // Homes even if already homed (or if the homed state was restored)
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnForceHome);
+    ret = CreateStringProperty(PROP_ForceHome, PROPVAL_Idle, false, pAct,
+        false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_ForceHome, PROPVAL_Idle);
+    AddAllowedValue(PROP_ForceHome, PROPVAL_Home);
+
+    ret = CreateStatisticsProperties();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    initialized_ = true;
+
+    // Let the Hub home us together with the other stages
+    auto* registry = dynamic_cast<StageRegistry*>(GetParentHub());
+    if (registry) {
+        registry->RegisterStage(this);
+        registeredWithHub_ = true;
+    }
+
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::ConnectAndWarmUp() {
+    auto motorDrive = Connect();
+    if (!motorDrive) // Shouldn't happen
+        return DEVICE_ERR;
+    if (!motorDrive->GetConnection()->IsValid()) {
+        return ERR_OFFSET + motorDrive->GetConnection()->ConnectionError();
+    }
+    if (!motorDrive->GetConnection()->ClaimChannel(motorDrive->Channel()))
+        return ERR_CHANNEL_IN_USE;
+    motorDrive_ = std::move(motorDrive);
+
+    // Keep the Hub's inventory up to date, for devices loaded from config
+    if (inventory_) {
+        KinesisDevice::HardwareInfo info;
+        if (motorDrive_->GetHardwareInfo(info) == 0)
+            inventory_->SetChannelHardwareInfo(serialNo_, channel_, info);
+    }
 
-    err = motorDrive_->RequestStatusBits();
+    short err;
+    /*
+    // For what it's worth (doesn't seem to change anything)
+    err = motorDrive_->RequestSettings();
     if (err)
         return ERR_OFFSET + err;
+    */
+
+    // Start polling, which will keep position and status bits up to date.
+    // Ensure we are immediately up to date by first requesting position and
+    // status bits, and waiting for the replies.
+
+    int ret = AwaitInitialState(*motorDrive_);
+    if (ret != DEVICE_OK)
+        return ret;
 
     bool ok = motorDrive_->StartPolling(pollingIntervalMs_);
     if (!ok) {
         LogMessage(("Failed to start polling for serial no " + serialNo_).c_str());
     }
+    activePollingIntervalMs_ = pollingIntervalMs_;
+
+    // Completion messages let Busy() return as soon as a move ends, and wake
+    // the sequencing thread to arm the next position (and the coalescing
+    // thread to send the second move of an approach).
+    // (This runs on the message thread shared by all devices, so it only
+    // signals; the idle polling rate is restored by the coalescing thread.)
+    motorDrive_->StartMotionEvents([this] {
+        idlePollingDue_ = true;
+        sequenceCondition_.notify_one();
+        moveCondition_.notify_one();
+    });
+
+    ret = ApplyVelocityProfile();
+    if (ret != DEVICE_OK)
+        return ret;
 
-    CDeviceUtils::SleepMs(100); // Ensure the above requests finished (100 ms cycle)
-
-    if (!motorDrive_->IsChannelEnabled()) {
-        // A call to XXX_EnableChannel was added to Thorlabs example code at
-        // some point, but only for some devices. If this causes errors, we may
-        // need to branch depending on device type. At least some devices
-        // always start up disabled, so enabling _is_ necessary for those.
-        err = motorDrive_->SetChannelEnabled(true);
-        if (err)
-            return ERR_OFFSET + err;
-        didEnable_ = true;
+    // Used to predict move durations; without it Busy() simply polls
+    if (GetMoveProfile(*motorDrive_, profileMaxVelocity_,
+        profileAcceleration_) != DEVICE_OK) {
+        LogMessage(("Move time estimation is not available for serial no " +
+            serialNo_).c_str());
+        profileMaxVelocity_ = profileAcceleration_ = 0.0;
     }
 
-    // It would be here to include the createProperty to expose stuff
-    CPropertyAction* pAct = new CPropertyAction(this, &SingleAxisStage::OnPositionChange);
-    int ret = CreateFloatProperty("Position Degrees", 0.0, false, pAct, false);
+    ret = EnableChannelIfDisabled(*motorDrive_, didEnable_);
     if (ret != DEVICE_OK)
         return ret;
 
-    initialized_ = true;
+    // Only drives with an encoder can tell when they are in position before
+    // the controller reports the move complete
+    hasEncoder_ = dynamic_cast<NonStepperMotorDrive*>(motorDrive_.get()) !=
+        nullptr;
+
+    if (positionMaxAgeMs_ > 0.0)
+        motorDrive_->EnableLastMessageTimer(true);
+
+    RestoreHomedState();
+
+    // Slow down polling at the end of a move even if nobody calls Busy()
+    if (adaptivePolling_) {
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        StartCoalescingThreadLocked();
+    }
 
     return DEVICE_OK;
 }
 
 
+void
+SingleAxisStage::RestoreHomedState() {
+    if (!homedStateStore_)
+        return;
+
+    KinesisDevice::HardwareInfo info;
+    motorDrive_->GetHardwareInfo(info);
+    MotorDrive::StatusSnapshot const snapshot = motorDrive_->Snapshot();
+    bool const homedBit = (snapshot.statusBits &
+        MotorDrive::StatusBitsHomed) != 0;
+
+    // Controllers that report the Homed bit clear it on power-up. For the
+    // others, the position counter (reset to 0 on power-up) must be where it
+    // was left; a stage left at 0 cannot be told apart from a power cycle.
+    HomedStateRecord record;
+    bool sameSession = homedBit;
+    if (!sameSession && homedStateStore_->Find(serialNo_, channel_, record)) {
+        sameSession = record.homed && !record.reportsHomedBit &&
+            record.firmwareVersion == info.firmwareVersion &&
+            record.positionCounter != 0 &&
+            record.positionCounter == snapshot.position;
+    }
+    if (sameSession) {
+        homed_ = true;
+        LogMessage(("Homed state restored for serial no " + serialNo_)
+            .c_str());
+    }
+
+    // Until saved at shutdown, so that a crash does not leave a stale record
+    record = HomedStateRecord{};
+    record.firmwareVersion = info.firmwareVersion;
+    if (!homedStateStore_->Set(serialNo_, channel_, record))
+        LogMessage("Cannot write the homed state file");
+}
+
+
+void
+SingleAxisStage::SaveHomedState() {
+    if (!homedStateStore_ || !connected_)
+        return;
+
+    KinesisDevice::HardwareInfo info;
+    motorDrive_->GetHardwareInfo(info);
+    HomedStateRecord record;
+    // (A stage that is still moving may not stop where it is recorded)
+    record.homed = IsHomed() && !Busy();
+    MotorDrive::StatusSnapshot const snapshot = motorDrive_->Snapshot();
+    record.positionCounter = snapshot.position;
+    record.reportsHomedBit = (snapshot.statusBits &
+        MotorDrive::StatusBitsHomed) != 0;
+    record.firmwareVersion = info.firmwareVersion;
+    if (!homedStateStore_->Set(serialNo_, channel_, record))
+        LogMessage("Cannot write the homed state file");
+}
+
+
+void
+SingleAxisStage::StartConnecting() {
+    std::lock_guard<std::mutex> lock(connectMutex_);
+    if (connected_ || connecting_)
+        return;
+    if (connectThread_.joinable())
+        connectThread_.join(); // A previous attempt that failed
+    connecting_ = true;
+    connectThread_ = std::thread([this] { RunConnect(); });
+}
+
+
+void
+SingleAxisStage::RunConnect() {
+    LogMessage(("Connecting to serial no " + serialNo_ + " on first use")
+        .c_str());
+    int ret = ConnectAndWarmUp();
+    if (ret != DEVICE_OK && motorDrive_) {
+        // Start over on the next attempt
+        motorDrive_->StopMotionEvents();
+        motorDrive_->StopPolling();
+        motorDrive_->GetConnection()->ReleaseChannel(motorDrive_->Channel());
+        motorDrive_.reset();
+        didEnable_ = false;
+    }
+
+    {
+        // Send the move that prompted the connection (or report its failure
+        // on the next move)
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        connected_ = ret == DEVICE_OK;
+        if (movePending_) {
+            movePending_ = false;
+            int const moveRet = connected_ ?
+                SendPlannedMoveLocked(pendingTarget_) : ret;
+            if (moveRet != DEVICE_OK) {
+                LogMessage(("Deferred move failed (error " +
+                    std::to_string(moveRet) + ")").c_str());
+                deferredMoveError_ = moveRet;
+            }
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(connectMutex_);
+        connectError_ = ret;
+        connecting_ = false;
+    }
+    connectCondition_.notify_all();
+}
+
+
+int
+SingleAxisStage::AwaitConnection() {
+    if (connected_)
+        return DEVICE_OK;
+    StartConnecting();
+    std::unique_lock<std::mutex> lock(connectMutex_);
+    connectCondition_.wait(lock, [&] { return !connecting_; });
+    return connected_ ? DEVICE_OK : connectError_;
+}
+
+
+void
+SingleAxisStage::JoinConnectThread() {
+    std::unique_lock<std::mutex> lock(connectMutex_);
+    connectCondition_.wait(lock, [&] { return !connecting_; });
+    if (connectThread_.joinable())
+        connectThread_.join();
+}
+
+
+void
+SingleAxisStage::UnregisterFromHub() {
+    if (!registeredWithHub_)
+        return;
+    registeredWithHub_ = false;
+
+    // Look the hub up again rather than keeping a pointer to it: it may
+    // already have been unloaded (in which case there is nothing to do)
+    auto* registry = dynamic_cast<StageRegistry*>(GetParentHub());
+    if (registry)
+        registry->UnregisterStage(this);
+}
+
+
 int
 SingleAxisStage::Shutdown() {
+    UnregisterFromHub();
+
+    JoinConnectThread();
+    if (motorDrive_)
+        StopStageSequence();
+    StopScan();
+    StopCoalescingThread();
+    SaveHomedState();
+
+    trajectoryRecorder_.reset();
+
     if (didEnable_)
         motorDrive_->SetChannelEnabled(false);
 
-    if (motorDrive_)
+    if (motorDrive_) {
+        motorDrive_->StopMotionEvents();
         motorDrive_->StopPolling();
+        motorDrive_->GetConnection()->ReleaseChannel(motorDrive_->Channel());
+    }
 
     motorDrive_.reset();
+    connected_ = false;
 
     return DEVICE_OK;
 }
@@ -231,7 +771,8 @@ SingleAxisStage::GetName(char* name) const {
     // Initialize(): (1) During hardware configuration after
     // DetectInstalledDevices() and (2) During normal config loading.
     //
-    // In case (1) we don't know the model number yet, so we make a temporary
+    // In case (1) the Hub has given us its device inventory, which has the
+    // model number. If that is missing for some reason, we make a temporary
     // connection (which we can because the Hub has already initialized the
     // Kinesis API).
     //
@@ -243,8 +784,11 @@ SingleAxisStage::GetName(char* name) const {
         n = givenName_;
     }
     else {
-        auto tmpMotorDrive = Connect();
-        n = MakeName(tmpMotorDrive.get());
+        n = MakeNameFromInventory();
+        if (n.empty()) {
+            auto tmpMotorDrive = Connect();
+            n = MakeName(tmpMotorDrive.get());
+        }
     }
 
     CDeviceUtils::CopyLimitedString(name, n.c_str());
@@ -253,28 +797,156 @@ SingleAxisStage::GetName(char* name) const {
 
 bool
 SingleAxisStage::Busy() {
-    // We are busy if the motor is moving, which we get from the status bits.
-    // However, the status bits are only updated every polling interval, so
-    // they do not immediately indicate movement after we kick off a move. So
-    // we need to unconditionally report "busy" for one polling interval after
-    // starting a movement.
+    statistics_.CountBusyQuery();
+    if (scanning_)
+        return true;
+
+    std::lock_guard<std::mutex> lock(moveMutex_);
+    if (movePending_ || approachPending_)
+        return true;
+    if (!connected_)
+        return false;
+
+    bool busy = IsMoving();
+    if (!busy && moveTimingPending_)
+        NoteIdleLocked();
+
+    // Return to the idle polling rate once the move is over (but keep polling
+    // fast while a sequence is running, since the moves are then triggered by
+    // hardware).
+    if (!busy && adaptivePolling_ && !sequenceActive_)
+        SetActivePollingInterval(pollingIntervalMs_);
+
+    return busy;
+}
+
+
+// As Busy(), for callers other than MMCore (the hub and IsHomed()): not
+// counted in the call statistics, and leaves move timing and the polling
+// rate to Busy().
+bool
+SingleAxisStage::IsMovingNow() {
+    if (scanning_)
+        return true;
+
+    std::lock_guard<std::mutex> lock(moveMutex_);
+    if (movePending_ || approachPending_)
+        return true;
+    if (!connected_)
+        return false;
+    return IsMoving();
+}
+
+
+int
+SingleAxisStage::ApplyVelocityProfile() {
+    double maxVelocity, acceleration, jogMaxVelocity, jogAcceleration;
+    GetProperty(PROP_MaxVelocity, maxVelocity);
+    GetProperty(PROP_Acceleration, acceleration);
+    GetProperty(PROP_JogMaxVelocity, jogMaxVelocity);
+    GetProperty(PROP_JogAcceleration, jogAcceleration);
+
+    double const positionScale = DeviceUnitsPerMmOrDegree();
+    MotionScale const scale = motorDrive_->GetMotionScale();
+    auto toDeviceUnits = [&](double physical, double factor, int current) {
+        if (physical <= 0.0)
+            return current;
+        return clamp_int(std::round(physical * positionScale * factor));
+    };
+
+    short err;
+    if (maxVelocity > 0.0 || acceleration > 0.0) {
+        int accel, maxVel;
+        err = motorDrive_->GetVelocityParams(accel, maxVel);
+        if (err)
+            return KinesisError(err);
+        accel = toDeviceUnits(acceleration, scale.acceleration, accel);
+        maxVel = toDeviceUnits(maxVelocity, scale.velocity, maxVel);
+        err = motorDrive_->SetVelocityParams(accel, maxVel);
+        if (err)
+            return KinesisError(err);
+    }
+
+    if (jogMaxVelocity > 0.0 || jogAcceleration > 0.0) {
+        int accel, maxVel;
+        err = motorDrive_->GetJogVelocityParams(accel, maxVel);
+        if (err)
+            return KinesisError(err);
+        accel = toDeviceUnits(jogAcceleration, scale.acceleration, accel);
+        maxVel = toDeviceUnits(jogMaxVelocity, scale.velocity, maxVel);
+        err = motorDrive_->SetJogVelocityParams(accel, maxVel);
+        if (err)
+            return KinesisError(err);
+    }
+
+    return DEVICE_OK;
+}
+
+
+double
+SingleAxisStage::DeviceUnitsPerMmOrDegree() const {
+    // deviceUnitsPerUm_ is per degree for rotational stages
+    return isRotational_ ? deviceUnitsPerUm_ : 1000.0 * deviceUnitsPerUm_;
+}
 
-    auto now = GetCurrentMMTime();
-    auto msSinceMovementStart = (now - lastMovementStart_).getMsec();
 
+bool
+SingleAxisStage::IsMoving() {
     // Add a little extra to minimize the chance of a race due to jitter in the
     // polling.
-    if (msSinceMovementStart <= pollingIntervalMs_ + 10.0)
-        return true;
+    double const statusLagMs = activePollingIntervalMs_ + 10.0;
+
+    auto msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+
+    // Don't bother the controller until the move is predicted to be nearly
+    // finished (unless it has already reported completion). Leave a margin,
+    // since the controller's profile is not exactly trapezoidal.
+    double const estimateMs = estimatedMoveTimeMs_;
+    if (estimateMs > 0.0 && !(motorDrive_->MotionEventsEnabled() &&
+        !motorDrive_->IsMotionPending())) {
+        double const marginMs = statusLagMs + 0.1 * estimateMs;
+        if (msSinceMovementStart < estimateMs - marginMs)
+            return true;
+    }
+
+    // (During a sequence, moves are started by hardware triggers, which we
+    // do not see)
+    if (!sequenceActive_) {
+        if (settleState_ == SettleWaiting && HasSettled())
+            settleState_ = SettleReleased;
+        if (settleState_ == SettleReleased)
+            return false;
+    }
+
+    return IsMotorDriveMoving(*motorDrive_, msSinceMovementStart, statusLagMs);
+}
+
+
+bool
+SingleAxisStage::HasSettled() {
+    // Encoder counts are in the same device units as the position, and are
+    // read from the same snapshot, so this costs no extra controller traffic
+    long const encoderCount = motorDrive_->Snapshot().encoderCount;
+    double const errorUm = std::abs(static_cast<double>(encoderCount) -
+        static_cast<double>(settleTarget_)) / deviceUnitsPerUm_;
+    MM::MMTime const now = GetCurrentMMTime();
+    if (errorUm > settleToleranceUm_) {
+        settleInWindow_ = false;
+        return false;
+    }
+    if (!settleInWindow_) {
+        settleInWindow_ = true;
+        settleWindowEntered_ = now;
+    }
+    return (now - settleWindowEntered_).getMsec() >= settleDwellMs_;
+}
+
 
-    DWORD status = motorDrive_->GetStatusBits();
-    return status & (
-        MotorDrive::StatusBitsMovingCW |
-        MotorDrive::StatusBitsMovingCCW |
-        MotorDrive::StatusBitsJoggingCW |
-        MotorDrive::StatusBitsJoggingCCW |
-        MotorDrive::StatusBitsHoming
-    );
+void
+SingleAxisStage::EstimateMoveTime(double distance) {
+    estimatedMoveTimeMs_ = EstimateMoveTimeMs(distance,
+        profileMaxVelocity_, profileAcceleration_);
 }
 
 
@@ -293,15 +965,15 @@ SingleAxisStage::GetPositionUm(double& pos) {
 
 int
 SingleAxisStage::SetPositionUm(double pos) {
-    double dSteps = std::round(pos * deviceUnitsPerUm_);
-    int steps = clamp_int(dSteps);
-    return SetPositionSteps(steps);
+    return SetPositionSteps(UmToSteps(pos));
 }
 
 int SingleAxisStage::OnPositionChange(MM::PropertyBase* pProp, MM::ActionType eAct)
 {
     if (eAct == MM::BeforeGet)
     {
+        if (!connected_) // Refreshing properties should not connect
+            return DEVICE_OK;
         printf("Getting position of Wheel device\n");
         double pos;
         GetPositionUm(pos);
@@ -320,49 +992,1527 @@ int SingleAxisStage::OnPositionChange(MM::PropertyBase* pProp, MM::ActionType eA
 
 
 int
-SingleAxisStage::GetPositionSteps(long& steps) {
-    // TODO Does it make sense to use encoder position for non-stepper?
-    steps = motorDrive_->GetPositionCounter();
+SingleAxisStage::OnEstimatedMoveTime(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(estimatedMoveTimeMs_.load());
+    }
     return DEVICE_OK;
 }
 
 
 int
-SingleAxisStage::SetPositionSteps(long steps) {
-    int iSteps = sizeof(steps) > sizeof(iSteps) ?
-        clamp_int(steps) : static_cast<int>(steps);
+SingleAxisStage::OnTrajectoryRecording(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        bool recording = trajectoryRecorder_ && trajectoryRecorder_->IsRunning();
+        pProp->Set(recording ? PROPVAL_Yes : PROPVAL_No);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        if (s == PROPVAL_Yes) {
+            int ret = AwaitConnection();
+            if (ret != DEVICE_OK)
+                return ret;
+            if (!trajectoryRecorder_) {
+                long capacity, intervalMs;
+                GetProperty(PROP_TrajectoryBufferSize, capacity);
+                GetProperty(PROP_TrajectoryIntervalMs, intervalMs);
+                trajectoryRecorder_ = std::make_unique<TrajectoryRecorder>(
+                    *motorDrive_, static_cast<size_t>(capacity),
+                    static_cast<int>(intervalMs));
+            }
+            trajectoryRecorder_->Start();
+        }
+        else if (trajectoryRecorder_) {
+            trajectoryRecorder_->Stop(); // Keep the samples for saving
+        }
+    }
+    return DEVICE_OK;
+}
 
-    short err = motorDrive_->MoveToPosition(iSteps);
-    if (err)
-        return ERR_OFFSET + err;
 
-    lastMovementStart_ = GetCurrentMMTime();
+int
+SingleAxisStage::OnTrajectorySave(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        if (s != PROPVAL_Idle) {
+            pProp->Set(PROPVAL_Idle);
+            return SaveTrajectory();
+        }
+    }
+    return DEVICE_OK;
+}
+
 
+int
+SingleAxisStage::SaveTrajectory() {
+    if (!trajectoryRecorder_)
+        return ERR_TRAJECTORY_NOT_RECORDED;
+
+    char path[MM::MaxStrLength];
+    GetProperty(PROP_TrajectoryFile, path);
+    double windowMs;
+    GetProperty(PROP_TrajectoryWindowMs, windowMs);
+
+    // Copying out does not stop the recording
+    auto samples = trajectoryRecorder_->GetSamples(windowMs);
+    double const unitsPerMm = isRotational_ ?
+        deviceUnitsPerUm_ : 1000.0 * deviceUnitsPerUm_;
+    if (!TrajectoryRecorder::SaveCSV(path, samples, unitsPerMm,
+        isRotational_ ? "deg" : "mm"))
+        return ERR_TRAJECTORY_SAVE_FAILED;
+
+    LogMessage(("Saved " + std::to_string(samples.size()) +
+        " trajectory samples to " + path).c_str());
     return DEVICE_OK;
 }
 
 
 int
-SingleAxisStage::Home() {
-    if (!motorDrive_->CanHome())
-        return DEVICE_UNSUPPORTED_COMMAND;
-    int ret = DEVICE_OK;
+SingleAxisStage::CreateTriggerProperties() {
+    // Port modes and polarities are read back from the controller, since a
+    // running stage sequence takes over port 1.
+    for (long port : { 1L, 2L }) {
+        char const* modeProp = port == 1 ?
+            PROP_TriggerPort1Mode : PROP_TriggerPort2Mode;
+        auto pAct = new CPropertyActionEx(this,
+            &SingleAxisStage::OnTriggerPortMode, port);
+        int ret = CreateStringProperty(modeProp,
+            TRIGGER_MODE_NAMES[0].name, false, pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+        for (auto const& item : TRIGGER_MODE_NAMES)
+            AddAllowedValue(modeProp, item.name);
+
+        char const* polarityProp = port == 1 ?
+            PROP_TriggerPort1Polarity : PROP_TriggerPort2Polarity;
+        pAct = new CPropertyActionEx(this,
+            &SingleAxisStage::OnTriggerPortPolarity, port);
+        ret = CreateStringProperty(polarityProp, PROPVAL_PolarityHigh, false,
+            pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+        AddAllowedValue(polarityProp, PROPVAL_PolarityHigh);
+        AddAllowedValue(polarityProp, PROPVAL_PolarityLow);
+    }
 
-    if (homed_)
+    // Targets of trigger-in moves (degrees if rotational). The controller
+    // does not report these back, so they start at zero and are sent when
+    // set.
+    auto pAct = new CPropertyAction(this,
+        &SingleAxisStage::OnTriggerMoveRelative);
+    int ret = CreateFloatProperty(PROP_TriggerMoveRelativeUm, 0.0, false,
+        pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnTriggerMoveAbsolute);
+    ret = CreateFloatProperty(PROP_TriggerMoveAbsoluteUm, 0.0, false,
+        pAct, false);
+    if (ret != DEVICE_OK)
         return ret;
 
-    short err = motorDrive_->Home();
-    if (err)
-        return ERR_OFFSET + err;
+    // Pulses for "Out: At positions", applied to moves in both directions
+    // If the controller does not report them (e.g. older firmware), the
+    // pulse properties are left out but the rest of the stage still works
+    MotorDrive::TriggerPositionParams params{};
+    short err = motorDrive_->GetTriggerPositionParams(params);
+    if (err) {
+        LogMessage(("Trigger output pulses not available for serial no " +
+            serialNo_ + " (error " + std::to_string(err) + ")").c_str());
+        return DEVICE_OK;
+    }
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnTriggerOutput);
+    ret = CreateFloatProperty(PROP_TriggerOutStartUm,
+        params.startPositionFwd / deviceUnitsPerUm_, false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    pAct = new CPropertyAction(this, &SingleAxisStage::OnTriggerOutput);
+    ret = CreateFloatProperty(PROP_TriggerOutIntervalUm,
+        params.intervalFwd / deviceUnitsPerUm_, false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    std::pair<char const*, int> const counts[] = {
+        { PROP_TriggerOutPulseCount, params.pulseCountFwd },
+        { PROP_TriggerOutPulseWidthUs, params.pulseWidthUs },
+        { PROP_TriggerOutCycleCount, params.cycleCount },
+    };
+    for (auto const& prop : counts) {
+        pAct = new CPropertyAction(this, &SingleAxisStage::OnTriggerOutput);
+        ret = CreateIntegerProperty(prop.first, prop.second, false, pAct,
+            false);
+        if (ret != DEVICE_OK)
+            return ret;
+        SetPropertyLimits(prop.first, 0, 1000000);
+    }
+
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::ModifyTriggerConfig(long port,
+    MotorDrive::TriggerPortMode const* mode,
+    MotorDrive::TriggerPortPolarity const* polarity) {
+    if (port == 1 && sequenceThread_.joinable())
+        return ERR_TRIGGER_PORT_IN_USE;
+    if (port == 2 && scanning_)
+        return ERR_SCAN_CONFLICT;
+
+    MotorDrive::TriggerConfig config;
+    short err = motorDrive_->GetTriggerConfig(config);
+    if (err)
+        return KinesisError(err);
+    if (mode)
+        (port == 1 ? config.mode1 : config.mode2) = *mode;
+    if (polarity)
+        (port == 1 ? config.polarity1 : config.polarity2) = *polarity;
+    err = motorDrive_->SetTriggerConfig(config);
+    if (err)
+        return KinesisError(err);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnTriggerPortMode(MM::PropertyBase* pProp,
+    MM::ActionType eAct, long port) {
+    if (eAct == MM::BeforeGet) {
+        MotorDrive::TriggerConfig config;
+        short err = motorDrive_->GetTriggerConfig(config);
+        if (err)
+            return KinesisError(err);
+        auto mode = port == 1 ? config.mode1 : config.mode2;
+        for (auto const& item : TRIGGER_MODE_NAMES) {
+            if (item.mode == mode)
+                pProp->Set(item.name);
+        }
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        for (auto const& item : TRIGGER_MODE_NAMES) {
+            if (s == item.name)
+                return ModifyTriggerConfig(port, &item.mode, nullptr);
+        }
+        return DEVICE_INVALID_PROPERTY_VALUE;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnTriggerPortPolarity(MM::PropertyBase* pProp,
+    MM::ActionType eAct, long port) {
+    if (eAct == MM::BeforeGet) {
+        MotorDrive::TriggerConfig config;
+        short err = motorDrive_->GetTriggerConfig(config);
+        if (err)
+            return KinesisError(err);
+        auto polarity = port == 1 ? config.polarity1 : config.polarity2;
+        pProp->Set(polarity == MotorDrive::TriggerPortPolarityLow ?
+            PROPVAL_PolarityLow : PROPVAL_PolarityHigh);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        auto const polarity = s == PROPVAL_PolarityLow ?
+            MotorDrive::TriggerPortPolarityLow :
+            MotorDrive::TriggerPortPolarityHigh;
+        return ModifyTriggerConfig(port, nullptr, &polarity);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnTriggerMoveRelative(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::AfterSet) {
+        double um;
+        pProp->Get(um);
+        short err = motorDrive_->SetMoveRelativeDistance(
+            clamp_int(UmToSteps(um)));
+        if (err)
+            return KinesisError(err);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnTriggerMoveAbsolute(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::AfterSet) {
+        if (sequenceThread_.joinable())
+            return ERR_TRIGGER_PORT_IN_USE; // The sequence sets the target
+        double um;
+        pProp->Get(um);
+        short err = motorDrive_->SetMoveAbsolutePosition(
+            clamp_int(UmToSteps(um)));
+        if (err)
+            return KinesisError(err);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnTriggerOutput(MM::PropertyBase*, MM::ActionType eAct) {
+    if (eAct != MM::AfterSet)
+        return DEVICE_OK;
+
+    // All output parameters are sent together
+    double startUm, intervalUm;
+    long pulseCount, pulseWidthUs, cycleCount;
+    GetProperty(PROP_TriggerOutStartUm, startUm);
+    GetProperty(PROP_TriggerOutIntervalUm, intervalUm);
+    GetProperty(PROP_TriggerOutPulseCount, pulseCount);
+    GetProperty(PROP_TriggerOutPulseWidthUs, pulseWidthUs);
+    GetProperty(PROP_TriggerOutCycleCount, cycleCount);
+
+    MotorDrive::TriggerPositionParams params;
+    params.startPositionFwd = params.startPositionRev =
+        clamp_int(UmToSteps(startUm));
+    params.intervalFwd = params.intervalRev = clamp_int(UmToSteps(intervalUm));
+    params.pulseCountFwd = params.pulseCountRev = static_cast<int>(pulseCount);
+    params.pulseWidthUs = static_cast<int>(pulseWidthUs);
+    params.cycleCount = static_cast<int>(cycleCount);
+    short err = motorDrive_->SetTriggerPositionParams(params);
+    if (err)
+        return KinesisError(err);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::CreateScanProperties() {
+    // Distances in um (degrees if rotational); velocity in mm/s (deg/s), as
+    // for MaxVelocity
+    for (char const* prop : { PROP_ScanStartUm, PROP_ScanStopUm,
+        PROP_ScanTriggerPitchUm }) {
+        int ret = CreateFloatProperty(prop, 0.0, false, nullptr, false);
+        if (ret != DEVICE_OK)
+            return ret;
+    }
+    int ret = CreateFloatProperty(PROP_ScanVelocity, 1.0, false, nullptr,
+        false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_ScanVelocity, 0.0, 1000.0);
+    ret = CreateIntegerProperty(PROP_ScanTriggerPulseWidthUs, 100, false,
+        nullptr, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    SetPropertyLimits(PROP_ScanTriggerPulseWidthUs, 1, 1000000);
+
+    auto pAct = new CPropertyAction(this, &SingleAxisStage::OnScan);
+    ret = CreateStringProperty(PROP_Scan, PROPVAL_Idle, false, pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_Scan, PROPVAL_Idle);
+    AddAllowedValue(PROP_Scan, PROPVAL_Start);
+    AddAllowedValue(PROP_Scan, PROPVAL_Scanning);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnScan(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(scanning_ ? PROPVAL_Scanning : PROPVAL_Idle);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        if (value == PROPVAL_Start)
+            return StartScan();
+        if (value == PROPVAL_Idle)
+            StopScan(); // Abort
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::StartScan() {
+    if (sequenceThread_.joinable())
+        return ERR_SCAN_CONFLICT;
+    StopScan();
+
+    double startUm, stopUm, velocity, pitchUm;
+    long pulseWidthUs;
+    GetProperty(PROP_ScanStartUm, startUm);
+    GetProperty(PROP_ScanStopUm, stopUm);
+    GetProperty(PROP_ScanVelocity, velocity);
+    GetProperty(PROP_ScanTriggerPitchUm, pitchUm);
+    GetProperty(PROP_ScanTriggerPulseWidthUs, pulseWidthUs);
+
+    long const start = UmToSteps(startUm);
+    long const stop = UmToSteps(stopUm);
+    long const pitch = UmToSteps(pitchUm);
+    if (start == stop || velocity <= 0.0 || pitch <= 0)
+        return ERR_SCAN_INVALID;
+    bool const forwards = stop > start;
+
+    int accel, maxVel;
+    short err = motorDrive_->GetVelocityParams(accel, maxVel);
+    if (err)
+        return KinesisError(err);
+
+    // Start far enough before the start position to be at constant velocity
+    // by then (with a margin, since the ramp is not exactly linear)
+    double const positionScale = isRotational_ ?
+        deviceUnitsPerUm_ : 1000.0 * deviceUnitsPerUm_;
+    MotionScale const scale = motorDrive_->GetMotionScale();
+    double const velocityPos = velocity * positionScale; // Device units/s
+    double const accelPos = accel / scale.acceleration; // Device units/s^2
+    if (accelPos <= 0.0)
+        return ERR_SCAN_INVALID;
+    long const runUp = clamp_int(std::ceil(
+        1.5 * velocityPos * velocityPos / (2.0 * accelPos)));
+
+    ScanPlan plan;
+    plan.runUpPosition = clamp_int(forwards ? start - runUp : start + runUp);
+    plan.stopPosition = clamp_int(stop);
+    plan.direction = forwards ? MotorDrive::TravelDirectionForwards :
+        MotorDrive::TravelDirectionBackwards;
+    plan.acceleration = accel;
+    plan.maxVelocity = clamp_int(std::round(velocityPos * scale.velocity));
+
+    // One pulse at the start and at each pitch up to the stop position, only
+    // for moves in the scan direction (not for the run-up move)
+    int const pulseCount = static_cast<int>(std::abs(stop - start) / pitch + 1);
+    plan.triggers = MotorDrive::TriggerPositionParams{};
+    (forwards ? plan.triggers.startPositionFwd :
+        plan.triggers.startPositionRev) = clamp_int(start);
+    (forwards ? plan.triggers.intervalFwd : plan.triggers.intervalRev) =
+        clamp_int(pitch);
+    (forwards ? plan.triggers.pulseCountFwd : plan.triggers.pulseCountRev) =
+        pulseCount;
+    plan.triggers.pulseWidthUs = static_cast<int>(pulseWidthUs);
+    plan.triggers.cycleCount = 1;
+
+    {
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        movePending_ = false; // The scan replaces any deferred move
+        approachPending_ = false;
+    }
+    if (adaptivePolling_)
+        SetActivePollingInterval(movingPollingIntervalMs_);
+
+    scanning_ = true;
+    scanStopRequested_ = false;
+    scanThread_ = std::thread([this, plan] { RunScan(plan); });
+    return DEVICE_OK;
+}
+
+
+void
+SingleAxisStage::RunScan(ScanPlan plan) {
+    auto logFailure = [this](char const* what, int ret) {
+        LogMessage(("Scan: failed to " + std::string(what) + " (error " +
+            std::to_string(ret) + ")").c_str());
+    };
+    auto logError = [&](char const* what, short err) {
+        logFailure(what, KinesisError(err));
+    };
+
+    // Restored when the scan ends
+    int savedAccel, savedMaxVel;
+    MotorDrive::TriggerConfig savedConfig;
+    MotorDrive::TriggerPositionParams savedTriggers;
+    short err = motorDrive_->GetVelocityParams(savedAccel, savedMaxVel);
+    if (!err)
+        err = motorDrive_->GetTriggerConfig(savedConfig);
+    if (!err)
+        err = motorDrive_->GetTriggerPositionParams(savedTriggers);
+    if (err) {
+        logError("read the current settings", err);
+        scanning_ = false;
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(sequenceMutex_);
+    auto waitUntil = [&](auto done) {
+        while (!scanStopRequested_ && !done()) {
+            sequenceCondition_.wait_for(lock,
+                std::chrono::milliseconds(activePollingIntervalMs_.load()));
+        }
+        return !scanStopRequested_;
+    };
+    auto isStill = [&] {
+        double const msSinceMovementStart =
+            (GetCurrentMMTime() - lastMovementStart_).getMsec();
+        return !IsMotorDriveMoving(*motorDrive_, msSinceMovementStart,
+            activePollingIntervalMs_ + 10.0);
+    };
+    bool const forwards =
+        plan.direction == MotorDrive::TravelDirectionForwards;
+
+    bool moving = false;
+    int ret;
+    {
+        std::lock_guard<std::mutex> moveLock(moveMutex_);
+        ret = SendMoveLocked(plan.runUpPosition);
+    }
+    if (ret != DEVICE_OK) {
+        logFailure("move to the run-up position", ret);
+    }
+    else if (waitUntil(isStill)) {
+        MotorDrive::TriggerConfig config = savedConfig;
+        config.mode2 = MotorDrive::TriggerPortModeOutAtPositionSteps;
+        config.polarity2 = MotorDrive::TriggerPortPolarityHigh;
+        err = motorDrive_->SetVelocityParams(plan.acceleration,
+            plan.maxVelocity);
+        if (!err)
+            err = motorDrive_->SetTriggerPositionParams(plan.triggers);
+        if (!err)
+            err = motorDrive_->SetTriggerConfig(config);
+        if (!err)
+            err = motorDrive_->MoveAtVelocity(plan.direction);
+        if (err) {
+            logError("start the scan", err);
+        }
+        else {
+            moving = true;
+            lastMovementStart_ = GetCurrentMMTime();
+            waitUntil([&] {
+                long pos = motorDrive_->Snapshot().position;
+                return forwards ? pos >= plan.stopPosition :
+                    pos <= plan.stopPosition;
+            });
+        }
+    }
+
+    // Also reached when aborted
+    if (moving || scanStopRequested_) {
+        err = motorDrive_->StopProfiled();
+        if (err)
+            logError("stop", err);
+        lastMovementStart_ = GetCurrentMMTime();
+    }
+    // Wait for the stop even if aborted, but not forever
+    auto const stopDeadline = std::chrono::steady_clock::now() +
+        std::chrono::milliseconds(SCAN_STOP_TIMEOUT_MS);
+    while (!isStill()) {
+        if (std::chrono::steady_clock::now() >= stopDeadline) {
+            LogMessage(("Scan: stage still moving " +
+                std::to_string(SCAN_STOP_TIMEOUT_MS) + " ms after the stop; "
+                "restoring the settings anyway").c_str());
+            break;
+        }
+        sequenceCondition_.wait_for(lock,
+            std::chrono::milliseconds(activePollingIntervalMs_.load()));
+    }
+    scanStopRequested_ = false;
+
+    err = motorDrive_->SetTriggerConfig(savedConfig);
+    if (!err)
+        err = motorDrive_->SetTriggerPositionParams(savedTriggers);
+    if (!err)
+        err = motorDrive_->SetVelocityParams(savedAccel, savedMaxVel);
+    if (err)
+        logError("restore the settings", err);
+
+    {
+        // The whole scan is not a timed move
+        std::lock_guard<std::mutex> moveLock(moveMutex_);
+        moveTimingPending_ = false;
+        scanning_ = false;
+        RestoreIdlePollingLocked();
+    }
+}
+
+
+void
+SingleAxisStage::StopScan() {
+    if (!scanThread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sequenceMutex_);
+        scanStopRequested_ = true;
+    }
+    sequenceCondition_.notify_one();
+    scanThread_.join();
+}
+
+
+int
+SingleAxisStage::Stop() {
+    StopScan();
+    {
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        movePending_ = false;
+        approachPending_ = false;
+        if (!connected_)
+            return DEVICE_OK; // Nothing can be moving
+    }
+    short err = motorDrive_->StopProfiled();
+    if (err)
+        return KinesisError(err);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::GetPositionSteps(long& steps) {
+    int ret = AwaitConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    double const maxAgeMs = positionMaxAgeMs_;
+    if (maxAgeMs > 0.0) {
+        ret = RefreshPositionIfStale(*motorDrive_, maxAgeMs);
+        if (ret != DEVICE_OK) {
+            statistics_.CountError();
+            return ret;
+        }
+    }
+
+    // TODO Does it make sense to use encoder position for non-stepper?
+    steps = motorDrive_->Snapshot().position;
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::SetPositionSteps(long steps) {
+    int iSteps = sizeof(steps) > sizeof(iSteps) ?
+        clamp_int(steps) : static_cast<int>(steps);
+
+    std::lock_guard<std::mutex> lock(moveMutex_);
+
+    // Report the failure of a deferred move on the next call
+    int const deferredErr = deferredMoveError_;
+    deferredMoveError_ = DEVICE_OK;
+
+    // Not connected yet: the move is sent once the connection is ready
+    if (!connected_) {
+        pendingTarget_ = iSteps;
+        movePending_ = true;
+        StartConnecting();
+        return deferredErr;
+    }
+
+    // Within the coalescing window of the last move, only remember the
+    // target; the coalescing thread sends the latest one when the window
+    // ends (retargeting the move in progress)
+    if (coalescingWindowMs_ > 0 && (movePending_ ||
+        std::chrono::steady_clock::now() - lastMoveSent_ <
+        std::chrono::milliseconds(coalescingWindowMs_))) {
+        pendingTarget_ = iSteps;
+        if (!movePending_) {
+            movePending_ = true;
+            StartCoalescingThreadLocked();
+        }
+        return deferredErr;
+    }
+
+    int ret = SendPlannedMoveLocked(iSteps);
+    return ret != DEVICE_OK ? ret : deferredErr;
+}
+
+
+int
+SingleAxisStage::SendMoveLocked(int iSteps) {
+    // Switch before starting the move, so that the status lag in Busy() is
+    // that of the fast interval.
+    if (adaptivePolling_)
+        SetActivePollingInterval(movingPollingIntervalMs_);
+
+    double const distance = static_cast<double>(iSteps) -
+        motorDrive_->Snapshot().position;
+    short err = motorDrive_->MoveToPosition(iSteps);
+    if (err)
+        return KinesisError(err);
+
+    if (hasEncoder_ && settleToleranceUm_ > 0.0) {
+        settleState_ = SettleWaiting;
+        settleTarget_ = iSteps;
+        settleInWindow_ = false;
+    }
+    else {
+        settleState_ = SettleNone;
+    }
+
+    EstimateMoveTime(distance);
+
+    NoteMoveSentLocked();
+    lastMoveSent_ = std::chrono::steady_clock::now();
+
+    return DEVICE_OK;
+}
+
+
+void
+SingleAxisStage::NoteMoveSentLocked() {
+    lastMovementStart_ = GetCurrentMMTime();
+    statistics_.CountMove();
+    moveTimingPending_ = true;
+}
+
+
+void
+SingleAxisStage::NoteIdleLocked() {
+    moveTimingPending_ = false;
+    // (Moves during a sequence are started by hardware, so are not timed)
+    if (sequenceActive_)
+        return;
+
+    double const msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    statistics_.RecordMoveTime(msSinceMovementStart);
+
+    // How long idle went unnoticed after the controller reported the move
+    // finished (not known if the message was missed, or if the move was
+    // released early by the in-position window)
+    if (motorDrive_->MotionEventsEnabled()) {
+        double const msSinceCompleted = motorDrive_->MsSinceMotionCompleted();
+        if (msSinceCompleted < msSinceMovementStart)
+            statistics_.RecordIdleLatency(msSinceCompleted);
+    }
+}
+
+
+int
+SingleAxisStage::KinesisError(short err) {
+    statistics_.CountError();
+    return ERR_OFFSET + err;
+}
+
+
+void
+SingleAxisStage::RunMoveCoalescing() {
+    std::unique_lock<std::mutex> lock(moveMutex_);
+    while (!coalescingStopRequested_) {
+        int ret;
+        if (movePending_) {
+            auto const due = lastMoveSent_ +
+                std::chrono::milliseconds(coalescingWindowMs_);
+            if (std::chrono::steady_clock::now() < due) {
+                moveCondition_.wait_until(lock, due);
+                continue;
+            }
+            movePending_ = false;
+            ret = SendPlannedMoveLocked(pendingTarget_);
+        }
+        else if (approachPending_) {
+            // Woken by the move-completed message of the overshoot move
+            if (IsMoving()) {
+                moveCondition_.wait_for(lock,
+                    std::chrono::milliseconds(activePollingIntervalMs_.load()));
+                continue;
+            }
+            approachPending_ = false;
+            ret = SendMoveLocked(approachTarget_);
+        }
+        else if (idlePollingDue_.exchange(false)) {
+            RestoreIdlePollingLocked();
+            continue;
+        }
+        else {
+            // The motion-completed handler does not take the mutex, so its
+            // notification can be missed; the timeout bounds the delay
+            moveCondition_.wait_for(lock,
+                std::chrono::milliseconds(pollingIntervalMs_));
+            continue;
+        }
+
+        if (ret != DEVICE_OK) {
+            LogMessage(("Deferred move failed (error " +
+                std::to_string(ret) + ")").c_str());
+            deferredMoveError_ = ret;
+        }
+    }
+}
+
+
+int
+SingleAxisStage::SendPlannedMoveLocked(int iSteps) {
+    // A new target replaces the remainder of a previous approach
+    approachPending_ = false;
+
+    int const direction = approachDirection_;
+    long const overshoot = UmToSteps(approachOvershootUm_);
+    if (direction == 0 || overshoot <= 0 || sequenceActive_)
+        return SendMoveLocked(iSteps);
+
+    // Only a move against the approach direction needs the overshoot, after
+    // which the approach is a second move, sent by the coalescing thread as
+    // soon as the first one finishes
+    long const from = motorDrive_->Snapshot().position;
+    bool const reverses = direction > 0 ? iSteps < from : iSteps > from;
+    if (!reverses)
+        return SendMoveLocked(iSteps);
+
+    int ret = SendMoveLocked(clamp_int(static_cast<double>(iSteps) -
+        direction * static_cast<double>(overshoot)));
+    if (ret != DEVICE_OK)
+        return ret;
+    approachTarget_ = iSteps;
+    approachPending_ = true;
+    StartCoalescingThreadLocked();
+    return DEVICE_OK;
+}
+
+
+void
+SingleAxisStage::StartCoalescingThreadLocked() {
+    if (!coalescingThread_.joinable()) {
+        coalescingStopRequested_ = false;
+        coalescingThread_ = std::thread([this] { RunMoveCoalescing(); });
+    }
+    moveCondition_.notify_one();
+}
+
+
+void
+SingleAxisStage::StopCoalescingThread() {
+    if (!coalescingThread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        coalescingStopRequested_ = true;
+        movePending_ = false;
+        approachPending_ = false;
+    }
+    moveCondition_.notify_one();
+    coalescingThread_.join();
+}
+
+
+int
+SingleAxisStage::SetRelativePositionUm(double d) {
+    return SetRelativePositionSteps(UmToSteps(d));
+}
+
+
+int
+SingleAxisStage::SetRelativePositionSteps(long steps) {
+    int ret = AwaitConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+
+    std::lock_guard<std::mutex> lock(moveMutex_);
+
+    // Relative to a target that has not been sent yet
+    if (movePending_) {
+        pendingTarget_ = clamp_int(static_cast<double>(pendingTarget_) +
+            static_cast<double>(steps));
+        return DEVICE_OK;
+    }
+    if (approachPending_) {
+        approachTarget_ = clamp_int(static_cast<double>(approachTarget_) +
+            static_cast<double>(steps));
+        return DEVICE_OK;
+    }
+
+    // With the approach planner on, the move is made absolute so that it
+    // can be planned like any other (relative to the last polled position)
+    if (approachDirection_ != 0 && approachOvershootUm_ > 0.0 &&
+        !sequenceActive_) {
+        return SendPlannedMoveLocked(clamp_int(
+            static_cast<double>(motorDrive_->Snapshot().position) +
+            static_cast<double>(steps)));
+    }
+
+    if (adaptivePolling_)
+        SetActivePollingInterval(movingPollingIntervalMs_);
+
+    short err = motorDrive_->MoveRelative(clamp_int(steps));
+    if (err)
+        return KinesisError(err);
+
+    // The target of a relative move is not known exactly (the position we
+    // have may be a polling interval old), so the settle window is not used
+    settleState_ = SettleNone;
+
+    EstimateMoveTime(static_cast<double>(steps));
+
+    NoteMoveSentLocked();
+    lastMoveSent_ = std::chrono::steady_clock::now();
+
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::Home() {
+    int ret = AwaitConnection();
+    if (ret != DEVICE_OK)
+        return ret;
+    if (!motorDrive_->CanHome())
+        return DEVICE_UNSUPPORTED_COMMAND;
+
+    std::lock_guard<std::mutex> lock(moveMutex_);
+
+    if (homed_)
+        return ret;
+
+    if (adaptivePolling_)
+        SetActivePollingInterval(movingPollingIntervalMs_);
+
+    movePending_ = false; // Homing supersedes a deferred move
+    approachPending_ = false;
+    short err = motorDrive_->Home();
+    if (err)
+        return KinesisError(err);
     else
         homed_ = true;
+    settleState_ = SettleNone;
 
-    lastMovementStart_ = GetCurrentMMTime();
+    estimatedMoveTimeMs_ = 0.0; // Homing distance is unknown
+
+    NoteMoveSentLocked();
+
+    return DEVICE_OK;
+}
+
+
+bool
+SingleAxisStage::IsHomed() {
+    // homed_ is set when homing starts; the controller's bit is set once it
+    // completes (but not by all devices)
+    if (!connected_)
+        return false;
+    DWORD status = motorDrive_->Snapshot().statusBits;
+    if (status & MotorDrive::StatusBitsHomed)
+        return true;
+    return homed_ && !(status & MotorDrive::StatusBitsHoming) &&
+        !IsMovingNow();
+}
+
+
+std::string
+SingleAxisStage::StageName() const {
+    char name[MM::MaxStrLength];
+    GetName(name);
+    return name;
+}
+
+
+int
+SingleAxisStage::OnHomed(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(IsHomed() ? PROPVAL_Yes : PROPVAL_No);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnForceHome(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        if (s != PROPVAL_Idle) {
+            pProp->Set(PROPVAL_Idle);
+            {
+                std::lock_guard<std::mutex> lock(moveMutex_);
+                homed_ = false;
+            }
+            return Home();
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnPositionMaxAge(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(positionMaxAgeMs_.load());
+    }
+    else if (eAct == MM::AfterSet) {
+        double maxAgeMs;
+        pProp->Get(maxAgeMs);
+        // The age of the position is that of the last message received (if
+        // not connected yet, the timer is enabled when connecting)
+        positionMaxAgeMs_ = maxAgeMs;
+        if (connected_)
+            motorDrive_->EnableLastMessageTimer(maxAgeMs > 0.0);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::CreateStatisticsProperties() {
+    int ret;
+    for (auto const& stat : STATISTIC_PROPERTIES) {
+        auto pAct = new CPropertyActionEx(this, &SingleAxisStage::OnStatistic,
+            stat.index);
+        ret = stat.isCount ?
+            CreateIntegerProperty(stat.name, 0, true, pAct, false) :
+            CreateFloatProperty(stat.name, 0.0, true, pAct, false);
+        if (ret != DEVICE_OK)
+            return ret;
+    }
 
+    auto pAct = new CPropertyAction(this, &SingleAxisStage::OnStatisticsReport);
+    ret = CreateStringProperty(PROP_StatisticsReport, PROPVAL_Idle, false,
+        pAct, false);
+    if (ret != DEVICE_OK)
+        return ret;
+    AddAllowedValue(PROP_StatisticsReport, PROPVAL_Idle);
+    AddAllowedValue(PROP_StatisticsReport, PROPVAL_Log);
+    AddAllowedValue(PROP_StatisticsReport, PROPVAL_LogAndReset);
+    AddAllowedValue(PROP_StatisticsReport, PROPVAL_Reset);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnStatistic(MM::PropertyBase* pProp, MM::ActionType eAct,
+    long which) {
+    if (eAct != MM::BeforeGet)
+        return DEVICE_OK;
+
+    StageStatistics::Summary const s = statistics_.GetSummary();
+    auto setCount = [&](std::uint64_t count) {
+        long const maxLong = std::numeric_limits<long>::max();
+        pProp->Set(count > static_cast<std::uint64_t>(maxLong) ?
+            maxLong : static_cast<long>(count));
+    };
+    switch (which) {
+    case StatMovesIssued: setCount(s.movesIssued); break;
+    case StatBusyQueries: setCount(s.busyQueries); break;
+    case StatErrors: setCount(s.errors); break;
+    case StatMoveTimeMean: pProp->Set(s.meanMoveMs); break;
+    case StatMoveTimeP95: pProp->Set(s.p95MoveMs); break;
+    case StatMoveTimeMax: pProp->Set(s.maxMoveMs); break;
+    case StatIdleLatencyMean: pProp->Set(s.meanLatencyMs); break;
+    case StatIdleLatencyMax: pProp->Set(s.maxLatencyMs); break;
+    }
+    return DEVICE_OK;
+}
+
+
+// Setting to Log writes the counters to the CoreLog (e.g. at the end of an
+// acquisition)
+int
+SingleAxisStage::OnStatisticsReport(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        if (s != PROPVAL_Idle) {
+            if (s != PROPVAL_Reset) {
+                LogMessage("Statistics: " + StageStatistics::FormatSummary(
+                    statistics_.GetSummary()));
+            }
+            if (s != PROPVAL_Log)
+                statistics_.Reset();
+            pProp->Set(PROPVAL_Idle);
+        }
+    }
     return DEVICE_OK;
 }
 
 
+int
+SingleAxisStage::OnSettleTolerance(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(settleToleranceUm_);
+    }
+    else if (eAct == MM::AfterSet) {
+        pProp->Get(settleToleranceUm_);
+        // Takes effect from the next move
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnSettleDwell(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(settleDwellMs_);
+    }
+    else if (eAct == MM::AfterSet) {
+        pProp->Get(settleDwellMs_);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnMoveCoalescingWindow(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    std::lock_guard<std::mutex> lock(moveMutex_);
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(static_cast<long>(coalescingWindowMs_));
+    }
+    else if (eAct == MM::AfterSet) {
+        long windowMs;
+        pProp->Get(windowMs);
+        coalescingWindowMs_ = static_cast<int>(windowMs);
+        moveCondition_.notify_one(); // A pending move may now be due
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnApproachDirection(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    std::lock_guard<std::mutex> lock(moveMutex_);
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(approachDirection_ > 0 ? PROPVAL_ApproachForwards :
+            approachDirection_ < 0 ? PROPVAL_ApproachBackwards :
+            PROPVAL_ApproachAny);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string s;
+        pProp->Get(s);
+        approachDirection_ = s == PROPVAL_ApproachForwards ? 1 :
+            s == PROPVAL_ApproachBackwards ? -1 : 0;
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnApproachOvershoot(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    std::lock_guard<std::mutex> lock(moveMutex_);
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(approachOvershootUm_);
+    }
+    else if (eAct == MM::AfterSet) {
+        pProp->Get(approachOvershootUm_);
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnVelocityInEffect(MM::PropertyBase* pProp,
+    MM::ActionType eAct, long which) {
+    if (eAct == MM::BeforeGet) {
+        // Read each time, since a scan changes the velocity temporarily
+        bool const jog = which >= 2;
+        int accel, maxVel;
+        short err = jog ? motorDrive_->GetJogVelocityParams(accel, maxVel) :
+            motorDrive_->GetVelocityParams(accel, maxVel);
+        if (err)
+            return KinesisError(err);
+        double const positionScale = DeviceUnitsPerMmOrDegree();
+        MotionScale const scale = motorDrive_->GetMotionScale();
+        bool const velocity = which % 2 == 0;
+        pProp->Set(velocity ? maxVel / (positionScale * scale.velocity) :
+            accel / (positionScale * scale.acceleration));
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnConnectOnFirstUse(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(connectOnFirstUse_ ? PROPVAL_Yes : PROPVAL_No);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        bool const connectOnFirstUse = value == PROPVAL_Yes;
+        if (connectOnFirstUse == connectOnFirstUse_)
+            return DEVICE_OK;
+        connectOnFirstUse_ = connectOnFirstUse;
+
+        // A deferred stage must not be opened by the Hub's warm-up
+        if (!givenName_.empty()) {
+            if (connectOnFirstUse_)
+                UnregisterConfiguredDevice(serialNo_);
+            else
+                RegisterConfiguredDevice(serialNo_);
+        }
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnHardwareSequencing(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(hardwareSequencing_ ? PROPVAL_Yes : PROPVAL_No);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        hardwareSequencing_ = value == PROPVAL_Yes;
+        // Takes effect from the next sequence
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::OnSoftwareSequencing(MM::PropertyBase* pProp,
+    MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(softwareSequencing_ ? PROPVAL_Yes : PROPVAL_No);
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string value;
+        pProp->Get(value);
+        softwareSequencing_ = value == PROPVAL_Yes;
+        // Takes effect from the next sequence
+    }
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::IsStageSequenceable(bool& f) const {
+    f = connected_ && (motorDrive_->HasTriggerPorts() ?
+        hardwareSequencing_ : softwareSequencing_);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::GetStageSequenceMaxLength(long& nrEvents) const {
+    bool sequenceable;
+    IsStageSequenceable(sequenceable);
+    if (!sequenceable)
+        return DEVICE_UNSUPPORTED_COMMAND;
+    nrEvents = MAX_STAGE_SEQUENCE_LENGTH;
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::StartStageSequence() {
+    bool sequenceable;
+    IsStageSequenceable(sequenceable);
+    if (!sequenceable)
+        return DEVICE_UNSUPPORTED_COMMAND;
+    if (sequence_.size() < 2)
+        return ERR_STAGE_SEQUENCE_INVALID;
+    if (scanning_)
+        return ERR_SCAN_CONFLICT;
+
+    StopStageSequence();
+
+    if (!motorDrive_->HasTriggerPorts()) {
+        int ret = SetPositionSteps(sequence_[0]);
+        if (ret != DEVICE_OK)
+            return ret;
+
+        // Status bits (including the digital input) are only as fresh as the
+        // polling interval
+        if (adaptivePolling_)
+            SetActivePollingInterval(movingPollingIntervalMs_);
+
+        softwareSequenceRunning_ = true;
+        sequenceStopRequested_ = false;
+        {
+            std::lock_guard<std::mutex> lock(moveMutex_);
+            sequenceActive_ = true;
+            sequenceThread_ = std::thread([this] { RunSoftwareSequence(); });
+        }
+        return DEVICE_OK;
+    }
+
+    short err = motorDrive_->GetTriggerConfig(savedTriggerConfig_);
+    if (err)
+        return KinesisError(err);
+
+    // The first position is reached by a normal move; each trigger then
+    // advances to the next position (wrapping around at the end).
+    err = motorDrive_->SetMoveAbsolutePosition(clamp_int(sequence_[1]));
+    if (err)
+        return KinesisError(err);
+
+    MotorDrive::TriggerConfig config = savedTriggerConfig_;
+    config.mode1 = MotorDrive::TriggerPortModeInAbsoluteMove;
+    config.polarity1 = MotorDrive::TriggerPortPolarityHigh;
+    err = motorDrive_->SetTriggerConfig(config);
+    if (err)
+        return KinesisError(err);
+
+    int ret = SetPositionSteps(sequence_[0]);
+    if (ret != DEVICE_OK) {
+        motorDrive_->SetTriggerConfig(savedTriggerConfig_);
+        return ret;
+    }
+
+    sequenceStopRequested_ = false;
+    {
+        // The coalescing thread tests sequenceActive_ under this mutex
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        sequenceActive_ = true;
+        sequenceThread_ = std::thread([this] { RunSequence(); });
+    }
+
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::StopStageSequence() {
+    if (!sequenceThread_.joinable())
+        return DEVICE_OK;
+
+    StopSequenceThread();
+    {
+        std::lock_guard<std::mutex> lock(moveMutex_);
+        sequenceActive_ = false;
+        RestoreIdlePollingLocked();
+    }
+
+    if (softwareSequenceRunning_) {
+        softwareSequenceRunning_ = false;
+        return DEVICE_OK;
+    }
+
+    short err = motorDrive_->SetTriggerConfig(savedTriggerConfig_);
+    if (err)
+        return KinesisError(err);
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::ClearStageSequence() {
+    pendingSequence_.clear();
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::AddToStageSequence(double position) {
+    if (static_cast<long>(pendingSequence_.size()) >= MAX_STAGE_SEQUENCE_LENGTH)
+        return DEVICE_SEQUENCE_TOO_LARGE;
+    pendingSequence_.push_back(UmToSteps(position));
+    return DEVICE_OK;
+}
+
+
+int
+SingleAxisStage::SendStageSequence() {
+    // With trigger ports, we detect arrival at each position in order to
+    // arm the next one, so consecutive identical positions cannot be
+    // distinguished.
+    size_t n = pendingSequence_.size();
+    if (n < 2)
+        return ERR_STAGE_SEQUENCE_INVALID;
+    if (motorDrive_ && motorDrive_->HasTriggerPorts()) {
+        for (size_t i = 0; i < n; ++i) {
+            if (pendingSequence_[i] == pendingSequence_[(i + 1) % n])
+                return ERR_STAGE_SEQUENCE_INVALID;
+        }
+    }
+
+    if (sequenceThread_.joinable())
+        StopStageSequence();
+
+    sequence_ = pendingSequence_;
+    return DEVICE_OK;
+}
+
+
+void
+SingleAxisStage::RunSequence() {
+    // Status is read from the driver directly (not the snapshot, which
+    // would add up to another polling interval before the re-arm). A
+    // trigger that arrives after the stage reaches a position but before
+    // the next one is armed replays the old target, after which the stage
+    // would stay one position behind the camera. The trigger input level
+    // is reported as digital input 1, so a second rising edge before the
+    // re-arm, or a gap in sampling long enough to hide one, stops the
+    // sequence instead.
+    size_t const n = sequence_.size();
+    size_t current = 0;
+    size_t next = 1;
+    bool triggered = false;
+    bool inputWasHigh = (motorDrive_->GetStatusBits() &
+        MotorDrive::StatusBitsDigitalInput1) != 0;
+    auto lastSample = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(sequenceMutex_);
+    while (!sequenceStopRequested_) {
+        int const intervalMs = activePollingIntervalMs_.load();
+        sequenceCondition_.wait_for(lock,
+            std::chrono::milliseconds(intervalMs));
+        if (sequenceStopRequested_)
+            break;
+
+        auto const now = std::chrono::steady_clock::now();
+        auto const gapMs = std::chrono::duration_cast<
+            std::chrono::milliseconds>(now - lastSample).count();
+        lastSample = now;
+        if (gapMs > 2 * intervalMs) {
+            LogMessage(("Stage sequence stopped: status not sampled for " +
+                std::to_string(gapMs) + " ms (polling interval " +
+                std::to_string(intervalMs) + " ms); a trigger may have " +
+                "arrived before the next position was armed").c_str());
+            break;
+        }
+
+        DWORD const bits = motorDrive_->GetStatusBits();
+        long const pos = motorDrive_->GetPositionCounter();
+
+        bool const inputHigh = (bits & MotorDrive::StatusBitsDigitalInput1) != 0;
+        bool const risingEdge = inputHigh && !inputWasHigh;
+        inputWasHigh = inputHigh;
+        if (risingEdge) {
+            if (triggered) {
+                LogMessage(("Stage sequence stopped: trigger received "
+                    "before position " + std::to_string(next) +
+                    " was armed").c_str());
+                break;
+            }
+            triggered = true;
+        }
+
+        if (bits & MotorDrive::StatusBitsInMotion)
+            continue;
+
+        // Consider the stage to have arrived when it is closer to the armed
+        // target than to the previous position. This tolerates the small
+        // final position error of servo motors.
+        long from = sequence_[current];
+        long to = sequence_[next];
+        if (2 * std::abs(pos - to) >= std::abs(to - from))
+            continue;
+
+        current = next;
+        next = (next + 1) % n;
+        short err = motorDrive_->SetMoveAbsolutePosition(
+            clamp_int(sequence_[next]));
+        if (err) {
+            // Further triggers would replay the old target
+            LogMessage(("Stage sequence stopped: failed to arm position " +
+                std::to_string(next) + " (error " + std::to_string(err) +
+                ")").c_str());
+            break;
+        }
+        triggered = false;
+    }
+}
+
+
+void
+SingleAxisStage::RunSoftwareSequence() {
+    // Each step is started by this thread, so keep its latency low when the
+    // computer is busy (e.g. saving images)
+    SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_HIGHEST);
+
+    // The input is read from the driver's polled status bits directly (not
+    // the snapshot, which would add up to another interval of delay). A
+    // pulse that is high, or low, for at least twice the polling interval
+    // is always seen as long as this thread samples once per interval; if
+    // the thread falls further behind, a step may have been lost and the
+    // remaining positions would no longer match the camera frames.
+    auto const readInput = [this] {
+        return (motorDrive_->GetStatusBits() &
+            MotorDrive::StatusBitsDigitalInput1) != 0;
+    };
+
+    size_t const n = sequence_.size();
+    size_t current = 0;
+    bool inputWasHigh = readInput();
+    auto lastSample = std::chrono::steady_clock::now();
+
+    std::unique_lock<std::mutex> lock(sequenceMutex_);
+    while (!sequenceStopRequested_) {
+        int const intervalMs = activePollingIntervalMs_.load();
+        sequenceCondition_.wait_for(lock,
+            std::chrono::milliseconds(intervalMs));
+        if (sequenceStopRequested_)
+            break;
+
+        auto const now = std::chrono::steady_clock::now();
+        auto const gapMs = std::chrono::duration_cast<
+            std::chrono::milliseconds>(now - lastSample).count();
+        lastSample = now;
+        if (gapMs > 2 * intervalMs) {
+            LogMessage(("Software sequence stopped: digital input not sampled "
+                "for " + std::to_string(gapMs) + " ms (polling interval " +
+                std::to_string(intervalMs) + " ms); a trigger may have " +
+                "been missed").c_str());
+            break;
+        }
+
+        bool const inputHigh = readInput();
+        bool const risingEdge = inputHigh && !inputWasHigh;
+        inputWasHigh = inputHigh;
+        if (!risingEdge)
+            continue;
+
+        // A step that arrives before the previous move has finished
+        // retargets that move
+        current = (current + 1) % n;
+        int ret;
+        {
+            std::lock_guard<std::mutex> moveLock(moveMutex_);
+            ret = SendMoveLocked(clamp_int(sequence_[current]));
+        }
+        if (ret != DEVICE_OK) {
+            LogMessage(("Failed to move to next sequence position (error " +
+                std::to_string(ret) + ")").c_str());
+        }
+    }
+}
+
+
+void
+SingleAxisStage::SetActivePollingInterval(int intervalMs) {
+    if (intervalMs == activePollingIntervalMs_)
+        return;
+
+    // Calling StartPolling while already polling changes the interval
+    bool ok = motorDrive_->StartPolling(intervalMs);
+    if (!ok) {
+        LogMessage(("Failed to change polling interval for serial no " +
+            serialNo_).c_str());
+        return;
+    }
+    activePollingIntervalMs_ = intervalMs;
+}
+
+
+// Return to the idle polling rate if adaptive and nothing needs the fast
+// rate any more. Must hold moveMutex_.
+void
+SingleAxisStage::RestoreIdlePollingLocked() {
+    if (!adaptivePolling_ || sequenceActive_ || scanning_)
+        return;
+    if (movePending_ || approachPending_ || IsMoving())
+        return;
+    SetActivePollingInterval(pollingIntervalMs_);
+}
+
+
+void
+SingleAxisStage::StopSequenceThread() {
+    if (!sequenceThread_.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(sequenceMutex_);
+        sequenceStopRequested_ = true;
+    }
+    sequenceCondition_.notify_one();
+    sequenceThread_.join();
+}
+
+
+long
+SingleAxisStage::UmToSteps(double pos) const {
+    double dSteps = std::round(pos * deviceUnitsPerUm_);
+    return clamp_int(dSteps);
+}
+
+
 std::unique_ptr<MotorDrive>
 SingleAxisStage::Connect() const {
     auto connection = MakeConnection(serialNo_);
@@ -373,27 +2523,37 @@ SingleAxisStage::Connect() const {
 }
 
 
+std::string
+SingleAxisStage::MakeNameFromInventory() const {
+    DeviceInventoryEntry entry;
+    if (!inventory_ || !inventory_->Find(serialNo_, entry))
+        return {};
+
+    if (entry.connectionError) {
+        return MakeDeviceName("Error" + std::to_string(entry.connectionError),
+            serialNo_, channel_);
+    }
+
+    auto info = entry.ChannelHardwareInfo(channel_);
+    if (!info || info->modelNo.empty())
+        return {};
+    return MakeDeviceName(info->modelNo, serialNo_, channel_);
+}
+
+
 std::string
 SingleAxisStage::MakeName(MotorDrive* motorDrive) const {
-    std::string name;
+    std::string modelNo;
 
     if (motorDrive && motorDrive->GetConnection()->IsValid()) {
-        name += motorDrive->GetModelNo();
+        modelNo = motorDrive->GetModelNo();
     }
     else {
-        name += "Error";
+        modelNo = "Error";
         if (motorDrive) {
-            name += std::to_string(motorDrive->GetConnection()->ConnectionError());
+            modelNo += std::to_string(motorDrive->GetConnection()->ConnectionError());
         }
     }
 
-    name += '_';
-    name += serialNo_;
-
-    if (channel_ > 0) {
-        name += '-';
-        name += std::to_string(channel_);
-    }
-
-    return name;
+    return MakeDeviceName(modelNo, serialNo_, channel_);
 }
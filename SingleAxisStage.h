@@ -32,14 +32,26 @@
 
 #pragma once
 
+#include "DeviceInventory.h"
+#include "HomedStateStore.h"
 #include "KinesisDevice.h"
+#include "StageStatistics.h"
+#include "StageRegistry.h"
+#include "TrajectoryRecorder.h"
 
 #include "DeviceBase.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 
-class SingleAxisStage final : public CStageBase<SingleAxisStage> {
+class SingleAxisStage final : public CStageBase<SingleAxisStage>,
+    public RegisteredStage {
     std::string const serialNo_;
     short const channel_;
 
@@ -51,19 +63,140 @@ class SingleAxisStage final : public CStageBase<SingleAxisStage> {
     // connection is kept instead of creating a new one when needed.
     std::shared_ptr<KinesisDeviceConnection> retainedConnection_;
 
-    // Set during Initialize():
+    // Hub's cache of device info; passed in when created by the Hub during
+    // hardware configuration, otherwise obtained from the parent Hub during
+    // Initialize() (may be null).
+    std::shared_ptr<DeviceInventory> inventory_;
+
+    // The parent Hub's homed state file, if enabled (obtained during
+    // Initialize())
+    std::shared_ptr<HomedStateStore> homedStateStore_;
+
+    // Whether we are registered with the parent Hub (for HomeAll)
+    bool registeredWithHub_{ false };
+
+    // With ConnectOnFirstUse, the drive is connected (and the rest of the
+    // state below set up) by a background thread started by the first
+    // command; motorDrive_ may only be used once connected_ is set. Moves
+    // requested meanwhile are deferred as pending moves.
+    bool connectOnFirstUse_{ false };
+    std::atomic<bool> connected_{ false };
+    std::thread connectThread_;
+    std::mutex connectMutex_;
+    std::condition_variable connectCondition_;
+    bool connecting_{ false };
+    int connectError_{ DEVICE_OK }; // Of the last attempt
+
+    // Set during Initialize() (or when connecting):
     std::unique_ptr<MotorDrive> motorDrive_;
     bool isRotational_{ false };
     double deviceUnitsPerUm_{ 100.0 }; // Per degree if rotational
-    int pollingIntervalMs_{ 50 };
+    int pollingIntervalMs_{ 50 }; // Idle interval if adaptive
+    bool adaptivePolling_{ false };
+    int movingPollingIntervalMs_{ 10 };
     bool didEnable_{ false };
+    double profileMaxVelocity_{ 0.0 }; // Device units/s; 0 if unknown
+    double profileAcceleration_{ 0.0 }; // Device units/s^2
+
+    // Created when recording is first turned on; destroyed before
+    // motorDrive_
+    std::unique_ptr<TrajectoryRecorder> trajectoryRecorder_;
 
     // Dynamic state:
     MM::MMTime lastMovementStart_{ 0.0 };
+    std::atomic<int> activePollingIntervalMs_{ 50 };
+    std::atomic<double> estimatedMoveTimeMs_{ 0.0 }; // Of the last move
+    // Positions older than this are read from the device (0: use the polled
+    // position, however old)
+    std::atomic<double> positionMaxAgeMs_{ 0.0 };
+
+    // In-position window: with encoder feedback, an absolute move is
+    // reported finished once the encoder has stayed within the tolerance of
+    // the target for the dwell time, without waiting for the controller's
+    // settling period. Disabled when the tolerance is 0.
+    enum SettleState { SettleNone, SettleWaiting, SettleReleased };
+    bool hasEncoder_{ false };
+    double settleToleranceUm_{ 0.0 }; // Degrees if rotational
+    double settleDwellMs_{ 10.0 };
+    SettleState settleState_{ SettleNone };
+    long settleTarget_{ 0 };
+    bool settleInWindow_{ false };
+    MM::MMTime settleWindowEntered_{ 0.0 };
+
+    // Move coalescing: absolute moves requested within the window after the
+    // previous move are not sent immediately; the background thread sends
+    // the latest target when the window ends. Guards the move state above
+    // against the coalescing thread.
+    std::mutex moveMutex_;
+    std::condition_variable moveCondition_;
+    std::thread coalescingThread_;
+    int coalescingWindowMs_{ 0 };
+    std::chrono::steady_clock::time_point lastMoveSent_{};
+    bool movePending_{ false };
+    int pendingTarget_{ 0 };
+    int deferredMoveError_{ DEVICE_OK };
+    bool coalescingStopRequested_{ false };
+    // Set by the motion-completed handler (which must not take moveMutex_);
+    // the coalescing thread then restores the idle polling rate
+    std::atomic<bool> idlePollingDue_{ false };
+
+    // Approach planner: an absolute move against the approach direction is
+    // split into a move past the target by the overshoot and a second move
+    // to the target, which the coalescing thread sends as soon as the first
+    // has finished (guarded by moveMutex_).
+    int approachDirection_{ 0 }; // +1 forwards, -1 backwards, 0 any
+    double approachOvershootUm_{ 0.0 }; // Degrees if rotational
+    bool approachPending_{ false };
+    int approachTarget_{ 0 };
+
+    // Stage sequence, in device units. The sequence is run by putting trigger
+    // port 1 in absolute-move mode; a background thread arms the next
+    // position each time the stage arrives at the previous one (woken by the
+    // controller's move-completed message, or by timeout). The stage is only
+    // reported sequenceable when HardwareSequencing is on.
+    bool hardwareSequencing_{ false };
+    std::vector<long> pendingSequence_;
+    std::vector<long> sequence_;
+    MotorDrive::TriggerConfig savedTriggerConfig_{};
+    std::thread sequenceThread_;
+    std::mutex sequenceMutex_;
+    std::condition_variable sequenceCondition_;
+    bool sequenceStopRequested_{ false };
+    // Whether a sequence is running; read instead of sequenceThread_ by code
+    // that may run on other threads (Busy(), the coalescing thread)
+    std::atomic<bool> sequenceActive_{ false };
+
+    // Controllers without trigger ports can optionally run the sequence in
+    // software: a high-priority thread moves to the next position on each
+    // rising edge of digital input 1, as seen in the polled status bits.
+    bool softwareSequencing_{ false };
+    bool softwareSequenceRunning_{ false };
+
+    // Constant-velocity scan. A background thread runs up to speed before
+    // the start position, moves at velocity while trigger port 2 pulses at
+    // each pitch, and stops past the stop position. The thread shares
+    // sequenceMutex_ and sequenceCondition_ (woken by motion events).
+    struct ScanPlan {
+        int runUpPosition;
+        int stopPosition;
+        MotorDrive::TravelDirection direction;
+        int acceleration; // Velocity parameters during the scan
+        int maxVelocity;
+        MotorDrive::TriggerPositionParams triggers;
+    };
+    std::thread scanThread_;
+    bool scanStopRequested_{ false };
+    std::atomic<bool> scanning_{ false };
+
+    // Performance counters. A move is timed from when it is sent until
+    // Busy() first reports idle (guarded by moveMutex_).
+    StageStatistics statistics_;
+    bool moveTimingPending_{ false };
 
 public:
     SingleAxisStage(std::string const& name, std::string const& serialNo,
-        short channel, std::shared_ptr<KinesisDeviceConnection> connection);
+        short channel, std::shared_ptr<KinesisDeviceConnection> connection,
+        std::shared_ptr<DeviceInventory> inventory = {});
     ~SingleAxisStage() override;
 
     int Initialize() override;    
@@ -76,19 +209,98 @@ public:
     int SetPositionUm(double pos) override;
     int GetPositionSteps(long& steps) override;
     int SetPositionSteps(long steps) override;
+    int SetRelativePositionUm(double d) override;
+    int SetRelativePositionSteps(long steps);
     int SetOrigin() override { return DEVICE_UNSUPPORTED_COMMAND; }
     int GetLimits(double&, double&) override { return DEVICE_UNSUPPORTED_COMMAND; }
     int Home();
+    int Stop() override;
+
+    // RegisteredStage
+    int StartHoming() override { return Home(); }
+    bool IsBusy() override { return IsMovingNow(); }
+    bool IsHomed() override;
+    std::string StageName() const override;
 
     bool IsContinuousFocusDrive() const override { return false; }
-    int IsStageSequenceable(bool& f) const override { f = false; return DEVICE_OK; }
+    int IsStageSequenceable(bool& f) const override;
+    int GetStageSequenceMaxLength(long& nrEvents) const override;
+    int StartStageSequence() override;
+    int StopStageSequence() override;
+    int ClearStageSequence() override;
+    int AddToStageSequence(double position) override;
+    int SendStageSequence() override;
 
     //Action interface
     int OnPositionChange(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnEstimatedMoveTime(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnHomed(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnForceHome(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTrajectoryRecording(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTrajectorySave(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTriggerPortMode(MM::PropertyBase* pProp, MM::ActionType eAct,
+        long port);
+    int OnTriggerPortPolarity(MM::PropertyBase* pProp, MM::ActionType eAct,
+        long port);
+    int OnTriggerMoveRelative(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTriggerMoveAbsolute(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnTriggerOutput(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSettleTolerance(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSettleDwell(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnMoveCoalescingWindow(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnApproachDirection(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnApproachOvershoot(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnVelocityInEffect(MM::PropertyBase* pProp, MM::ActionType eAct,
+        long which);
+    int OnConnectOnFirstUse(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnHardwareSequencing(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnSoftwareSequencing(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnScan(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnPositionMaxAge(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnStatistic(MM::PropertyBase* pProp, MM::ActionType eAct, long which);
+    int OnStatisticsReport(MM::PropertyBase* pProp, MM::ActionType eAct);
 
 private:
     std::unique_ptr<MotorDrive> Connect() const;
+    int ConnectAndWarmUp();
+    void StartConnecting();
+    void RunConnect();
+    int AwaitConnection();
+    void JoinConnectThread();
+    void UnregisterFromHub();
+    void RestoreHomedState();
+    void SaveHomedState();
+    std::string MakeNameFromInventory() const;
     std::string MakeName(MotorDrive* motorDrive) const;    
+    long UmToSteps(double pos) const;
+    int ApplyVelocityProfile();
+    double DeviceUnitsPerMmOrDegree() const;
+    bool IsMoving();
+    bool IsMovingNow();
+    bool HasSettled();
+    int SendMoveLocked(int steps);
+    int SendPlannedMoveLocked(int steps);
+    void StartCoalescingThreadLocked();
+    void NoteMoveSentLocked();
+    void NoteIdleLocked();
+    int KinesisError(short err);
+    int CreateStatisticsProperties();
+    void RunMoveCoalescing();
+    void StopCoalescingThread();
+    void EstimateMoveTime(double distance);
+    int SaveTrajectory();
+    int CreateTriggerProperties();
+    int ModifyTriggerConfig(long port, MotorDrive::TriggerPortMode const* mode,
+        MotorDrive::TriggerPortPolarity const* polarity);
+    void SetActivePollingInterval(int intervalMs);
+    void RestoreIdlePollingLocked();
+    void RunSequence();
+    void RunSoftwareSequence();
+    int CreateScanProperties();
+    int StartScan();
+    void RunScan(ScanPlan plan);
+    void StopScan();
+    void StopSequenceThread();
     bool initialized_;
     bool homed_;
 };
@@ -0,0 +1,145 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "StageStatistics.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+
+namespace {
+    template <typename Ring>
+    void Add(Ring& ring, double value) {
+        ring.samples[ring.count % ring.samples.size()] = value;
+        ++ring.count;
+    }
+
+    template <typename Ring>
+    std::vector<double> Contents(Ring const& ring) {
+        size_t const n = std::min(ring.count, ring.samples.size());
+        return std::vector<double>(ring.samples.begin(),
+            ring.samples.begin() + n);
+    }
+
+    double Mean(std::vector<double> const& values) {
+        if (values.empty())
+            return 0.0;
+        double sum = 0.0;
+        for (double v : values)
+            sum += v;
+        return sum / values.size();
+    }
+
+    double Max(std::vector<double> const& values) {
+        if (values.empty())
+            return 0.0;
+        return *std::max_element(values.begin(), values.end());
+    }
+
+    // Nearest-rank percentile; reorders the values
+    double Percentile(std::vector<double>& values, double fraction) {
+        if (values.empty())
+            return 0.0;
+        size_t rank = static_cast<size_t>(
+            std::ceil(fraction * values.size()));
+        rank = std::max<size_t>(rank, 1) - 1;
+        std::nth_element(values.begin(), values.begin() + rank, values.end());
+        return values[rank];
+    }
+}
+
+
+void
+StageStatistics::RecordMoveTime(double ms) {
+    std::lock_guard<std::mutex> lock(sampleMutex_);
+    Add(moveTimes_, ms);
+}
+
+
+void
+StageStatistics::RecordIdleLatency(double ms) {
+    std::lock_guard<std::mutex> lock(sampleMutex_);
+    Add(latencies_, ms);
+}
+
+
+StageStatistics::Summary
+StageStatistics::GetSummary() const {
+    Summary ret{};
+    ret.movesIssued = movesIssued_;
+    ret.busyQueries = busyQueries_;
+    ret.errors = errors_;
+
+    std::vector<double> moveTimes, latencies;
+    {
+        std::lock_guard<std::mutex> lock(sampleMutex_);
+        moveTimes = Contents(moveTimes_);
+        latencies = Contents(latencies_);
+    }
+    ret.timedMoves = moveTimes.size();
+    ret.meanMoveMs = Mean(moveTimes);
+    ret.maxMoveMs = Max(moveTimes);
+    ret.p95MoveMs = Percentile(moveTimes, 0.95);
+    ret.latencySamples = latencies.size();
+    ret.meanLatencyMs = Mean(latencies);
+    ret.maxLatencyMs = Max(latencies);
+    return ret;
+}
+
+
+void
+StageStatistics::Reset() {
+    movesIssued_ = 0;
+    busyQueries_ = 0;
+    errors_ = 0;
+    std::lock_guard<std::mutex> lock(sampleMutex_);
+    moveTimes_ = SampleRing{};
+    latencies_ = SampleRing{};
+}
+
+
+std::string
+StageStatistics::FormatSummary(Summary const& s) {
+    char buf[512];
+    std::snprintf(buf, sizeof(buf),
+        "moves %llu, Busy() queries %llu, errors %llu; "
+        "move time (last %zu) mean %.1f ms, p95 %.1f ms, max %.1f ms; "
+        "idle latency (last %zu) mean %.1f ms, max %.1f ms",
+        static_cast<unsigned long long>(s.movesIssued),
+        static_cast<unsigned long long>(s.busyQueries),
+        static_cast<unsigned long long>(s.errors),
+        s.timedMoves, s.meanMoveMs, s.p95MoveMs, s.maxMoveMs,
+        s.latencySamples, s.meanLatencyMs, s.maxLatencyMs);
+    return buf;
+}
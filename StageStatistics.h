@@ -0,0 +1,95 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+
+// Live performance counters of one stage, shown as read-only properties so
+// that a degrading stage can be spotted without a profiler. Counting is
+// lock-free; the timing samples of the most recent moves are kept in a ring
+// so that the summary follows changes in behavior (e.g. settle time slowly
+// increasing) rather than averaging over the whole session.
+class StageStatistics {
+public:
+    static size_t const NumMoveSamples = 256;
+
+    struct Summary {
+        std::uint64_t movesIssued;
+        std::uint64_t busyQueries;
+        std::uint64_t errors;
+        // Over the most recent timed moves (0 if none)
+        size_t timedMoves;
+        double meanMoveMs;
+        double p95MoveMs;
+        double maxMoveMs;
+        size_t latencySamples;
+        double meanLatencyMs;
+        double maxLatencyMs;
+    };
+
+private:
+    std::atomic<std::uint64_t> movesIssued_{ 0 };
+    std::atomic<std::uint64_t> busyQueries_{ 0 };
+    std::atomic<std::uint64_t> errors_{ 0 };
+
+    struct SampleRing {
+        std::array<double, NumMoveSamples> samples{};
+        size_t count = 0; // Total recorded; the ring holds the last N
+    };
+    mutable std::mutex sampleMutex_;
+    SampleRing moveTimes_;
+    SampleRing latencies_;
+
+public:
+    void CountMove() { ++movesIssued_; }
+    void CountBusyQuery() { ++busyQueries_; }
+    void CountError() { ++errors_; }
+
+    // Time from sending a move to the first Busy() reporting idle
+    void RecordMoveTime(double ms);
+    // Time from the controller's move-completed message to the first Busy()
+    // reporting idle
+    void RecordIdleLatency(double ms);
+
+    Summary GetSummary() const;
+    void Reset();
+
+    // One-line summary for the CoreLog
+    static std::string FormatSummary(Summary const& summary);
+};
@@ -32,187 +32,12 @@
 
 #include "TCubeDCServo.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.TCube.DCServo.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.TCube.DCServo.dll" };
-
-
-bool
-TCubeDCServoAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-TCubeDCServoAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, CC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServoAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, CC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-TCubeDCServo::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, CC_RequestSettings, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, CC_RequestStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-bool
-TCubeDCServo::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, CC_StartPolling, func);
-    return func(CSerialNo(), intervalMs);
-}
-
-
-void
-TCubeDCServo::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, CC_StopPolling, func);
-    func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, CC_GetHardwareInfo, func);
-    return func(CSerialNo(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-TCubeDCServo::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, CC_GetStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, CC_EnableChannel, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, CC_DisableChannel, func);
-    return func(CSerialNo());
-}
-
-
-int
-TCubeDCServo::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, CC_GetMotorTravelMode, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, CC_SetMotorTravelMode, func);
-    return func(CSerialNo(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-TCubeDCServo::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, CC_ResetRotationModes, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, CC_SetRotationModes, func);
-    return func(CSerialNo(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-
-short
-TCubeDCServo::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, CC_RequestPosition, func);
-    return func(CSerialNo());
-}
-
-
-int
-TCubeDCServo::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, CC_GetPosition, func);
-    return func(CSerialNo());
-}
-
-
-long
-TCubeDCServo::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, CC_GetPositionCounter, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, CC_MoveToPosition, func);
-    return func(CSerialNo(), index);
-}
-
-
-bool
-TCubeDCServo::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, CC_CanHome, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, CC_Home, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeDCServo::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, CC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), deviceUnits, realValue, unitType);
-}
-
-
-short
-TCubeDCServo::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, CC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), realValue, deviceUnits, unitType);
-}
-
-
-long
-TCubeDCServo::Kinesis_GetEncoderCounter() {
-    STATIC_DLL_FUNC(kinesisDll, CC_GetEncoderCounter, func);
-    return func(CSerialNo());
-}
+#define KINESIS_FAMILY TCubeDCServo
+#define KINESIS_FUNC(name) CC_##name
+#define KINESIS_DLL_TYPE_ID TypeIDTCubeDCServo
+#define KINESIS_HAS_ROTATION_MODES 1
+#define KINESIS_HAS_ENCODER 1
+#include "MotorDriveFamily.inl"
@@ -32,180 +32,21 @@
 
 #include "TCubeStepper.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.TCube.StepperMotor.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.TCube.StepperMotor.dll" };
-
-
-bool
-TCubeStepperAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-TCubeStepperAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepperAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-TCubeStepper::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_RequestSettings, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_RequestStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-bool
-TCubeStepper::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, SCC_StartPolling, func);
-    return func(CSerialNo(), intervalMs);
-}
-
-
-void
-TCubeStepper::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_StopPolling, func);
-    func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetHardwareInfo, func);
-    return func(CSerialNo(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-TCubeStepper::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_EnableChannel, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_DisableChannel, func);
-    return func(CSerialNo());
-}
-
-
-int
-TCubeStepper::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetMotorTravelMode, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, SCC_SetMotorTravelMode, func);
-    return func(CSerialNo(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-TCubeStepper::Kinesis_ResetRotationModes() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_ResetRotationModes, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_SetRotationModes(int mode, int direction) {
-    STATIC_DLL_FUNC(kinesisDll, SCC_SetRotationModes, func);
-    return func(CSerialNo(), static_cast<MOT_MovementModes>(mode),
-        static_cast<MOT_MovementDirections>(direction));
-}
-
-
-short
-TCubeStepper::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_RequestPosition, func);
-    return func(CSerialNo());
-}
-
-
-int
-TCubeStepper::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetPosition, func);
-    return func(CSerialNo());
-}
-
-
-long
-TCubeStepper::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetPositionCounter, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, SCC_MoveToPosition, func);
-    return func(CSerialNo(), index);
-}
-
-
-bool
-TCubeStepper::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_CanHome, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, SCC_Home, func);
-    return func(CSerialNo());
-}
-
-
-short
-TCubeStepper::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), deviceUnits, realValue, unitType);
-}
-
+#define KINESIS_FAMILY TCubeStepper
+#define KINESIS_FUNC(name) SCC_##name
+#define KINESIS_DLL_TYPE_ID TypeIDTCubeStepper
+#define KINESIS_HAS_ROTATION_MODES 1
+#include "MotorDriveFamily.inl"
 
-short
-TCubeStepper::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
 
-    STATIC_DLL_FUNC(kinesisDll, SCC_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), realValue, deviceUnits, unitType);
+MotionScale
+TCubeStepper::GetMotionScale() {
+    // Older controllers take velocity and acceleration in microsteps
+    std::string modelNo = GetModelNo();
+    if (modelNo.compare(0, 6, "TST001") == 0)
+        return MotionScales::LegacyStepper;
+    return MotionScales::Stepper;
 }
@@ -0,0 +1,174 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "TrajectoryRecorder.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+
+TrajectoryRecorder::TrajectoryRecorder(MotorDrive& motorDrive,
+    std::size_t capacity, int intervalMs) :
+    motorDrive_{ motorDrive },
+    encoderDrive_{ dynamic_cast<NonStepperMotorDrive*>(&motorDrive) },
+    intervalMs_{ std::max(intervalMs, 1) },
+    capacity_{ std::max<std::size_t>(capacity, 1) },
+    slots_{ new Slot[capacity_] }
+{}
+
+
+void
+TrajectoryRecorder::Start() {
+    if (IsRunning())
+        return;
+
+    for (std::size_t i = 0; i < capacity_; ++i)
+        slots_[i].seq.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_release);
+
+    stopRequested_ = false;
+    startTime_ = std::chrono::steady_clock::now();
+    thread_ = std::thread([this] { Run(); });
+}
+
+
+void
+TrajectoryRecorder::Stop() {
+    if (!IsRunning())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(stopMutex_);
+        stopRequested_ = true;
+    }
+    stopCondition_.notify_all();
+    thread_.join();
+}
+
+
+void
+TrajectoryRecorder::Run() {
+    auto const interval = std::chrono::milliseconds(intervalMs_);
+    auto next = startTime_;
+
+    std::unique_lock<std::mutex> lock(stopMutex_);
+    while (!stopRequested_) {
+        lock.unlock();
+        auto const now = std::chrono::steady_clock::now();
+        Record(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            now - startTime_).count());
+        lock.lock();
+
+        // Keep to a fixed schedule, but skip samples rather than bunching
+        // them up if we fall behind
+        next += interval;
+        if (next < now)
+            next = now + interval;
+        stopCondition_.wait_until(lock, next, [this] { return stopRequested_; });
+    }
+}
+
+
+void
+TrajectoryRecorder::Record(std::int64_t timeNs) {
+    // Only this thread writes, so count_ is ours to advance
+    std::uint64_t const index = count_.load(std::memory_order_relaxed);
+    Slot& slot = slots_[index % capacity_];
+
+    DWORD const statusBits = motorDrive_.GetStatusBits();
+    long const position = motorDrive_.GetPositionCounter();
+    long const encoderCount = encoderDrive_ ?
+        encoderDrive_->GetEncoderCounter() : 0;
+
+    slot.seq.store(2 * index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.timeNs.store(timeNs, std::memory_order_relaxed);
+    slot.position.store(position, std::memory_order_relaxed);
+    slot.encoderCount.store(encoderCount, std::memory_order_relaxed);
+    slot.statusBits.store(statusBits, std::memory_order_relaxed);
+    slot.seq.store(2 * index + 2, std::memory_order_release);
+
+    count_.store(index + 1, std::memory_order_release);
+}
+
+
+std::vector<TrajectoryRecorder::Sample>
+TrajectoryRecorder::GetSamples(double windowMs) const {
+    std::uint64_t const end = count_.load(std::memory_order_acquire);
+    std::uint64_t const begin = end > capacity_ ? end - capacity_ : 0;
+
+    std::vector<Sample> samples;
+    samples.reserve(static_cast<std::size_t>(end - begin));
+    for (std::uint64_t index = begin; index < end; ++index) {
+        Slot const& slot = slots_[index % capacity_];
+        std::uint64_t const seq = slot.seq.load(std::memory_order_acquire);
+        if (seq != 2 * index + 2)
+            continue; // Already overwritten
+        Sample sample;
+        sample.timeMs = slot.timeNs.load(std::memory_order_relaxed) / 1e6;
+        sample.position = slot.position.load(std::memory_order_relaxed);
+        sample.encoderCount = slot.encoderCount.load(std::memory_order_relaxed);
+        sample.statusBits = slot.statusBits.load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != seq)
+            continue; // Overwritten while we were reading it
+        samples.push_back(sample);
+    }
+
+    if (windowMs > 0.0 && !samples.empty()) {
+        double const startMs = samples.back().timeMs - windowMs;
+        samples.erase(samples.begin(), std::find_if(samples.begin(),
+            samples.end(), [&](Sample const& s) { return s.timeMs >= startMs; }));
+    }
+    return samples;
+}
+
+
+bool
+TrajectoryRecorder::SaveCSV(std::string const& path,
+    std::vector<Sample> const& samples, double deviceUnitsPerUnit,
+    std::string const& unitName) {
+    std::ofstream file(path);
+    if (!file)
+        return false;
+
+    file << "TimeMs,Position,Position_" << unitName <<
+        ",EncoderCount,StatusBits\n";
+    for (Sample const& s : samples) {
+        char line[128];
+        std::snprintf(line, sizeof(line), "%.3f,%ld,%.4f,%ld,0x%08lX\n",
+            s.timeMs, s.position, s.position / deviceUnitsPerUnit,
+            s.encoderCount, static_cast<unsigned long>(s.statusBits));
+        file << line;
+    }
+    return static_cast<bool>(file);
+}
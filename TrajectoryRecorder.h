@@ -0,0 +1,111 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "KinesisDevice.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+// Background sampling of a motor drive's position, encoder count, and status
+// bits, for diagnosing settling and overshoot. Samples go into a fixed-size
+// ring buffer (allocated up front), overwriting the oldest. Writing a sample
+// does not allocate or take a lock (the sampling thread only locks its stop
+// mutex to sleep between samples, and readers never take it); readers copy
+// out a window and discard any slot that was overwritten while being read.
+class TrajectoryRecorder {
+public:
+    struct Sample {
+        double timeMs; // Since the recorder was started
+        long position; // Position counter
+        long encoderCount; // 0 if the device has no encoder
+        DWORD statusBits;
+    };
+
+private:
+    // Sequence lock: seq is odd while the slot is being written, and
+    // 2 * (index + 1) once sample number index is complete.
+    struct Slot {
+        std::atomic<std::uint64_t> seq{ 0 };
+        std::atomic<std::int64_t> timeNs{ 0 };
+        std::atomic<long> position{ 0 };
+        std::atomic<long> encoderCount{ 0 };
+        std::atomic<DWORD> statusBits{ 0 };
+    };
+
+    MotorDrive& motorDrive_;
+    NonStepperMotorDrive* const encoderDrive_; // Null if no encoder
+    int const intervalMs_;
+    std::size_t const capacity_;
+    std::unique_ptr<Slot[]> const slots_;
+    std::atomic<std::uint64_t> count_{ 0 }; // Samples written so far
+
+    std::chrono::steady_clock::time_point startTime_;
+    std::thread thread_;
+    std::mutex stopMutex_;
+    std::condition_variable stopCondition_;
+    bool stopRequested_ = false;
+
+public:
+    // motorDrive must outlive the recorder
+    TrajectoryRecorder(MotorDrive& motorDrive, std::size_t capacity,
+        int intervalMs);
+    ~TrajectoryRecorder() { Stop(); }
+
+    // Start() also clears any previous samples
+    void Start();
+    void Stop();
+    bool IsRunning() const { return thread_.joinable(); }
+
+    // Samples from the last windowMs (all if windowMs <= 0), oldest first
+    std::vector<Sample> GetSamples(double windowMs) const;
+
+    // Write samples as CSV, with the position also converted to physical
+    // units (unitName is used in the column header). Returns false if the
+    // file could not be written.
+    static bool SaveCSV(std::string const& path,
+        std::vector<Sample> const& samples, double deviceUnitsPerUnit,
+        std::string const& unitName);
+
+private:
+    void Run();
+    void Record(std::int64_t timeNs);
+};
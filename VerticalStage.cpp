@@ -32,184 +32,11 @@
 
 #include "VerticalStage.h"
 
-#include "DLLAccess.h"
-
 #include "Thorlabs.MotionControl.VerticalStage.h"
 
 
-static DLLAccess kinesisDll{ "Thorlabs.MotionControl.VerticalStage.dll" };
-
-
-bool
-VerticalStageAccess::IsKinesisDriverAvailable() {
-    return kinesisDll.IsValid();
-}
-
-
-short
-VerticalStageAccess::Kinesis_Open() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_Open, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStageAccess::Kinesis_Close() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_Close, func);
-    func(CSerialNo());
-    return 0;
-}
-
-
-short
-VerticalStage::Kinesis_RequestSettings() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_RequestSettings, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_RequestStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_RequestStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-bool
-VerticalStage::Kinesis_StartPolling(int intervalMs) {
-    STATIC_DLL_FUNC(kinesisDll, KVS_StartPolling, func);
-    return func(CSerialNo(), intervalMs);
-}
-
-
-void
-VerticalStage::Kinesis_StopPolling() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_StopPolling, func);
-    func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_GetHardwareInfo(char* modelNo, DWORD sizeOfModelNo,
-    WORD* type, WORD* numChannels, char* notes, DWORD sizeOfNotes,
-    DWORD* firmwareVersion, WORD* hardwareVersion, WORD* modificationState) {
-
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetHardwareInfo, func);
-    return func(CSerialNo(), modelNo, sizeOfModelNo,
-        type, numChannels, notes, sizeOfNotes, firmwareVersion,
-        hardwareVersion, modificationState);
-}
-
-
-DWORD
-VerticalStage::Kinesis_GetStatusBits() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetStatusBits, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_EnableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_EnableChannel, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_DisableChannel() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_DisableChannel, func);
-    return func(CSerialNo());
-}
-
-
-int
-VerticalStage::Kinesis_GetMotorTravelMode() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetMotorTravelMode, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_SetMotorTravelMode(int mode) {
-    STATIC_DLL_FUNC(kinesisDll, KVS_SetMotorTravelMode, func);
-    return func(CSerialNo(), static_cast<MOT_TravelModes>(mode));
-}
-
-
-short
-VerticalStage::Kinesis_ResetRotationModes() {
-    return 18;
-}
-
-
-short
-VerticalStage::Kinesis_SetRotationModes(int, int) {
-    return 18;
-}
-
-
-short
-VerticalStage::Kinesis_RequestPosition() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_RequestPosition, func);
-    return func(CSerialNo());
-}
-
-
-int
-VerticalStage::Kinesis_GetPosition() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetPosition, func);
-    return func(CSerialNo());
-}
-
-
-long
-VerticalStage::Kinesis_GetPositionCounter() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetPositionCounter, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_MoveToPosition(int index) {
-    STATIC_DLL_FUNC(kinesisDll, KVS_MoveToPosition, func);
-    return func(CSerialNo(), index);
-}
-
-
-bool
-VerticalStage::Kinesis_CanHome() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_CanHome, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_Home() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_Home, func);
-    return func(CSerialNo());
-}
-
-
-short
-VerticalStage::Kinesis_GetRealValueFromDeviceUnit(int deviceUnits,
-    double* realValue, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetRealValueFromDeviceUnit, func);
-    return func(CSerialNo(), deviceUnits, realValue, unitType);
-}
-
-
-short
-VerticalStage::Kinesis_GetDeviceUnitFromRealValue(double realValue,
-    int* deviceUnits, int unitType) {
-
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetDeviceUnitFromRealValue, func);
-    return func(CSerialNo(), realValue, deviceUnits, unitType);
-}
-
-
-long
-VerticalStage::Kinesis_GetEncoderCounter() {
-    STATIC_DLL_FUNC(kinesisDll, KVS_GetEncoderCounter, func);
-    return func(CSerialNo());
-}
+#define KINESIS_FAMILY VerticalStage
+#define KINESIS_FUNC(name) KVS_##name
+#define KINESIS_DLL_TYPE_ID TypeIDVerticalStage
+#define KINESIS_HAS_ENCODER 1
+#include "MotorDriveFamily.inl"
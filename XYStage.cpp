@@ -0,0 +1,372 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#include "XYStage.h"
+
+#include "Clamp.h"
+#include "Connections.h"
+#include "DeviceEnumeration.h"
+#include "DeviceInstantiation.h"
+#include "Errors.h"
+#include "MotorDriveSetup.h"
+
+#include <utility>
+
+
+namespace {
+    char const* const PROP_XSerialNo = "XSerialNo";
+    char const* const PROP_XChannel = "XChannel";
+    char const* const PROP_XDeviceUnitsPerMillimeter = "XDeviceUnitsPerMillimeter";
+    char const* const PROP_YSerialNo = "YSerialNo";
+    char const* const PROP_YChannel = "YChannel";
+    char const* const PROP_YDeviceUnitsPerMillimeter = "YDeviceUnitsPerMillimeter";
+    char const* const PROP_PollingIntervalMs = "PollingIntervalMs";
+}
+
+
+XYStage::XYStage(std::shared_ptr<DeviceInventory> inventory) :
+    inventory_{ inventory }
+{
+    for (auto const& item : KinesisErrorCodes()) {
+        SetErrorText(ERR_OFFSET + item.first, item.second.c_str());
+    }
+    for (auto const& item : AdapterErrorTexts()) {
+        SetErrorText(item.first, item.second.c_str());
+    }
+
+    // As with the single-axis stage, the user must tell us the conversion
+    // from physical to device units (see SingleAxisStage.cpp). The channel
+    // is ignored for devices that are not multi-channel.
+    CreateStringProperty(PROP_XSerialNo, "", false,
+        new CPropertyAction(this, &XYStage::OnXSerialNo), true);
+    CreateIntegerProperty(PROP_XChannel, 1, false, nullptr, true);
+    SetPropertyLimits(PROP_XChannel, 1, 3);
+    CreateFloatProperty(PROP_XDeviceUnitsPerMillimeter, 1000.0,
+        false, nullptr, true);
+
+    CreateStringProperty(PROP_YSerialNo, "", false,
+        new CPropertyAction(this, &XYStage::OnYSerialNo), true);
+    CreateIntegerProperty(PROP_YChannel, 2, false, nullptr, true);
+    SetPropertyLimits(PROP_YChannel, 1, 3);
+    CreateFloatProperty(PROP_YDeviceUnitsPerMillimeter, 1000.0,
+        false, nullptr, true);
+
+    CreateIntegerProperty(PROP_PollingIntervalMs, pollingIntervalMs_,
+        false, nullptr, true);
+    SetPropertyLimits(PROP_PollingIntervalMs, 1, 1000);
+}
+
+
+XYStage::~XYStage() {
+    if (!x_.serialNo.empty())
+        UnregisterConfiguredDevice(x_.serialNo);
+    if (!y_.serialNo.empty())
+        UnregisterConfiguredDevice(y_.serialNo);
+}
+
+
+int
+XYStage::Initialize() {
+    if (initialized_)
+        return DEVICE_OK;
+
+    long channel;
+    GetProperty(PROP_XChannel, channel);
+    x_.channel = IsPotentiallyMultiChannel(x_.serialNo) ? short(channel) : short(-1);
+    GetProperty(PROP_YChannel, channel);
+    y_.channel = IsPotentiallyMultiChannel(y_.serialNo) ? short(channel) : short(-1);
+    if (x_.serialNo == y_.serialNo && x_.channel == y_.channel)
+        return ERR_XY_AXIS_INVALID;
+
+    double deviceUnitsPerMm;
+    GetProperty(PROP_XDeviceUnitsPerMillimeter, deviceUnitsPerMm);
+    x_.deviceUnitsPerUm = deviceUnitsPerMm / 1000.0;
+    GetProperty(PROP_YDeviceUnitsPerMillimeter, deviceUnitsPerMm);
+    y_.deviceUnitsPerUm = deviceUnitsPerMm / 1000.0;
+
+    long intervalMs;
+    GetProperty(PROP_PollingIntervalMs, intervalMs);
+    pollingIntervalMs_ = static_cast<int>(intervalMs);
+
+    // Kinesis devices can only be opened after the Hub has built the device
+    // list, which it may be doing in the background
+    if (!inventory_) {
+        auto provider = dynamic_cast<DeviceInventoryProvider*>(GetParentHub());
+        if (provider)
+            inventory_ = provider->GetDeviceInventory();
+    }
+    if (inventory_)
+        inventory_->WaitForValidation();
+
+    int ret = InitializeAxis(x_, "X");
+    if (ret != DEVICE_OK)
+        return ret;
+    ret = InitializeAxis(y_, "Y");
+    if (ret != DEVICE_OK)
+        return ret;
+
+    initialized_ = true;
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::InitializeAxis(Axis& axis, char const* axisName) {
+    if (!IsValidSerialNo(axis.serialNo))
+        return ERR_XY_AXIS_INVALID;
+
+    // Two channels of a benchtop controller share the connection
+    auto connection = MakeConnection(axis.serialNo);
+    if (!connection)
+        return ERR_XY_AXIS_INVALID;
+    if (!connection->IsValid())
+        return ERR_OFFSET + connection->ConnectionError();
+    auto motorDrive = MakeKinesisMotorDrive(connection, axis.channel);
+    if (!motorDrive)
+        return ERR_XY_AXIS_INVALID;
+    if (!connection->ClaimChannel(motorDrive->Channel()))
+        return ERR_CHANNEL_IN_USE;
+    axis.motorDrive = std::move(motorDrive);
+
+    int ret = AwaitInitialState(*axis.motorDrive);
+    if (ret != DEVICE_OK)
+        return ret;
+
+    bool ok = axis.motorDrive->StartPolling(pollingIntervalMs_);
+    if (!ok) {
+        LogMessage(std::string("Failed to start polling for ") + axisName +
+            " axis (serial no " + axis.serialNo + ")");
+    }
+
+    axis.motorDrive->StartMotionEvents();
+
+    return EnableChannelIfDisabled(*axis.motorDrive, axis.didEnable);
+}
+
+
+int
+XYStage::Shutdown() {
+    ShutdownAxis(x_);
+    ShutdownAxis(y_);
+    initialized_ = false;
+    return DEVICE_OK;
+}
+
+
+void
+XYStage::ShutdownAxis(Axis& axis) {
+    if (!axis.motorDrive)
+        return;
+
+    if (axis.didEnable)
+        axis.motorDrive->SetChannelEnabled(false);
+    axis.didEnable = false;
+
+    axis.motorDrive->StopMotionEvents();
+    axis.motorDrive->StopPolling();
+    axis.motorDrive->GetConnection()->ReleaseChannel(
+        axis.motorDrive->Channel());
+    axis.motorDrive.reset();
+}
+
+
+void
+XYStage::GetName(char* name) const {
+    CDeviceUtils::CopyLimitedString(name, DEVICENAME_XYSTAGE);
+}
+
+
+bool
+XYStage::Busy() {
+    if (!x_.motorDrive || !y_.motorDrive)
+        return false;
+
+    // Add a little extra to minimize the chance of a race due to jitter in the
+    // polling.
+    double const statusLagMs = pollingIntervalMs_ + 10.0;
+
+    auto msSinceMovementStart =
+        (GetCurrentMMTime() - lastMovementStart_).getMsec();
+    bool xMoving = IsMotorDriveMoving(*x_.motorDrive, msSinceMovementStart,
+        statusLagMs);
+    bool yMoving = IsMotorDriveMoving(*y_.motorDrive, msSinceMovementStart,
+        statusLagMs);
+    return xMoving || yMoving;
+}
+
+
+int
+XYStage::SetPositionSteps(long x, long y) {
+    // Two channels of one controller: send both moves in one burst
+    if (SharesController()) {
+        short err = ExecuteOnBoth(
+            [&] { return x_.motorDrive->MoveToPosition(clamp_int(x)); },
+            [&] { return y_.motorDrive->MoveToPosition(clamp_int(y)); });
+        if (err)
+            return ERR_OFFSET + err;
+        lastMovementStart_ = GetCurrentMMTime();
+        return DEVICE_OK;
+    }
+
+    // Start both moves before waiting for either
+    short err = x_.motorDrive->MoveToPosition(clamp_int(x));
+    if (err)
+        return ERR_OFFSET + err;
+    lastMovementStart_ = GetCurrentMMTime();
+
+    err = y_.motorDrive->MoveToPosition(clamp_int(y));
+    if (err) {
+        // Do not leave X moving on its own
+        x_.motorDrive->StopProfiled();
+        return ERR_OFFSET + err;
+    }
+    lastMovementStart_ = GetCurrentMMTime();
+
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::SetRelativePositionSteps(long dx, long dy) {
+    if (dx != 0 && dy != 0 && SharesController()) {
+        short err = ExecuteOnBoth(
+            [&] { return x_.motorDrive->MoveRelative(clamp_int(dx)); },
+            [&] { return y_.motorDrive->MoveRelative(clamp_int(dy)); });
+        if (err)
+            return ERR_OFFSET + err;
+        lastMovementStart_ = GetCurrentMMTime();
+        return DEVICE_OK;
+    }
+
+    // Skip an axis that does not move (common when tiling), saving a command
+    if (dx != 0) {
+        short err = x_.motorDrive->MoveRelative(clamp_int(dx));
+        if (err)
+            return ERR_OFFSET + err;
+        lastMovementStart_ = GetCurrentMMTime();
+    }
+    if (dy != 0) {
+        short err = y_.motorDrive->MoveRelative(clamp_int(dy));
+        if (err) {
+            if (dx != 0)
+                x_.motorDrive->StopProfiled();
+            return ERR_OFFSET + err;
+        }
+        lastMovementStart_ = GetCurrentMMTime();
+    }
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::GetPositionSteps(long& x, long& y) {
+    x = x_.motorDrive->Snapshot().position;
+    y = y_.motorDrive->Snapshot().position;
+    return DEVICE_OK;
+}
+
+
+int
+XYStage::Home() {
+    bool xCanHome = x_.motorDrive->CanHome();
+    bool yCanHome = y_.motorDrive->CanHome();
+    if (!xCanHome && !yCanHome)
+        return DEVICE_UNSUPPORTED_COMMAND;
+
+    if (xCanHome) {
+        short err = x_.motorDrive->Home();
+        if (err)
+            return ERR_OFFSET + err;
+        lastMovementStart_ = GetCurrentMMTime();
+    }
+    if (yCanHome) {
+        short err = y_.motorDrive->Home();
+        if (err)
+            return ERR_OFFSET + err;
+        lastMovementStart_ = GetCurrentMMTime();
+    }
+
+    return DEVICE_OK;
+}
+
+
+bool
+XYStage::SharesController() const {
+    return x_.motorDrive->GetConnection() == y_.motorDrive->GetConnection();
+}
+
+
+short
+XYStage::ExecuteOnBoth(CommandQueue::Command const& xCommand,
+    CommandQueue::Command const& yCommand) {
+    auto results = x_.motorDrive->Commands().ExecuteBatch({ xCommand, yCommand });
+    // Do not leave one axis moving on its own
+    if (results[0] && !results[1])
+        y_.motorDrive->StopProfiled();
+    else if (results[1] && !results[0])
+        x_.motorDrive->StopProfiled();
+    return results[0] ? results[0] : results[1];
+}
+
+
+int
+XYStage::OnXSerialNo(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    return OnSerialNo(x_, pProp, eAct);
+}
+
+
+int
+XYStage::OnYSerialNo(MM::PropertyBase* pProp, MM::ActionType eAct) {
+    return OnSerialNo(y_, pProp, eAct);
+}
+
+
+int
+XYStage::OnSerialNo(Axis& axis, MM::PropertyBase* pProp, MM::ActionType eAct) {
+    if (eAct == MM::BeforeGet) {
+        pProp->Set(axis.serialNo.c_str());
+    }
+    else if (eAct == MM::AfterSet) {
+        std::string serialNo;
+        pProp->Get(serialNo);
+        if (serialNo == axis.serialNo)
+            return DEVICE_OK;
+
+        // Let the Hub open the connection ahead of Initialize()
+        if (!axis.serialNo.empty())
+            UnregisterConfiguredDevice(axis.serialNo);
+        axis.serialNo = serialNo;
+        if (!axis.serialNo.empty())
+            RegisterConfiguredDevice(axis.serialNo);
+    }
+    return DEVICE_OK;
+}
@@ -0,0 +1,106 @@
+// Thorlabs Kinesis device adapter for Micro-Manager
+// Author: Mark A. Tsuchida
+//
+// Copyright 2019-2020 The Board of Regents of the University of Wisconsin
+// System
+//
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// 
+// 1. Redistributions of source code must retain the above copyright notice,
+// this list of conditions and the following disclaimer.
+// 
+// 2. Redistributions in binary form must reproduce the above copyright notice,
+// this list of conditions and the following disclaimer in the documentation
+// and/or other materials provided with the distribution.
+// 
+// 3. Neither the name of the copyright holder nor the names of its
+// contributors may be used to endorse or promote products derived from this
+// software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+// AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+// IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+// ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+// LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+// CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+// SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+// INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+// CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+// ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+// POSSIBILITY OF SUCH DAMAGE.
+
+#pragma once
+
+#include "DeviceInventory.h"
+#include "KinesisDevice.h"
+
+#include "DeviceBase.h"
+
+#include <memory>
+#include <string>
+
+
+char const* const DEVICENAME_XYSTAGE = "KinesisXYStage";
+
+
+// XY stage made of two motor drives: two K-Cubes/T-Cubes, two channels of a
+// benchtop controller, etc. The drives are chosen with pre-init properties.
+// Moves are started on both axes back to back, so that they run concurrently.
+class XYStage final : public CXYStageBase<XYStage> {
+    struct Axis {
+        std::string serialNo;
+        short channel{ -1 }; // -1 if not multi-channel
+        double deviceUnitsPerUm{ 1.0 };
+        std::unique_ptr<MotorDrive> motorDrive;
+        bool didEnable{ false };
+    };
+    Axis x_;
+    Axis y_;
+
+    std::shared_ptr<DeviceInventory> inventory_;
+    int pollingIntervalMs_{ 50 };
+    MM::MMTime lastMovementStart_{ 0.0 };
+    bool initialized_{ false };
+
+public:
+    explicit XYStage(std::shared_ptr<DeviceInventory> inventory = {});
+    ~XYStage() override;
+
+    int Initialize() override;
+    int Shutdown() override;
+
+    void GetName(char* name) const override;
+    bool Busy() override;
+
+    int SetPositionSteps(long x, long y) override;
+    int GetPositionSteps(long& x, long& y) override;
+    int SetRelativePositionSteps(long dx, long dy) override;
+    int Home() override;
+    int Stop() override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int SetOrigin() override { return DEVICE_UNSUPPORTED_COMMAND; }
+    int GetLimitsUm(double&, double&, double&, double&) override {
+        return DEVICE_UNSUPPORTED_COMMAND;
+    }
+    int GetStepLimits(long&, long&, long&, long&) override {
+        return DEVICE_UNSUPPORTED_COMMAND;
+    }
+    double GetStepSizeXUm() override { return 1.0 / x_.deviceUnitsPerUm; }
+    double GetStepSizeYUm() override { return 1.0 / y_.deviceUnitsPerUm; }
+    int IsXYStageSequenceable(bool& f) const override {
+        f = false;
+        return DEVICE_OK;
+    }
+
+    // Action interface
+    int OnXSerialNo(MM::PropertyBase* pProp, MM::ActionType eAct);
+    int OnYSerialNo(MM::PropertyBase* pProp, MM::ActionType eAct);
+
+private:
+    int OnSerialNo(Axis& axis, MM::PropertyBase* pProp, MM::ActionType eAct);
+    int InitializeAxis(Axis& axis, char const* axisName);
+    void ShutdownAxis(Axis& axis);
+    bool SharesController() const;
+    short ExecuteOnBoth(CommandQueue::Command const& xCommand,
+        CommandQueue::Command const& yCommand);
+};